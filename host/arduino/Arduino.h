@@ -0,0 +1,177 @@
+// minimal Arduino API for host builds of the sketch sources (see host/Makefile)
+//
+// only what the map, planner and perimeter code uses: timing (micros/millis from the host clock), random,
+// pin functions (no-ops), String and a Serial that prints to stdout - hostSerialQuiet mutes Serial output
+// of the calling thread (e.g. simulation workers), each thread has its own sketch singletons (Map, Planner, ...)
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <ctype.h>
+#include <string>
+// host tools use these - include them before the min/max/abs macros below
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+
+// sketch singletons and their module state: one instance per thread (see instance.h)
+#define SUNRAY_INSTANCE thread_local
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define F_CPU 84000000L
+#define PI 3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#define sq(x) ((x)*(x))
+#define abs(x) ((x)>0?(x):-(x))
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 2
+#define RISING 3
+#define FALLING 4
+
+#define A0 54
+#define A1 55
+#define A2 56
+#define A3 57
+#define A4 58
+#define A5 59
+#define A6 60
+#define A7 61
+#define A8 62
+#define A9 63
+#define A10 64
+#define A11 65
+#define A12 66
+#define A13 67
+#define A14 68
+#define A15 69
+
+#define DEC 10
+#define HEX 16
+#define BIN 2
+
+#define IOREF 3.3
+
+#define __FlashStringHelper char
+#define F(x) (x)
+
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+int hostRand();
+#define rand() hostRand()   // sketch rand() on the per-thread generator (reproducible parallel runs)
+
+inline void pinMode(uint32_t, uint32_t){}
+inline void digitalWrite(uint32_t, uint32_t){}
+inline int digitalRead(uint32_t){ return LOW; }
+inline uint32_t analogRead(uint32_t){ return 0; }
+inline void analogWrite(uint32_t, uint32_t){}
+
+
+class String {
+  public:
+    String(const char *s = "") : str(s) {}
+    String(char c) : str(1, c) {}
+    String(int v) : str(std::to_string(v)) {}
+    String(unsigned int v) : str(std::to_string(v)) {}
+    String(long v) : str(std::to_string(v)) {}
+    String(unsigned long v) : str(std::to_string(v)) {}
+    String(double v, int digits = 2) { char buf[32]; snprintf(buf, sizeof buf, "%.*f", digits, v); str = buf; }
+    unsigned int length() const { return str.length(); }
+    char charAt(unsigned int i) const { return (i < str.length()) ? str[i] : 0; }
+    char operator[](unsigned int i) const { return charAt(i); }
+    const char* c_str() const { return str.c_str(); }
+    int indexOf(char c, unsigned int from = 0) const { size_t i = str.find(c, from); return (i == std::string::npos) ? -1 : i; }
+    int indexOf(const String &s, unsigned int from = 0) const { size_t i = str.find(s.str, from); return (i == std::string::npos) ? -1 : i; }
+    String substring(unsigned int from) const { return String(str.substr(min(from, (unsigned int)str.length())).c_str()); }
+    String substring(unsigned int from, unsigned int to) const { from = min(from, (unsigned int)str.length()); return String(str.substr(from, (to > from) ? to - from : 0).c_str()); }
+    bool startsWith(const String &s) const { return str.compare(0, s.str.length(), s.str) == 0; }
+    bool equals(const String &s) const { return str == s.str; }
+    bool operator==(const String &s) const { return str == s.str; }
+    long toInt() const { return atol(str.c_str()); }
+    float toFloat() const { return atof(str.c_str()); }
+    void trim() { size_t b = str.find_first_not_of(" \t\r\n"); size_t e = str.find_last_not_of(" \t\r\n"); str = (b == std::string::npos) ? "" : str.substr(b, e - b + 1); }
+    String& operator+=(const String &s) { str += s.str; return *this; }
+    String& operator+=(char c) { str += c; return *this; }
+    friend String operator+(const String &a, const String &b) { String r(a); r += b; return r; }
+  protected:
+    std::string str;
+};
+
+
+extern thread_local bool hostSerialQuiet; // mute Serial output of calling thread
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) { if (!hostSerialQuiet) fputc(c, stdout); return 1; }
+    size_t write(const uint8_t *buf, size_t size) { for (size_t i = 0; i < size; i++) write(buf[i]); return size; }
+    size_t print(const char *s) { return write((const uint8_t*)s, strlen(s)); }
+    size_t print(const String &s) { return print(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v, int base = DEC) { return print((long)v, base); }
+    size_t print(unsigned int v, int base = DEC) { return print((unsigned long)v, base); }
+    size_t print(long v, int base = DEC) { return (base == HEX) ? printf_("%lX", v) : printf_("%ld", v); }
+    size_t print(unsigned long v, int base = DEC) { return (base == HEX) ? printf_("%lX", v) : printf_("%lu", v); }
+    size_t print(double v, int digits = 2) { return printf_("%.*f", digits, v); }
+    size_t println() { return write('\n'); }
+    template <class T> size_t println(T v) { size_t n = print(v); return n + println(); }
+    template <class T> size_t println(T v, int f) { size_t n = print(v, f); return n + println(); }
+    void flush() { fflush(stdout); }
+  protected:
+    size_t printf_(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+  public:
+    int available() { return 0; }
+    int availableForWrite() { return 128; }
+    int read() { return -1; }
+    int peek() { return -1; }
+    long parseInt() { return 0; }
+    float parseFloat() { return 0; }
+    String readStringUntil(char) { return String(); }
+    void setTimeout(unsigned long) {}
+};
+
+class HardwareSerial : public Stream {
+  public:
+    void begin(unsigned long) {}
+    void end() {}
+    operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+extern HardwareSerial Serial3;
+
+#endif
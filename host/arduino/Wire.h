@@ -0,0 +1,22 @@
+// minimal Wire (I2C) API for host builds - no devices
+
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include <Arduino.h>
+
+class TwoWire {
+  public:
+    void begin() {}
+    void setClock(uint32_t) {}
+    void beginTransmission(uint8_t) {}
+    uint8_t endTransmission(bool stop = true) { return 0; }
+    uint8_t requestFrom(uint8_t, uint8_t) { return 0; }
+    size_t write(uint8_t) { return 1; }
+    int available() { return 0; }
+    int read() { return -1; }
+};
+
+extern TwoWire Wire;
+
+#endif
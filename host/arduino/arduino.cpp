@@ -0,0 +1,68 @@
+// minimal Arduino API for host builds (see Arduino.h)
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <stdarg.h>
+#include <chrono>
+#include <thread>
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+HardwareSerial Serial2;
+HardwareSerial Serial3;
+TwoWire Wire;
+
+thread_local bool hostSerialQuiet = false;
+
+static std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+unsigned long micros(){
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+unsigned long millis(){
+  return micros() / 1000;
+}
+
+void delay(unsigned long ms){
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us){
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+// per-thread generator of random() and sketch rand() (libc rand() is shared by all threads)
+static thread_local uint32_t randomState = 1;
+
+void randomSeed(unsigned long seed){
+  randomState = (seed == 0) ? 1 : seed;
+}
+
+long random(long howbig){
+  if (howbig <= 0) return 0;
+  randomState = randomState * 1103515245u + 12345u;
+  return (randomState >> 1) % howbig;
+}
+
+int hostRand(){
+  randomState = randomState * 1103515245u + 12345u;
+  return (randomState >> 1) % ((unsigned)RAND_MAX + 1u);
+}
+
+long random(long howsmall, long howbig){
+  if (howsmall >= howbig) return howsmall;
+  return howsmall + random(howbig - howsmall);
+}
+
+size_t Print::printf_(const char *fmt, ...){
+  char buf[64];
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(buf, sizeof buf, fmt, args);
+  va_end(args);
+  if (n < 0) return 0;
+  n = min(n, (int)sizeof buf - 1);
+  for (int i = 0; i < n; i++) write(buf[i]);
+  return n;
+}
@@ -0,0 +1,133 @@
+// host tests and tools: checks, timing and test data (outlines of the Processing map files, robot logs)
+//
+// usage:
+//   CHECK(Map.mapSizeX > 0);
+//   double t = hostTimeUs();
+//   std::vector<point_t> outline;
+//   loadOutline(HOST_DATA_DIR "indoor_map.bin", outline);
+//   setOutline(outline, OUTLINE_SIZE);
+//   lawnOutline(outline, 2000);
+//   return hostTestResult();
+
+#ifndef HOSTTEST_H
+#define HOSTTEST_H
+
+#include <Arduino.h>
+#include "map.h"
+
+#ifndef HOST_DATA_DIR
+#define HOST_DATA_DIR "../processing_sunray/data/"
+#endif
+
+
+static int hostChecks = 0;
+static int hostFailures = 0;
+
+#define CHECK(cond) hostCheck((cond), #cond, __FILE__, __LINE__)
+
+static inline bool hostCheck(bool ok, const char *expr, const char *file, int line){
+  hostChecks++;
+  if (!ok) {
+    hostFailures++;
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+  }
+  return ok;
+}
+
+// exit code of test program
+static inline int hostTestResult(){
+  printf("%d checks, %d failed\n", hostChecks, hostFailures);
+  return (hostFailures == 0) ? 0 : 1;
+}
+
+// host clock (microseconds, fractional)
+static inline double hostTimeUs(){
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// perimeter outline (meter) of a Processing map file (Java serialized ArrayList<PVector> outline, followed by grid)
+static inline bool loadOutline(const char *fileName, std::vector<point_t> &outline){
+  outline.clear();
+  FILE *f = fopen(fileName, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "cannot open %s\n", fileName);
+    return false;
+  }
+  std::vector<uint8_t> data;
+  int c;
+  while ((c = fgetc(f)) != EOF) data.push_back(c);
+  fclose(f);
+  // list size follows the ArrayList class description, first PVector has a class description (ending 'x','p'),
+  // further PVectors reference it (TC_OBJECT, TC_REFERENCE, handle 0x7e0002) - each followed by x,y,z (big endian float)
+  static const uint8_t sizeTag[] = { 's', 'i', 'z', 'e', 'x', 'p' };
+  static const uint8_t pvectorTag[] = { 'z', 'x', 'p' };
+  static const uint8_t refTag[] = { 0x73, 0x71, 0x00, 0x7e, 0x00, 0x02 };
+  size_t pos = std::search(data.begin(), data.end(), sizeTag, sizeTag + sizeof sizeTag) - data.begin();
+  if (pos + 10 > data.size()) return false;
+  pos += sizeof sizeTag;
+  int size = (data[pos] << 24) | (data[pos + 1] << 16) | (data[pos + 2] << 8) | data[pos + 3];
+  pos = std::search(data.begin() + pos, data.end(), pvectorTag, pvectorTag + sizeof pvectorTag) - data.begin();
+  pos += sizeof pvectorTag;
+  for (int i = 0; i < size; i++) {
+    if (i > 0) {
+      if ((pos + sizeof refTag > data.size()) || (memcmp(&data[pos], refTag, sizeof refTag) != 0)) return false;
+      pos += sizeof refTag;
+    }
+    if (pos + 12 > data.size()) return false;
+    float v[2];
+    for (int j = 0; j < 2; j++) {
+      uint32_t u = (data[pos] << 24) | (data[pos + 1] << 16) | (data[pos + 2] << 8) | data[pos + 3];
+      memcpy(&v[j], &u, 4);
+      pos += 4;
+    }
+    pos += 4; // z
+    point_t pt = { v[0], v[1] };
+    outline.push_back(pt);
+  }
+  return true;
+}
+
+// set outline of Map (every n-th point so that at most maxPoints are used, outline is closed)
+static inline void setOutline(const std::vector<point_t> &outline, int maxPoints){
+  bool quiet = hostSerialQuiet;
+  hostSerialQuiet = true;
+  Map.clearOutline();
+  hostSerialQuiet = quiet;
+  int n = outline.size();
+  int step = (n + maxPoints - 2) / (maxPoints - 1);
+  for (int i = 0; i < n; i += step) Map.perimeterOutline[Map.perimeterOutlineSize++] = outline[i];
+  Map.perimeterOutline[Map.perimeterOutlineSize++] = outline[0];
+}
+
+// outline of a star-shaped polygon (meter), e.g. synthetic maps of given size
+static inline void starOutline(std::vector<point_t> &outline, float radius, int points){
+  outline.clear();
+  for (int i = 0; i < points; i++) {
+    float a = 2 * PI * i / points;
+    float r = radius * ((i & 1) ? 0.7 : 1.0);
+    point_t pt = { radius + r * cos(a), radius + r * sin(a) };
+    outline.push_back(pt);
+  }
+}
+
+// wavy circular outline of given area (square meter), e.g. synthetic lawns
+static inline void lawnOutline(std::vector<point_t> &outline, float area){
+  outline.clear();
+  int n = OUTLINE_SIZE - 1;
+  for (int i = 0; i < n; i++) {
+    float a = 2 * PI * i / n;
+    float r = 1.0 + 0.15 * sin(5 * a);
+    point_t pt = { r * cos(a), r * sin(a) };
+    outline.push_back(pt);
+  }
+  float sum = 0;
+  for (int i = 0; i < n; i++) sum += outline[i].x * outline[(i + 1) % n].y - outline[(i + 1) % n].x * outline[i].y;
+  float scale = sqrt(area / (sum / 2));
+  for (int i = 0; i < n; i++) {
+    outline[i].x *= scale;
+    outline[i].y *= scale;
+  }
+}
+
+#endif
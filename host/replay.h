@@ -0,0 +1,144 @@
+// log replay on host localization (MapClass::replayStep) as the Processing client replays logs on the robot
+// (replayOnRobot): robot logs (!01 sensor data: robot state, perimeter magnitudes - !17 motion: distance, yaw) on
+// the perimeter outline of the map file where they were recorded - per step pose, particles extent and CPU time,
+// closure error after each perimeter loop while tracking (pose difference after one outline length)
+//
+// usage:
+//   std::vector<replay_step_t> steps;
+//   loadLog(HOST_DATA_DIR "outdoor_track.log", steps);
+//   replay_result_t r;
+//   replayLog(steps, outline, r, csvFile);     // CSV file may be NULL
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "hosttest.h"
+
+#define REPLAY_LOGS 3
+
+// log file k and map file it was recorded on (file 0: log, 1: map)
+static inline const char *replayFile(int k, int file){
+  static const char *files[REPLAY_LOGS][2] = {
+    { "indoor_track.log", "indoor_map.bin" },
+    { "outdoor_track.log", "outdoor_map.bin" },
+    { "outdoor_mow_rand.log", "outdoor_map.bin" },
+  };
+  return files[k][file];
+}
+
+
+struct replay_step_t {
+  unsigned long time; // robot time of last sensor data (ms)
+  int state; // robot state
+  float leftMag; // perimeter magnitudes
+  float rightMag;
+  float distance; // moved distance (meter)
+  float yaw; // IMU yaw (rad)
+};
+
+struct replay_result_t {
+  int steps;
+  float distance; // travelled distance (meter)
+  double cpuSum; // CPU time of steps (microseconds)
+  double cpuMax;
+  double spreadSum; // particles extent of all steps (meter)
+  float spreadX; // particles extent after last step (meter)
+  float spreadY;
+  int loops; // perimeter loops while tracking
+  float closureSum; // closure error of loops (meter)
+  float closureMax;
+};
+
+
+// motion steps of a Processing log (magnitudes and state of preceding sensor data)
+static inline bool loadLog(const char *fileName, std::vector<replay_step_t> &steps){
+  steps.clear();
+  FILE *f = fopen(fileName, "r");
+  if (f == NULL) {
+    fprintf(stderr, "cannot open %s\n", fileName);
+    return false;
+  }
+  replay_step_t step;
+  memset(&step, 0, sizeof step);
+  char line[512];
+  while (fgets(line, sizeof line, f) != NULL) {
+    std::vector<char*> list;
+    for (char *tok = strtok(line, ",\r\n"); tok != NULL; tok = strtok(NULL, ",\r\n")) list.push_back(tok);
+    if (list.empty()) continue;
+    if ((strcmp(list[0], "!01") == 0) && (list.size() >= 23)) {
+      step.time = atol(list[1]);
+      step.state = atoi(list[2]);
+      step.leftMag = atoi(list[8]);
+      step.rightMag = atoi(list[9]);
+    } else if ((strcmp(list[0], "!17") == 0) && (list.size() >= 3)) {
+      step.distance = atof(list[1]);
+      step.yaw = atof(list[2]);
+      steps.push_back(step);
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+// outline length (meter)
+static inline float outlineLength(const std::vector<point_t> &outline){
+  float len = 0;
+  for (int i = 1; i < (int)outline.size(); i++) len += distance(outline[i - 1].x, outline[i - 1].y, outline[i].x, outline[i].y);
+  return len;
+}
+
+// replay log steps on Map (outline transferred to map, particles distributed on outline), robot must be idle
+static inline void replayLog(const std::vector<replay_step_t> &steps, const std::vector<point_t> &outline,
+                             replay_result_t &r, FILE *csv){
+  memset(&r, 0, sizeof r);
+  bool quiet = hostSerialQuiet;
+  hostSerialQuiet = true;
+  Map.replayMap(0);
+  hostSerialQuiet = quiet;
+  int step = (outline.size() + OUTLINE_SIZE - 3) / (OUTLINE_SIZE - 2); // robot outline size (see replayOutlinePoint)
+  for (int i = 0; i < (int)outline.size(); i += step) Map.replayOutlinePoint(outline[i].x, outline[i].y);
+  Map.replayOutlinePoint(outline[0].x, outline[0].y);
+  hostSerialQuiet = true;
+  Map.replayMap(1);
+  hostSerialQuiet = quiet;
+  float loopLength = outlineLength(outline);
+  float loopStart = -1;
+  point_t loopPose = { 0, 0 };
+  if (csv != NULL) fprintf(csv, "step,time,state,distance,x,y,heading_offset,particles_dist_x,particles_dist_y,overall_prob,cpu_us,particles,closure_error\n");
+  for (int i = 0; i < (int)steps.size(); i++) {
+    const replay_step_t &s = steps[i];
+    r.distance += fabs(s.distance);
+    double t0 = hostTimeUs();
+    Map.replayStep(s.distance, s.yaw, s.leftMag, s.rightMag, s.state);
+    double cpu = hostTimeUs() - t0;
+    r.steps++;
+    r.cpuSum += cpu;
+    r.cpuMax = max(r.cpuMax, cpu);
+    r.spreadX = Map.particlesDistanceX;
+    r.spreadY = Map.particlesDistanceY;
+    r.spreadSum += sqrt(sq(r.spreadX) + sq(r.spreadY));
+    // closure error: pose difference after tracking one outline length
+    float closure = -1;
+    point_t pose = { Map.robotState.x, Map.robotState.y };
+    if (s.state != STAT_TRACK) loopStart = -1;
+      else if (loopStart < 0) {
+        loopStart = r.distance;
+        loopPose = pose;
+      } else if ((loopLength > 0) && (r.distance - loopStart >= loopLength)) {
+        closure = distance(pose.x, pose.y, loopPose.x, loopPose.y);
+        r.closureSum += closure;
+        r.closureMax = max(r.closureMax, closure);
+        r.loops++;
+        loopStart = r.distance;
+        loopPose = pose;
+      }
+    if (csv != NULL) {
+      fprintf(csv, "%d,%lu,%d,%.3f,%.3f,%.3f,%.4f,%.3f,%.3f,%.4f,%.1f,%d,", r.steps, s.time, s.state, r.distance,
+        pose.x, pose.y, Map.headingBias, r.spreadX, r.spreadY, Map.overallProb, cpu, (int)Map.filter.size());
+      if (closure >= 0) fprintf(csv, "%.3f\n", closure);
+        else fprintf(csv, "\n");
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,162 @@
+// host builds: robot hardware singletons (motors, sensors, flash) without hardware
+//
+// Robot, Motor, IMU, Sonar and Bumper hold plain state set by the host programs (e.g. replayed IMU yaw),
+// Flash is a RAM image of the Due flash, ADCMan keeps a capture buffer per pin filled by the host programs
+// (one instance of each per thread)
+
+#include <Arduino.h>
+#include "robot.h"
+#include "motor.h"
+#include "imu.h"
+#include "adcman.h"
+#include "sonar.h"
+#include "bumper.h"
+#include "flashmem.h"
+#include "battery.h"
+
+
+SUNRAY_INSTANCE RobotClass Robot;
+SUNRAY_INSTANCE MotorClass Motor;
+SUNRAY_INSTANCE IMUClass IMU;
+SUNRAY_INSTANCE SonarClass Sonar;
+SUNRAY_INSTANCE BumperClass Bumper;
+SUNRAY_INSTANCE FlashClass Flash;
+SUNRAY_INSTANCE BatteryClass Battery;
+SUNRAY_INSTANCE ADCManager ADCMan;
+
+
+RobotClass::RobotClass(){
+}
+
+void RobotClass::sensorTriggered(uint16_t sensorID){
+  sensorTriggerStatus |= sensorID;
+}
+
+void RobotClass::resetSensorTriggers(){
+  sensorTriggerStatus = 0;
+}
+
+
+void MotorClass::travelLineDistance(int distanceCm, float angleRad, float speedRpmPerc){
+  distanceCmSet = distanceCm;
+  angleRadSet = angleRad;
+  speedRpmSet = speedRpmPerc;
+  motion = MOT_LINE_DISTANCE;
+}
+
+void MotorClass::stopImmediately(){
+  motion = MOT_STOP;
+}
+
+
+float IMUClass::getYaw(){
+  return ypr.yaw;
+}
+
+
+bool BumperClass::pressed(){
+  return (leftPressed || rightPressed);
+}
+
+
+// flash image (Due: 512 KB flash, sketch data starts at address 0 of data area)
+static SUNRAY_INSTANCE byte flashImage[256 * 1024];
+
+FlashClass::FlashClass(){
+}
+
+byte FlashClass::read(uint32_t address){
+  return flashImage[address];
+}
+
+byte* FlashClass::readAddress(uint32_t address){
+  return flashImage + address;
+}
+
+boolean FlashClass::write(uint32_t address, byte value){
+  flashImage[address] = value;
+  return true;
+}
+
+boolean FlashClass::write(uint32_t address, byte *data, uint32_t dataLength){
+  memcpy(flashImage + address, data, dataLength);
+  return true;
+}
+
+
+ADCManager::ADCManager(){
+  convCounter = 0;
+  chCurr = chNext = 0;
+  memset(channels, 0, sizeof channels);
+}
+
+void ADCManager::begin(){
+}
+
+void ADCManager::run(){
+}
+
+void ADCManager::setupChannel(byte pin, int samplecount, bool autocalibrate){
+  byte ch = pin - A0;
+  channels[ch].pin = ch;
+  channels[ch].autoCalibrate = autocalibrate;
+  setSampleCount(ch, samplecount);
+}
+
+void ADCManager::setSampleCount(byte ch, int samplecount){
+  if (channels[ch].samples != NULL) free(channels[ch].samples);
+  channels[ch].sampleCount = samplecount;
+  channels[ch].samples = (int8_t*)malloc(samplecount);
+  memset(channels[ch].samples, 0, samplecount);
+  channels[ch].convComplete = false;
+}
+
+int8_t* ADCManager::getSamples(byte pin){
+  return channels[pin - A0].samples;
+}
+
+int8_t* ADCManager::swapSamples(byte pin, int8_t *samples){
+  byte ch = pin - A0;
+  int8_t *prev = channels[ch].samples;
+  channels[ch].samples = samples;
+  return prev;
+}
+
+int ADCManager::getSampleCount(byte pin){
+  return channels[pin - A0].sampleCount;
+}
+
+int16_t ADCManager::getValue(byte pin){
+  return channels[pin - A0].value;
+}
+
+float ADCManager::getVoltage(byte pin){
+  return ((float)getValue(pin)) / ((float)((1 << ADC_BITS) - 1)) * ADC_REF;
+}
+
+// host programs complete a capture by filling getSamples and calling postProcess via this flag
+bool ADCManager::isConvComplete(byte pin){
+  return channels[pin - A0].convComplete;
+}
+
+void ADCManager::restartConv(byte pin){
+  channels[pin - A0].convComplete = false;
+}
+
+void ADCManager::printInfo(){
+}
+
+int ADCManager::getConvCounter(){
+  return convCounter;
+}
+
+void ADCManager::calibrate(){
+}
+
+void ADCManager::init(byte ch){
+}
+
+void ADCManager::postProcess(byte ch){
+  channels[ch].convComplete = true;
+  convCounter++;
+}
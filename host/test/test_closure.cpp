@@ -0,0 +1,187 @@
+// outline loop closure (MapClass::correctOutline): perimeter laps dead-reckoned from the tracking logs (!17 motion
+// from first tracking step, outline points sampled as in MapClass::run, one lap: outline length of the map file) - closure
+// error before and after correction, outline length change, max. point correction and correction time - and shape:
+// mean distance of lap points to the outline of the map file (lap aligned by best rigid fit) must drop by correction
+
+#include "replay.h"
+
+#define RUNS 1000   // correction time: runs per lap
+
+
+// dead-reckoned lap from first tracking step (false: log has no complete lap)
+static bool trackLap(const std::vector<replay_step_t> &steps, float lapLength, std::vector<point_t> &lap){
+  lap.clear();
+  float x = 0, y = 0;
+  float travelled = 0;
+  float lastX = 0, lastY = 0;
+  float pointDist = lapLength / OUTLINE_SIZE;
+  for (int i = 0; i < (int)steps.size(); i++) {
+    if ((lap.empty()) && (steps[i].state != STAT_TRACK)) continue;
+    if (lap.empty()) {
+      point_t pt = { x, y };
+      lap.push_back(pt);
+    }
+    x += steps[i].distance * cos(steps[i].yaw);
+    y += steps[i].distance * sin(steps[i].yaw);
+    travelled += fabs(steps[i].distance);
+    if ((sqrt(sq(x - lastX) + sq(y - lastY)) >= pointDist) && ((int)lap.size() < OUTLINE_SIZE - 1)) {
+      point_t pt = { x, y };
+      lap.push_back(pt);
+      lastX = x;
+      lastY = y;
+    }
+    if (travelled >= lapLength * 0.99) { // log may end with the lap
+      point_t pt = { x, y };
+      if ((lastX != x) || (lastY != y)) {
+        if ((int)lap.size() < OUTLINE_SIZE - 1) lap.push_back(pt);
+          else lap.back() = pt;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+// outline resampled to n points of equal arc length (closed loop)
+static void resampleOutline(const std::vector<point_t> &outline, int n, std::vector<point_t> &pts){
+  pts.clear();
+  float step = outlineLength(outline) / n;
+  float pos = 0;
+  int m = outline.size();
+  for (int i = 0; (i < m) && ((int)pts.size() < n); i++) {
+    point_t a = outline[i];
+    point_t b = outline[(i + 1) % m];
+    float len = distance(a.x, a.y, b.x, b.y);
+    while ((pos <= len) && ((int)pts.size() < n)) {
+      float t = (len > 0) ? pos / len : 0;
+      point_t pt = { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t };
+      pts.push_back(pt);
+      pos += step;
+    }
+    pos -= len;
+  }
+}
+
+// distance of point to outline (closed loop)
+static float outlineDistance(const std::vector<point_t> &outline, point_t pt){
+  float best = 1e9;
+  int m = outline.size();
+  for (int i = 0; i < m; i++) {
+    point_t a = outline[i];
+    point_t b = outline[(i + 1) % m];
+    float dx = b.x - a.x;
+    float dy = b.y - a.y;
+    float lenSq = dx * dx + dy * dy;
+    float t = (lenSq > 0) ? ((pt.x - a.x) * dx + (pt.y - a.y) * dy) / lenSq : 0;
+    t = max(0.0f, min(1.0f, t));
+    best = min(best, (float)sq(pt.x - (a.x + dx * t)) + (float)sq(pt.y - (a.y + dy * t)));
+  }
+  return sqrt(best);
+}
+
+// mean distance of lap points to outline, lap aligned to outline by the best rigid fit (rotation, translation) over
+// arc length correspondences (all start offsets and both directions of the lap)
+static float outlineError(const std::vector<point_t> &lap, const std::vector<point_t> &outline){
+  int n = lap.size();
+  std::vector<point_t> ref;
+  resampleOutline(outline, n, ref);
+  n = min(n, (int)ref.size());
+  float lapX = 0, lapY = 0;
+  for (int i = 0; i < n; i++) {
+    lapX += lap[i].x / n;
+    lapY += lap[i].y / n;
+  }
+  float bestResidual = 1e9, bestAngle = 0, bestX = 0, bestY = 0;
+  for (int dir = -1; dir <= 1; dir += 2) {
+    for (int offset = 0; offset < n; offset++) {
+      float refX = 0, refY = 0;
+      for (int i = 0; i < n; i++) {
+        point_t r = ref[((offset + dir * i) % n + n) % n];
+        refX += r.x / n;
+        refY += r.y / n;
+      }
+      // best rotation of centered point sets (2D Kabsch)
+      float dot = 0, cross = 0;
+      for (int i = 0; i < n; i++) {
+        point_t r = ref[((offset + dir * i) % n + n) % n];
+        float ax = lap[i].x - lapX, ay = lap[i].y - lapY;
+        float bx = r.x - refX, by = r.y - refY;
+        dot += ax * bx + ay * by;
+        cross += ax * by - ay * bx;
+      }
+      float angle = atan2(cross, dot);
+      float c = cos(angle), s = sin(angle);
+      float residual = 0;
+      for (int i = 0; i < n; i++) {
+        point_t r = ref[((offset + dir * i) % n + n) % n];
+        float ax = lap[i].x - lapX, ay = lap[i].y - lapY;
+        residual += sq(c * ax - s * ay + refX - r.x) + sq(s * ax + c * ay + refY - r.y);
+      }
+      if (residual < bestResidual) {
+        bestResidual = residual;
+        bestAngle = angle;
+        bestX = refX;
+        bestY = refY;
+      }
+    }
+  }
+  float c = cos(bestAngle), s = sin(bestAngle);
+  float sum = 0;
+  for (int i = 0; i < n; i++) {
+    float ax = lap[i].x - lapX, ay = lap[i].y - lapY;
+    point_t pt = { c * ax - s * ay + bestX, s * ax + c * ay + bestY };
+    sum += outlineDistance(outline, pt);
+  }
+  return sum / n;
+}
+
+static void checkLog(const char *logFile, const char *mapFile){
+  std::vector<replay_step_t> steps;
+  std::vector<point_t> outline;
+  CHECK(loadLog((std::string(HOST_DATA_DIR) + logFile).c_str(), steps));
+  CHECK(loadOutline((std::string(HOST_DATA_DIR) + mapFile).c_str(), outline));
+  float lapLength = outlineLength(outline);
+  std::vector<point_t> lap;
+  bool complete = trackLap(steps, lapLength, lap);
+  CHECK(complete);
+  if (!complete) {
+    printf("%s: no complete lap (%.1fm)\n", logFile, lapLength);
+    return;
+  }
+  int n = lap.size();
+  float gap = distance(lap[0].x, lap[0].y, lap[n - 1].x, lap[n - 1].y);
+  float length = outlineLength(lap);
+  double timeSum = 0;
+  hostSerialQuiet = true;
+  for (int k = 0; k < RUNS; k++) {
+    for (int i = 0; i < n; i++) Map.perimeterOutline[i] = lap[i];
+    Map.perimeterOutlineSize = n;
+    double t0 = hostTimeUs();
+    Map.correctOutline();
+    timeSum += hostTimeUs() - t0;
+  }
+  hostSerialQuiet = false;
+  std::vector<point_t> corrected(Map.perimeterOutline, Map.perimeterOutline + Map.perimeterOutlineSize);
+  float maxCorr = 0;
+  for (int i = 0; i < n; i++) maxCorr = max(maxCorr, distance(lap[i].x, lap[i].y, corrected[i].x, corrected[i].y));
+  float closure = distance(corrected[0].x, corrected[0].y, corrected[n - 1].x, corrected[n - 1].y);
+  float correctedLength = outlineLength(corrected);
+  float lengthChange = (correctedLength - length) / length;
+  float lapError = outlineError(lap, outline);
+  float correctedError = outlineError(corrected, outline);
+  printf("%s: lap=%.1fm points=%d closure error=%.3fm corrected=%.3fm length change=%.2f%% max. correction=%.3fm time(us)=%.2f\n",
+    logFile, lapLength, n, gap, closure, lengthChange * 100, maxCorr, timeSum / RUNS);
+  printf("  outline distance mean: lap=%.3fm corrected=%.3fm\n", lapError, correctedError);
+  CHECK((int)corrected.size() == n);
+  CHECK(closure < 0.001);
+  CHECK(correctedError < lapError);
+  CHECK(maxCorr <= gap + 0.001); // error spread: no point moves more than the closure error
+  CHECK(fabs(lengthChange) < 0.05);
+}
+
+
+int main(){
+  checkLog("indoor_track.log", "indoor_map.bin");
+  checkLog("outdoor_track.log", "outdoor_map.bin");
+  return hostTestResult();
+}
@@ -0,0 +1,102 @@
+// fixed-point particle motion: drift of particles moved by MapClass::particlesMotion (coord_t, stochastic rounding)
+// against the same motion in float, without noise, for shallow and steep courses and motion steps of a few
+// millimeter (sub-unit: lost by round to nearest) up to a filter update at full speed - and motion update time of
+// both (identical noise-free motion, noise draws included)
+
+#include "hosttest.h"
+
+#define TRAVEL 20.0   // meter per case
+
+// mean particle position (meter)
+static point_t particlesMean(){
+  double sx = 0, sy = 0;
+  for (int i = 0; i < Map.filter.size(); i++) {
+    sx += fromCoord(Map.filter.x[i]);
+    sy += fromCoord(Map.filter.y[i]);
+  }
+  point_t pt = { (float)(sx / Map.filter.size()), (float)(sy / Map.filter.size()) };
+  return pt;
+}
+
+static float fx[MAP_PARTICLES];
+static float fy[MAP_PARTICLES];
+static float ftheta[MAP_PARTICLES];
+
+// particle motion in float: steps of MapClass::particlesMotion (noise draws, shared course sin/cos) without
+// stochastic rounding
+static void floatMotion(float course, float distance, int n){
+  float sinCourse, cosCourse;
+  float sinNominal, cosNominal;
+  fastSinCos(course, sinNominal, cosNominal);
+  for (int i = 0; i < n; i++) {
+    ftheta[i] += fastGaussRandom() * Map.headingNoise;
+    float angle = ftheta[i] + fastGaussRandom() * Map.steeringNoise;
+    float particleDistance = distance + fastGaussRandom() * Map.distanceNoise;
+    if ((angle < (float)MAP_SMALL_ANGLE) && (angle > -(float)MAP_SMALL_ANGLE)) {
+      float angleSq = angle * angle;
+      float sinAngle = angle * (1.0f - angleSq * (1.0f / 6.0f));
+      float cosAngle = 1.0f - angleSq * (0.5f - angleSq * (1.0f / 24.0f));
+      sinCourse = sinNominal * cosAngle + cosNominal * sinAngle;
+      cosCourse = cosNominal * cosAngle - sinNominal * sinAngle;
+    } else fastSinCos(course + angle, sinCourse, cosCourse);
+    fx[i] += particleDistance * cosCourse;
+    fy[i] += particleDistance * sinCourse;
+  }
+}
+
+static void checkDrift(float course, float step){
+  int n = Map.filter.size();
+  for (int i = 0; i < n; i++) {
+    Map.filter.x[i] = toCoord(10.0);
+    Map.filter.y[i] = toCoord(10.0);
+    Map.filter.theta[i] = 0;
+    fx[i] = 10.0;
+    fy[i] = 10.0;
+    ftheta[i] = 0;
+  }
+  coord_t nx = toCoord(10.0); // single particle with round to nearest (previous conversion)
+  coord_t ny = toCoord(10.0);
+  int steps = (int)(TRAVEL / step);
+  double fixedTime = 0;
+  double floatTime = 0;
+  for (int k = 0; k < steps; k++) {
+    double t0 = hostTimeUs();
+    Map.particlesMotion(course, step);
+    double t1 = hostTimeUs();
+    floatMotion(course, step, n);
+    double t2 = hostTimeUs();
+    fixedTime += t1 - t0;
+    floatTime += t2 - t1;
+    nx += toCoord(step * cos(course));
+    ny += toCoord(step * sin(course));
+  }
+  point_t mean = particlesMean();
+  float drift = distance(mean.x, mean.y, fx[0], fy[0]);
+  float spread = 0;
+  for (int i = 0; i < n; i++) spread = max(spread, distance(fromCoord(Map.filter.x[i]), fromCoord(Map.filter.y[i]), fx[i], fy[i]));
+  float nearestDrift = distance(fromCoord(nx), fromCoord(ny), fx[0], fy[0]);
+  // stochastic rounding: unbiased, random walk of particles (rounding error variance <= 1/4 unit per update and axis)
+  float sigma = sqrt(2 * 0.25 * steps) / COORD_ONE;
+  printf("course=%.2f step=%.3f updates=%d drift(m) mean=%.4f max=%.4f (sigma=%.3f) nearest=%.4f motion(us) map=%.1f float=%.1f\n",
+    course, step, steps, drift, spread, sigma, nearestDrift, fixedTime / steps, floatTime / steps);
+  CHECK(drift < 4 * sigma / sqrt(n));
+  CHECK(spread < 5 * sigma);
+}
+
+
+int main(){
+  fastRandomSeed(1);
+  hostSerialQuiet = true;
+  Map.begin();
+  hostSerialQuiet = false;
+  Map.steeringNoise = 0;
+  Map.distanceNoise = 0;
+  Map.headingNoise = 0;
+  Map.filter.setSize(Map.filter.capacity());
+  float courses[] = { 0.02, 0.1, 0.5, 1.2 };
+  float steps[] = { 0.002, 0.005, 0.06 };
+  for (int c = 0; c < 4; c++) {
+    for (int s = 0; s < 3; s++) checkDrift(courses[c], steps[s]);
+  }
+  return hostTestResult();
+}
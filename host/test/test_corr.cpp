@@ -0,0 +1,137 @@
+// perimeter matched filter: box-sum and SWAR correlation kernels (corrFilter) and multi-code correlation (corrCodes)
+// must give exactly the same magnitude and quality as the reference filter (corrFilterReference) - random, noisy,
+// clipped and code-only signals, sub-sampling 1/2/4, odd output counts, timing of all kernels
+
+#include <Arduino.h>
+#define private public
+#include "perimeter.h"
+#undef private
+#include "hosttest.h"
+
+extern int8_t sigcode_norm[];
+extern int8_t sigcode_diff[];
+
+#define CODE_SIZE 24
+
+
+// test signal: random, code with noise, clipped, code only
+static void makeSignal(int8_t *s, int total, const int8_t *H, int M, int sub, int mode){
+  for (int i = 0; i < total; i++) {
+    int v = random(-128, 128);
+    if (mode == 1) v = v / 4 + H[(i / sub) % M] * 90;
+    if (mode == 2) v = (random(2)) ? 127 : -128;
+    if (mode == 3) v = H[(i / sub) % M] * 127;
+    s[i] = constrain(v, -128, 127);
+  }
+}
+
+static bool sameResult(int16_t m1, float q1, int16_t m2, float q2){
+  return ((m1 == m2) && (memcmp(&q1, &q2, sizeof q1) == 0));
+}
+
+// single code: corrFilter (scalar box sums and SWAR) against reference
+static void checkFilter(){
+  int8_t s[256];
+  long cases = 0;
+  long errors = 0;
+  for (int sub = 1; sub <= 4; sub *= 2) {
+    for (int code = 0; code < 2; code++) {
+      int8_t *H = (code) ? sigcode_diff : sigcode_norm;
+      int total = (255 / (CODE_SIZE * sub)) * CODE_SIZE * sub;
+      for (int trial = 0; trial < 5000; trial++) {
+        makeSignal(s, total, H, CODE_SIZE, sub, trial % 4);
+        int nPts = total - CODE_SIZE * sub - (trial & 1);
+        for (int swar = 0; swar < 2; swar++) {
+          Perimeter.useSwarCorrelation = swar;
+          float q1, q2;
+          int16_t m1 = Perimeter.corrFilterReference(H, sub, CODE_SIZE, s, nPts, q1);
+          int16_t m2 = Perimeter.corrFilter(H, sub, CODE_SIZE, s, nPts, q2);
+          cases++;
+          if (!sameResult(m1, q1, m2, q2)) {
+            if (errors < 5) printf("mismatch swar=%d sub=%d code=%d mag %d %d quality %f %f\n", swar, sub, code, m1, m2, q1, q2);
+            errors++;
+          }
+        }
+      }
+    }
+  }
+  printf("corrFilter cases=%ld errors=%ld\n", cases, errors);
+  CHECK(errors == 0);
+}
+
+// registered codes (perimeter, differential, reversed, short/odd-length code with weights): corrCodes against reference
+static void checkCodes(){
+  int8_t s[256];
+  int8_t rev[CODE_SIZE];
+  for (int i = 0; i < CODE_SIZE; i++) rev[i] = sigcode_diff[CODE_SIZE - 1 - i];
+  int8_t weighted[13] = { 2, -1, 0, 3, -2, 1, 1, 0, -1, -3, 1, 0, 2 };
+  int8_t shortCode[7] = { 1, 1, -1, 1, -1, -1, 1 };
+  long cases = 0;
+  long errors = 0;
+  for (int sub = 1; sub <= 4; sub *= 2) {
+    for (int trial = 0; trial < 2000; trial++) {
+      Perimeter.subSample = sub;
+      Perimeter.useSwarCorrelation = trial & 2;
+      Perimeter.clearCodes();
+      Perimeter.codeCount = 0;
+      Perimeter.mainCode = NULL;
+      CHECK(Perimeter.addCode(sigcode_norm, CODE_SIZE) == 0);
+      Perimeter.addCode(sigcode_diff, CODE_SIZE);
+      Perimeter.addCode(rev, CODE_SIZE);
+      if (trial & 4) Perimeter.addCode(weighted, sizeof weighted);
+        else Perimeter.addCode(shortCode, sizeof shortCode);
+      int total = 192 + (trial % 60);
+      makeSignal(s, total, sigcode_norm, CODE_SIZE, sub, trial % 4);
+      for (int idx = 0; idx < PERIMETER_COILS; idx++) {
+        Perimeter.corrCodes(idx, s, total);
+        for (int c = 0; c < Perimeter.codeCount; c++) {
+          corr_code_t &cc = Perimeter.codes[c];
+          float q;
+          int16_t m = Perimeter.corrFilterReference(cc.H, sub, cc.M, s, total - cc.M * sub, q);
+          cases++;
+          if (!sameResult(m, q, Perimeter.getCodeMagnitude(idx, c), Perimeter.getCodeFilterQuality(idx, c))) {
+            if (errors < 5) printf("mismatch code=%d sub=%d M=%d swar=%d mag %d %d\n", c, sub, cc.M, Perimeter.useSwarCorrelation, m, Perimeter.getCodeMagnitude(idx, c));
+            errors++;
+          }
+        }
+      }
+    }
+  }
+  printf("corrCodes cases=%ld errors=%ld\n", cases, errors);
+  CHECK(errors == 0);
+  Perimeter.clearCodes();
+  Perimeter.useSwarCorrelation = true;
+}
+
+// time per filter call of reference, box-sum and SWAR kernel
+static void timing(){
+  int8_t s[256];
+  const int calls = 20000;
+  for (int sub = 1; sub <= 4; sub *= 2) {
+    int total = (255 / (CODE_SIZE * sub)) * CODE_SIZE * sub;
+    int nPts = total - CODE_SIZE * sub;
+    makeSignal(s, total, sigcode_diff, CODE_SIZE, sub, 1);
+    float q;
+    volatile int sink = 0;
+    double t0 = hostTimeUs();
+    for (int k = 0; k < calls; k++) sink += Perimeter.corrFilterReference(sigcode_diff, sub, CODE_SIZE, s, nPts, q);
+    double t1 = hostTimeUs();
+    Perimeter.useSwarCorrelation = false;
+    for (int k = 0; k < calls; k++) sink += Perimeter.corrFilter(sigcode_diff, sub, CODE_SIZE, s, nPts, q);
+    double t2 = hostTimeUs();
+    Perimeter.useSwarCorrelation = true;
+    for (int k = 0; k < calls; k++) sink += Perimeter.corrFilter(sigcode_diff, sub, CODE_SIZE, s, nPts, q);
+    double t3 = hostTimeUs();
+    printf("sub=%d samples=%d reference(us)=%.2f box(us)=%.2f swar(us)=%.2f\n", sub, total,
+      (t1 - t0) / calls, (t2 - t1) / calls, (t3 - t2) / calls);
+  }
+}
+
+
+int main(){
+  randomSeed(1);
+  checkFilter();
+  checkCodes();
+  timing();
+  return hostTestResult();
+}
@@ -0,0 +1,163 @@
+// map grid: scanline flood fill and two-pass signal transform (transferOutlineToMap) against the recursive
+// reference (original fill and signal painting on a full byte grid) - indoor/outdoor outlines of the Processing
+// map files and synthetic 100x100 / 400x400 grids (timing): side must be equal, signal (coarse signal field) within 
+// the bound of the coarse cell distance (2 * (coarse cell size - 1), see MAP_SIGNAL_CELLS_MAX), wire clearance of 
+// planner (MapClass::isInside) must match reference signal exactly
+
+#include "hosttest.h"
+
+
+// reference grid (row 0 is top of map, like MapClass::getMapCell)
+struct RefGrid {
+  int sizeX;
+  int sizeY;
+  std::vector<map_data_t> cells;
+  map_data_t& at(int x, int y){ return cells[y * sizeX + x]; }
+  bool onMap(int x, int y){ return ((x >= 0) && (x < sizeX) && (y >= 0) && (y < sizeY)); }
+};
+
+// grid resolution chosen by transferOutlineToMap (same float steps as there)
+static float mapMeterPerPixel(){
+  float meterPerPixel = Map.mapResolution;
+  for (int i = 0; (i < 32) && ((float)(1.0 / meterPerPixel) != Map.mapScaleX); i++) meterPerPixel *= 1.25;
+  return meterPerPixel;
+}
+
+// perimeter pixels of current outline (as transferOutlineToMap)
+static void refRasterize(RefGrid &g, float meterPerPixel){
+  map_data_t md;
+  md.v = 0;
+  md.s.side = MAP_DATA_SIDE_OUT;
+  g.sizeX = Map.mapSizeX;
+  g.sizeY = Map.mapSizeY;
+  g.cells.assign(g.sizeX * g.sizeY, md);
+  for (int i = 1; i < Map.perimeterOutlineSize; i++) {
+    float wx = (Map.perimeterOutline[i].x - Map.perimeterOutline[i - 1].x);
+    float wy = (Map.perimeterOutline[i].y - Map.perimeterOutline[i - 1].y);
+    int steps = max(1, max(((int)(fabs(wx) / meterPerPixel)), ((int)(fabs(wy) / meterPerPixel)))) * 2;
+    float stepx = wx / ((float)steps);
+    float stepy = wy / ((float)steps);
+    float x = Map.perimeterOutline[i - 1].x;
+    float y = Map.perimeterOutline[i - 1].y;
+    for (int j = 0; j < steps; j++) {
+      int xp = ((int)(x * Map.mapScaleX));
+      int yp = ((int)(y * Map.mapScaleY));
+      if (g.onMap(xp, yp)) g.at(xp, g.sizeY - 1 - yp).s.signal = MAP_DATA_SIGNAL_MAX;
+      x += stepx;
+      y += stepy;
+    }
+  }
+}
+
+// original inside fill (depth-first, explicit stack instead of recursion)
+static void refFillInside(RefGrid &g, int x, int y){
+  std::vector<cell_t> stack;
+  cell_t c = { (int16_t)x, (int16_t)y };
+  stack.push_back(c);
+  while (!stack.empty()) {
+    c = stack.back();
+    stack.pop_back();
+    if (!g.onMap(c.x, c.y)) continue;
+    map_data_t &md = g.at(c.x, c.y);
+    if (md.s.signal == MAP_DATA_SIGNAL_MAX) continue; // hit perimeter
+    if (md.s.side == MAP_DATA_SIDE_IN) continue; // already visited
+    md.s.side = MAP_DATA_SIDE_IN;
+    md.s.state = MAP_DATA_STATE_UNMOWED;
+    cell_t n[4] = { { (int16_t)(c.x - 1), c.y }, { (int16_t)(c.x + 1), c.y }, { c.x, (int16_t)(c.y - 1) }, { c.x, (int16_t)(c.y + 1) } };
+    for (int i = 0; i < 4; i++) stack.push_back(n[i]);
+  }
+}
+
+// original signal painting (recursion depth is bounded by signal)
+static void refPaintSignal(RefGrid &g, int x, int y, int signalStrength){
+  if (!g.onMap(x, y)) return;
+  map_data_t &md = g.at(x, y);
+  if (md.s.signal >= signalStrength) return;
+  md.s.signal = signalStrength;
+  int strength = max(0, signalStrength - 1);
+  refPaintSignal(g, x - 1, y, strength);
+  refPaintSignal(g, x + 1, y, strength);
+  refPaintSignal(g, x, y - 1, strength);
+  refPaintSignal(g, x, y + 1, strength);
+}
+
+static void refSignal(RefGrid &g){
+  for (int y = 0; y < g.sizeY; y++) {
+    for (int x = 0; x < g.sizeX; x++) {
+      if (g.at(x, y).s.signal == MAP_DATA_SIGNAL_MAX) {
+        g.at(x, y).s.signal = 0;
+        refPaintSignal(g, x, y, MAP_DATA_SIGNAL_MAX);
+      }
+    }
+  }
+}
+
+// transfer outline to map and compare all cells with reference, prints timing
+static void checkOutline(const char *name, const std::vector<point_t> &outline, float resolution){
+  setOutline(outline, OUTLINE_SIZE);
+  Map.mapResolution = resolution;
+  hostSerialQuiet = true;
+  double t0 = hostTimeUs();
+  Map.transferOutlineToMap();
+  double t1 = hostTimeUs();
+  hostSerialQuiet = false;
+  float meterPerPixel = mapMeterPerPixel();
+  RefGrid g;
+  double t2 = hostTimeUs();
+  refRasterize(g, meterPerPixel);
+  refFillInside(g, Map.mapSizeX * 0.3, Map.mapSizeY * 0.3);
+  refSignal(g);
+  double t3 = hostTimeUs();
+  long diffSide = 0;
+  long diffSignal = 0;
+  long diffClearance = 0;
+  int maxSignalError = 0;
+  long inside = 0;
+  for (int y = 0; y < g.sizeY; y++) {
+    for (int x = 0; x < g.sizeX; x++) {
+      map_data_t md = Map.getMapCell(x, y);
+      map_data_t ref = g.at(x, y);
+      if (md.s.side != ref.s.side) diffSide++;
+      int error = abs(md.s.signal - ref.s.signal);
+      maxSignalError = max(maxSignalError, error);
+      if (error > 2 * ((1 << Map.mapSignalShift) - 1)) diffSignal++;
+      if (ref.s.side == MAP_DATA_SIDE_IN) inside++;
+      // inside cells at least radius+1 cells away from perimeter pixels
+      for (int radius = 0; radius < 3; radius++) {
+        bool refClear = ((ref.s.side == MAP_DATA_SIDE_IN) && (MAP_DATA_SIGNAL_MAX - ref.s.signal > radius));
+        if (Map.isInside(x, y, radius) != refClear) diffClearance++;
+      }
+    }
+  }
+  printf("%-8s grid=%dx%d resolution=%.3f signal cells=%d tiles=%d inside=%ld diff side=%ld signal=%ld (max. error %d) clearance=%ld  map(us)=%.0f reference(us)=%.0f\n",
+    name, Map.mapSizeX, Map.mapSizeY, meterPerPixel, 1 << Map.mapSignalShift, Map.mapTilesUsed, inside, diffSide, diffSignal, 
+    maxSignalError, diffClearance, t1 - t0, t3 - t2);
+  CHECK(inside > 0);
+  CHECK(meterPerPixel == resolution);
+  CHECK(Map.mapTileOverflow == 0);
+  CHECK(diffSide == 0);
+  CHECK(diffSignal == 0);
+  CHECK(diffClearance == 0);
+  CHECK(Map.mapCellsInside == inside);
+}
+
+
+int main(){
+  hostSerialQuiet = true;
+  Map.begin();
+  hostSerialQuiet = false;
+  std::vector<point_t> outline;
+  CHECK(loadOutline(HOST_DATA_DIR "indoor_map.bin", outline));
+  CHECK(outline.size() > 100);
+  checkOutline("indoor", outline, 0.05);
+  checkOutline("indoor", outline, MAP_RESOLUTION);
+  CHECK(loadOutline(HOST_DATA_DIR "outdoor_map.bin", outline));
+  CHECK(outline.size() > 100);
+  checkOutline("outdoor", outline, MAP_RESOLUTION);
+  checkOutline("outdoor", outline, 0.3);
+  starOutline(outline, 5, 24);
+  checkOutline("100x100", outline, MAP_RESOLUTION);
+  starOutline(outline, 20, 24);
+  checkOutline("400x400", outline, MAP_RESOLUTION);
+  return hostTestResult();
+}
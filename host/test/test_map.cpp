@@ -0,0 +1,166 @@
+// map grid layers: memory and lookup cost for lawns of 100..1000 m2 at 0.1m resolution (a larger lawn must get a
+// coarser grid, so that every tile with inside cells can hold a mowed tile), mowing by lanes and by random strokes
+// (tile pool usage, no promoted tiles, counters must match a recount), save/load of a zone (only if idle), snapshot/restore and
+// reset of mowed cells
+
+#include "hosttest.h"
+
+
+// tiles of the previous byte grid (one byte per cell): tiles with cells of different value
+static int byteTiles(){
+  int tiles = 0;
+  for (int ty = 0; ty < Map.mapTilesY; ty++) {
+    for (int tx = 0; tx < Map.mapTilesX; tx++) {
+      uint8_t first = Map.getMapCell(tx << MAP_TILE_BITS, ty << MAP_TILE_BITS).v;
+      bool uniform = true;
+      for (int y = ty << MAP_TILE_BITS; (uniform) && (y < min(Map.mapSizeY, (ty + 1) << MAP_TILE_BITS)); y++) {
+        for (int x = tx << MAP_TILE_BITS; x < min(Map.mapSizeX, (tx + 1) << MAP_TILE_BITS); x++) {
+          if (Map.getMapCell(x, y).v != first) uniform = false;
+        }
+      }
+      if (!uniform) tiles++;
+    }
+  }
+  return tiles;
+}
+
+static int layerTiles(int layer){
+  int tiles = 0;
+  for (int i = 0; i < Map.mapTilesX * Map.mapTilesY; i++) {
+    if ((Map.mapLayers[layer][i] & MAP_TILE_UNIFORM) == 0) tiles++;
+  }
+  return tiles;
+}
+
+// map counters must match a recount of all layers
+static bool countersValid(){
+  long inside = Map.mapCellsInside;
+  long mowed = Map.mapCellsMowed;
+  long obstacle = Map.mapCellsObstacle;
+  Map.countMapCells();
+  return ((inside == Map.mapCellsInside) && (mowed == Map.mapCellsMowed) && (obstacle == Map.mapCellsObstacle));
+}
+
+// mow lawn by parallel lanes (lane distance below cutting width)
+static void mowLanes(){
+  float w = Map.mapSizeX / Map.mapScaleX;
+  float h = Map.mapSizeY / Map.mapScaleY;
+  for (float y = 0.1; y < h; y += Map.cuttingWidth - 0.05) Map.mowSegment(0, y, w, y);
+}
+
+// mow lawn by random strokes (every tile partially mowed)
+static void mowRandom(int strokes){
+  float w = Map.mapSizeX / Map.mapScaleX;
+  float h = Map.mapSizeY / Map.mapScaleY;
+  for (int i = 0; i < strokes; i++) {
+    float x = random(1000) / 1000.0 * w;
+    float y = random(1000) / 1000.0 * h;
+    float a = random(1000) / 1000.0 * 2 * PI;
+    Map.mowSegment(x, y, x + cos(a), y + sin(a));
+  }
+}
+
+static void checkLawn(float area){
+  std::vector<point_t> outline;
+  lawnOutline(outline, area);
+  setOutline(outline, OUTLINE_SIZE);
+  Map.mapResolution = MAP_RESOLUTION;
+  hostSerialQuiet = true;
+  Map.transferOutlineToMap();
+  hostSerialQuiet = false;
+  Map.mapValid = true;
+  float resolution = 1.0 / Map.mapScaleX;
+  int sideTiles = layerTiles(MAP_LAYER_SIDE);
+  int dirBytes = MAP_LAYERS * Map.mapTilesX * Map.mapTilesY * sizeof Map.mapLayers[0][0];
+  int signalBytes = (Map.mapSignalSizeX * Map.mapSignalSizeY + 1) / 2;
+  int oldTiles = byteTiles();
+  // lookup cost: cell (all layers) and cell class (measurement model)
+  const int lookups = 1000000;
+  std::vector<cell_t> cells(lookups);
+  for (int i = 0; i < lookups; i++) {
+    cells[i].x = random(Map.mapSizeX);
+    cells[i].y = random(Map.mapSizeY);
+  }
+  volatile int sum = 0;
+  double t0 = hostTimeUs();
+  for (int i = 0; i < lookups; i++) sum += Map.getMapCell(cells[i].x, cells[i].y).v;
+  double t1 = hostTimeUs();
+  for (int i = 0; i < lookups; i++) sum += Map.getMapCellClass(cells[i].x, cells[i].y);
+  double t2 = hostTimeUs();
+  printf("area=%.0f grid=%dx%d resolution=%.3f signal=%.2f inside=%.0fm2 tiles side=%d bytes=%d (byte grid: tiles=%d bytes=%d) cell(ns)=%.1f class(ns)=%.1f\n",
+    area, Map.mapSizeX, Map.mapSizeY, resolution, resolution * (1 << Map.mapSignalShift),
+    Map.mapCellsInside / (Map.mapScaleX * Map.mapScaleY), sideTiles, sideTiles * (int)sizeof Map.mapTilePool[0] + dirBytes + signalBytes,
+    oldTiles, oldTiles * MAP_TILE_CELLS + (int)(Map.mapTilesX * Map.mapTilesY * sizeof(uint16_t)),
+    (t1 - t0) * 1000 / lookups, (t2 - t1) * 1000 / lookups);
+  CHECK(Map.mapTileOverflow == 0);
+  CHECK(Map.mapTilesUsed <= MAP_TILE_POOL_SIZE - MAP_TILE_RESERVE);
+  if (area <= 1000) CHECK(fabs(resolution - MAP_RESOLUTION) < 1e-6);
+    else CHECK(resolution > MAP_RESOLUTION);
+  // mowing by lanes
+  mowLanes();
+  printf("  lanes:  coverage=%.1f%% tiles mowed=%d used=%d promoted=%d (cells=%ld) overflow=%d\n", Map.coverage(),
+    layerTiles(MAP_LAYER_MOWED), Map.mapTilesUsed, Map.mapTilesPromoted, Map.mapCellsPromoted, Map.mapTileOverflow);
+  CHECK(countersValid());
+  CHECK(Map.mapTileOverflow == 0);
+  CHECK(Map.coverage() > 90);
+  // save and load zone (all layers, counters)
+  std::vector<uint8_t> cellsBefore;
+  for (int y = 0; y < Map.mapSizeY; y++) {
+    for (int x = 0; x < Map.mapSizeX; x++) cellsBefore.push_back(Map.getMapCell(x, y).v);
+  }
+  long mowed = Map.mapCellsMowed;
+  hostSerialQuiet = true;
+  Robot.state = STAT_MOW; // no flash writes while mowing
+  CHECK(!Map.saveZone(0, "test"));
+  CHECK(!Map.deleteZone(0));
+  Robot.state = STAT_IDLE;
+  CHECK(Map.saveZone(0, "test"));
+  CHECK(Map.loadMap());
+  hostSerialQuiet = false;
+  int diff = 0;
+  for (int y = 0; y < Map.mapSizeY; y++) {
+    for (int x = 0; x < Map.mapSizeX; x++) {
+      if (Map.getMapCell(x, y).v != cellsBefore[y * Map.mapSizeX + x]) diff++;
+    }
+  }
+  CHECK(diff == 0);
+  CHECK(Map.mapCellsMowed == mowed);
+  // mowed state snapshot (simulation on live map)
+  CHECK(Map.saveMowed());
+  Map.resetMowed();
+  mowRandom(area / 10);
+  CHECK(Map.restoreMowed());
+  diff = 0;
+  for (int y = 0; y < Map.mapSizeY; y++) {
+    for (int x = 0; x < Map.mapSizeX; x++) {
+      if (Map.getMapCell(x, y).v != cellsBefore[y * Map.mapSizeX + x]) diff++;
+    }
+  }
+  CHECK(diff == 0);
+  CHECK(Map.mapCellsMowed == mowed);
+  CHECK(countersValid());
+  // random mowing: every tile partially mowed (worst case for tile pool)
+  Map.resetMowed();
+  CHECK(Map.mapCellsMowed == 0);
+  CHECK(layerTiles(MAP_LAYER_MOWED) == 0);
+  CHECK(countersValid());
+  mowRandom(area * 2);
+  printf("  random: coverage=%.1f%% tiles mowed=%d used=%d promoted=%d (cells=%ld) overflow=%d\n", Map.coverage(),
+    layerTiles(MAP_LAYER_MOWED), Map.mapTilesUsed, Map.mapTilesPromoted, Map.mapCellsPromoted, Map.mapTileOverflow);
+  CHECK(countersValid());
+  CHECK(Map.mapTileOverflow == 0);
+  CHECK(Map.mapTilesPromoted == 0);
+}
+
+
+int main(){
+  randomSeed(1);
+  hostSerialQuiet = true;
+  Map.begin();
+  hostSerialQuiet = false;
+  printf("map grid RAM: directories=%d tile pool=%d signal field=%d MapClass=%d\n", (int)sizeof Map.mapLayers,
+    (int)sizeof Map.mapTilePool, (int)sizeof Map.mapSignal, (int)sizeof(MapClass));
+  float areas[] = { 100, 500, 1000, 2000, 4000 };
+  for (int k = 0; k < 5; k++) checkLawn(areas[k]);
+  return hostTestResult();
+}
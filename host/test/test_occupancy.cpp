@@ -0,0 +1,126 @@
+// occupancy layer: round obstacle (0.3 m) in a 10x5 m lawn, simulated sonar ranges (three sensors, mounting angles
+// and offset of Sonar) from random robot poses - obstacle cells must be marked without false marks, the planner
+// must not pass them, a bumper contact must mark its cell, marks must clear after the obstacle is removed - and
+// update time per sonar evaluation
+
+#include <Arduino.h>
+#define protected public
+#include "map.h"
+#undef protected
+#include "planner.h"
+#include "sonar.h"
+#include "hosttest.h"
+
+#define EVALUATIONS 5000
+#define OBSTACLE_X  6.0
+#define OBSTACLE_Y  2.5
+#define OBSTACLE_R  0.15
+
+static bool obstaclePresent = true;
+
+
+// simulated sonar range (cm) of ray from (x,y) in direction a (no echo: SONAR_RANGE_MAX)
+static unsigned int sonarRange(float x, float y, float a){
+  if (!obstaclePresent) return SONAR_RANGE_MAX;
+  float dx = cos(a), dy = sin(a);
+  float ox = x - OBSTACLE_X, oy = y - OBSTACLE_Y;
+  float b = ox * dx + oy * dy;
+  float c = ox * ox + oy * oy - OBSTACLE_R * OBSTACLE_R;
+  float disc = b * b - c;
+  if (disc < 0) return SONAR_RANGE_MAX;
+  float t = -b - sqrt(disc);
+  if (t < 0) return SONAR_RANGE_MAX;
+  return min((unsigned int)(t * 100), (unsigned int)SONAR_RANGE_MAX);
+}
+
+// sonar evaluations from random poses (robot outside obstacle), returns update time per evaluation (us)
+static double senseRandom(int evaluations){
+  float angles[3] = { SONAR_ANGLE_LEFT / 180.0 * PI, 0, SONAR_ANGLE_RIGHT / 180.0 * PI };
+  double timeSum = 0;
+  for (int k = 0; k < evaluations; k++) {
+    float x = 0.5 + random(900) / 100.0;
+    float y = 0.5 + random(400) / 100.0;
+    if (distance(x, y, OBSTACLE_X, OBSTACLE_Y) < 0.5) continue;
+    float course = random(628) / 100.0;
+    Map.robotState.x = x;
+    Map.robotState.y = y;
+    unsigned int ranges[3];
+    for (int i = 0; i < 3; i++) {
+      ranges[i] = sonarRange(x + SONAR_OFFSET * cos(course), y + SONAR_OFFSET * sin(course), course + angles[i]);
+    }
+    double t0 = hostTimeUs();
+    for (int i = 0; i < 3; i++) Map.senseRange(course, angles[i], ranges[i]);
+    timeSum += hostTimeUs() - t0;
+  }
+  return timeSum / evaluations;
+}
+
+// marked cells (false: not touching or next to obstacle - echo cell of ray cast may be one cell short)
+static void countMarked(int &marked, int &falseMarks){
+  marked = 0;
+  falseMarks = 0;
+  float cell = 1.0 / Map.mapScaleX;
+  for (int yp = 0; yp < Map.mapSizeY; yp++) {
+    for (int xp = 0; xp < Map.mapSizeX; xp++) {
+      if (Map.getMapCell(xp, Map.mapSizeY - 1 - yp).s.state != MAP_DATA_STATE_OBSTACLE) continue;
+      marked++;
+      float d = distance((xp + 0.5) * cell, (yp + 0.5) * cell, OBSTACLE_X, OBSTACLE_Y);
+      if (d > OBSTACLE_R + 1.5 * cell) falseMarks++;
+    }
+  }
+}
+
+
+int main(){
+  randomSeed(1);
+  hostSerialQuiet = true;
+  Map.begin();
+  Planner.begin();
+  hostSerialQuiet = false;
+  std::vector<point_t> outline;
+  point_t corners[4] = { { 0, 0 }, { 10, 0 }, { 10, 5 }, { 0, 5 } };
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 20; j++) {
+      point_t a = corners[i], b = corners[(i + 1) % 4];
+      point_t pt = { a.x + (b.x - a.x) * j / 20, a.y + (b.y - a.y) * j / 20 };
+      outline.push_back(pt);
+    }
+  }
+  setOutline(outline, OUTLINE_SIZE);
+  hostSerialQuiet = true;
+  Map.transferOutlineToMap();
+  hostSerialQuiet = false;
+  Map.mapValid = true;
+  long inside = Map.mapCellsInside;
+  CHECK(Planner.isLineClear(OBSTACLE_X - 1, OBSTACLE_Y, OBSTACLE_X + 1, OBSTACLE_Y));
+  // sonar marks obstacle
+  double timeUs = senseRandom(EVALUATIONS);
+  int marked, falseMarks;
+  countMarked(marked, falseMarks);
+  printf("sonar: evaluations=%d marked=%d false=%d obstacle cells=%ld occupancy cells=%d rejected=%ld update(us)=%.2f\n",
+    EVALUATIONS, marked, falseMarks, Map.mapCellsObstacle, Map.occupancy.cells, Map.occupancy.rejected, timeUs);
+  CHECK(marked > 0);
+  CHECK(falseMarks == 0);
+  CHECK(Map.mapCellsObstacle == marked);
+  CHECK(Map.mapCellsInside + Map.mapCellsObstacle == inside);
+  CHECK(!Planner.isLineClear(OBSTACLE_X - 1, OBSTACLE_Y, OBSTACLE_X + 1, OBSTACLE_Y));
+  // obstacle removed: sonar rays clear marks
+  obstaclePresent = false;
+  senseRandom(EVALUATIONS);
+  countMarked(marked, falseMarks);
+  printf("sonar (obstacle removed): marked=%d obstacle cells=%ld\n", marked, Map.mapCellsObstacle);
+  CHECK(marked == 0);
+  CHECK(Map.mapCellsObstacle == 0);
+  CHECK(Map.mapCellsInside == inside);
+  CHECK(Planner.isLineClear(OBSTACLE_X - 1, OBSTACLE_Y, OBSTACLE_X + 1, OBSTACLE_Y));
+  // bumper contact ahead of robot marks its cell at once
+  Map.robotState.x = 3.0;
+  Map.robotState.y = 2.0;
+  Map.senseContact(0);
+  int xp = (int)floor((3.0 + MAP_BUMPER_DISTANCE) * Map.mapScaleX);
+  int yp = (int)floor(2.0 * Map.mapScaleY);
+  printf("bumper: obstacle cells=%ld\n", Map.mapCellsObstacle);
+  CHECK(Map.getMapCell(xp, Map.mapSizeY - 1 - yp).s.state == MAP_DATA_STATE_OBSTACLE);
+  CHECK(Map.mapCellsObstacle == 1);
+  return hostTestResult();
+}
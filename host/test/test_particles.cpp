@@ -0,0 +1,122 @@
+// particle filter (ParticleFilter): systematic resampling keeps the weighted distribution (copies of each particle
+// within one of N * weight), the extra copies are moved to the slots of dropped particles with their complete
+// state, resampling is triggered by the effective sample size, KLD-sampling grows and shrinks the particle count
+// with the occupied bins
+
+#include "hosttest.h"
+
+#define POOL 1000
+
+static ParticleFilter<float, POOL> pf;
+
+// particle i: x = i * spacing, state (y, theta) derived from x - a copy must keep all of it
+static void setParticles(int n, float spacing){
+  pf.setSize(n);
+  for (int i = 0; i < pf.size(); i++) {
+    pf.x[i] = i * spacing;
+    pf.y[i] = 2 * i * spacing;
+    pf.theta[i] = pf.x[i] * 0.001;
+  }
+}
+
+static bool isStateKept(){
+  for (int i = 0; i < pf.size(); i++) {
+    if ((pf.y[i] != 2 * pf.x[i]) || (pf.theta[i] != (float)(pf.x[i] * 0.001))) return false;
+  }
+  return true;
+}
+
+// copies of each particle after resampling against expected copies (N * weight)
+static void checkDistribution(){
+  pf.minSize = POOL; // fixed particle count
+  pf.maxSize = POOL;
+  pf.resampleThreshold = 2.0; // resample on each update
+  setParticles(POOL, 1.0);
+  static float weights[POOL];
+  for (int i = 0; i < POOL; i++) {
+    pf.weights[i] = (i % 3 == 0) ? 0 : fastRandomFloat() * fastRandomFloat();
+  }
+  pf.normalize();
+  for (int i = 0; i < POOL; i++) weights[i] = pf.weights[i];
+  bool resampled = pf.resample(fastRandomFloat());
+  static int copies[POOL];
+  for (int i = 0; i < POOL; i++) copies[i] = 0;
+  for (int i = 0; i < pf.size(); i++) copies[(int)pf.x[i]]++;
+  float maxError = 0;
+  int dropped = 0;
+  for (int i = 0; i < POOL; i++) {
+    maxError = max(maxError, (float)fabs(copies[i] - POOL * weights[i]));
+    if (copies[i] == 0) dropped++;
+  }
+  printf("resample particles=%d dropped=%d copies max. error=%.3f (< 1)\n", pf.size(), dropped, maxError);
+  CHECK(resampled);
+  CHECK(pf.size() == POOL);
+  CHECK(maxError < 1);
+  CHECK(isStateKept());
+  CHECK(fabs(pf.effectiveSize - POOL) < 0.5); // weights reset
+}
+
+// effective sample size: resampling below threshold (half the particles without weight: ESS N/2)
+static void checkTrigger(){
+  pf.minSize = POOL;
+  pf.maxSize = POOL;
+  pf.resampleThreshold = 0.5;
+  setParticles(POOL, 1.0);
+  pf.normalize();
+  CHECK(fabs(pf.effectiveSize - POOL) < 0.5);
+  CHECK(!pf.resample(fastRandomFloat()));
+  unsigned long resampleCount = pf.resampleCount;
+  for (int i = 0; i < POOL; i++) pf.weights[i] = (i < POOL / 2 + 10) ? 1 : 0;
+  pf.normalize();
+  bool aboveThreshold = pf.resample(fastRandomFloat());
+  for (int i = 0; i < POOL; i++) pf.weights[i] = (i < POOL / 2 - 10) ? 1 : 0;
+  pf.normalize();
+  float ess = pf.effectiveSize;
+  bool belowThreshold = pf.resample(fastRandomFloat());
+  printf("trigger ess=%.1f resampled=%d (threshold %.0f)\n", ess, belowThreshold, pf.resampleThreshold * POOL);
+  CHECK(!aboveThreshold);
+  CHECK(belowThreshold);
+  CHECK(pf.resampleCount == resampleCount + 1);
+}
+
+// KLD-sampling: particles of one bin shrink to minSize, particles over many bins grow towards maxSize
+static void checkKld(){
+  pf.minSize = 50;
+  pf.maxSize = POOL;
+  pf.resampleThreshold = 0.5;
+  int lastSize = 0;
+  bool monotonic = true;
+  for (int k = 1; k < 2000; k++) {
+    if (pf.kldSize(k) < lastSize) monotonic = false;
+    lastSize = pf.kldSize(k);
+  }
+  CHECK(monotonic);
+  CHECK(pf.kldSize(1) == pf.minSize);
+  CHECK(pf.kldSize(2000) == pf.maxSize);
+  // all particles in one bin
+  setParticles(POOL, 0.0001);
+  pf.normalize();
+  CHECK(pf.resample(fastRandomFloat()));
+  int shrunk = pf.size();
+  CHECK(shrunk == pf.minSize);
+  CHECK(pf.kldBins == 1);
+  // one particle per bin (100 particles): more bins than particles can represent
+  pf.minSize = 100;
+  setParticles(100, 1.0);
+  pf.normalize();
+  CHECK(pf.resample(fastRandomFloat()));
+  int grown = pf.size();
+  printf("kld shrink=%d (bins=1) grow=%d (bins=100 kldSize=%d)\n", shrunk, grown, pf.kldSize(100));
+  CHECK(grown == pf.kldSize(100));
+  CHECK(grown > 100);
+  CHECK(isStateKept()); // new slots hold copies
+}
+
+
+int main(){
+  fastRandomSeed(1);
+  checkDistribution();
+  checkTrigger();
+  checkKld();
+  return hostTestResult();
+}
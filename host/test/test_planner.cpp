@@ -0,0 +1,230 @@
+// path planner: planning time, expansions and arena use (PLANNER_PATH_NODES) for paths between random points of
+// lawns of 500, 1000 and 2000 m2 with obstacles - paths must be found (coarser planning grid if the arena is full) and
+// optimal on their grid (same cost as an unbounded reference search), obstacle marked on a path: incremental
+// repair must give the cost of a full search - lane route driven by nextWaypoint: transits to segments must be clear
+// (unreachable segments are skipped)
+
+#include <Arduino.h>
+#define protected public
+#include "planner.h"
+#undef protected
+#include "hosttest.h"
+
+#define PATHS 200
+
+typedef GridSearch<30000, 4096> reference_search_t;
+
+static reference_search_t reference;
+
+
+// obstacle block (map cells, lower left corner)
+static void markObstacle(int x0, int y0, int w, int h, bool obstacle){
+  for (int yp = y0; yp < y0 + h; yp++) {
+    for (int xp = x0; xp < x0 + w; xp++) {
+      if ((xp < 0) || (yp < 0) || (xp >= Map.mapSizeX) || (yp >= Map.mapSizeY)) continue;
+      int row = Map.mapSizeY - 1 - yp;
+      map_data_t md = Map.getMapCell(xp, row);
+      if (md.s.side != MAP_DATA_SIDE_IN) continue;
+      md.s.state = (obstacle) ? MAP_DATA_STATE_OBSTACLE : MAP_DATA_STATE_UNMOWED;
+      Map.setMapCell(xp, row, md);
+    }
+  }
+}
+
+static point_t randomPoint(){
+  int clearance = (int)ceil(PLANNER_WIRE_CLEARANCE * Map.mapScaleX);
+  point_t pt = { 0, 0 };
+  for (int trial = 0; trial < 10000; trial++) {
+    int xp = random(Map.mapSizeX);
+    int yp = random(Map.mapSizeY);
+    if (!PlannerClass::isMowableCell(xp, yp, clearance)) continue;
+    pt.x = (xp + 0.5) / Map.mapScaleX;
+    pt.y = (yp + 0.5) / Map.mapScaleY;
+    break;
+  }
+  return pt;
+}
+
+// reference planning grid (same cost as planner, see pathCellCost): map cells per planning cell
+static int refCells = 1;
+static int refClearance = 1;
+
+static void setReferenceGrid(int level){
+  refCells = max(1, (int)(PLANNER_PATH_CELL_SIZE * Map.mapScaleX + 0.5)) << level;
+  refClearance = max(1, (int)ceil(PLANNER_PATH_CLEARANCE * Map.mapScaleX));
+}
+
+static uint8_t referenceCellCost(int px, int py){
+  uint8_t cost = PLANNER_COST_MOWED;
+  for (int yp = py * refCells; yp < (py + 1) * refCells; yp++) {
+    for (int xp = px * refCells; xp < (px + 1) * refCells; xp++) {
+      if (!PlannerClass::isMowableCell(xp, yp, refClearance)) return 0;
+      if (Map.getMapCell(xp, Map.mapSizeY - 1 - yp).s.state == MAP_DATA_STATE_UNMOWED) cost = PLANNER_COST_UNMOWED;
+    }
+  }
+  return cost;
+}
+
+// planning cell of point on grid of level (cell of planner: a blocked cell is replaced by a reachable free cell,
+// see PlannerClass::levelCell) - returns false if there is none
+static bool levelCell(point_t pt, int level, int &x, int &y){
+  bool ok = Planner.levelCell(level, pt.x, pt.y, x, y);
+  setReferenceGrid(level);
+  return ok;
+}
+
+// path cost from point to target on planning grid of level (unbounded search)
+static uint16_t referenceCost(point_t from, point_t to, int level){
+  int sx, sy, gx, gy;
+  if ((!levelCell(from, level, sx, sy)) || (!levelCell(to, level, gx, gy))) return GRID_SEARCH_INFINITE;
+  reference.plan(sx, sy, gx, gy);
+  return reference.cost(sx, sy);
+}
+
+// path cost of planner from point
+static uint16_t plannerCost(point_t from){
+  int sx, sy;
+  if (!levelCell(from, Planner.pathLevel, sx, sy)) return GRID_SEARCH_INFINITE;
+  return Planner.search.cost(sx, sy);
+}
+
+static void checkRoute(){
+  point_t pos = randomPoint();
+  Map.robotState.x = pos.x;
+  Map.robotState.y = pos.y;
+  hostSerialQuiet = true;
+  Planner.planLanes(0);
+  int moves = 0;
+  int blocked = 0;
+  point_t pt;
+  while (Planner.nextWaypoint(pos.x, pos.y, pt)) {
+    if ((Planner.routeIndex & 1) == 1) {
+      // transit (or path) to segment start
+      if ((!Planner.isLineClear(pos.x, pos.y, pt.x, pt.y)) && (!Planner.isMapLineClear(pos.x, pos.y, pt.x, pt.y))) blocked++;
+    }
+    pos = pt;
+    moves++;
+  }
+  hostSerialQuiet = false;
+  printf("  route: segments=%d moves=%d skipped=%d blocked=%d\n", Planner.segmentCount, moves, Planner.skippedCount, blocked);
+  CHECK(moves > 0);
+  CHECK(blocked == 0);
+  Planner.clear();
+}
+
+static void checkLawn(float area){
+  std::vector<point_t> outline;
+  lawnOutline(outline, area);
+  setOutline(outline, OUTLINE_SIZE);
+  Map.mapResolution = MAP_RESOLUTION;
+  hostSerialQuiet = true;
+  Map.transferOutlineToMap();
+  hostSerialQuiet = false;
+  Map.mapValid = true;
+  // obstacles: blocks of 1-2m and a wall across the lawn (paths must detour)
+  int blocks = area / 50;
+  for (int i = 0; i < blocks; i++) {
+    int w = (int)((1.0 + random(100) / 100.0) * Map.mapScaleX);
+    int h = (int)((1.0 + random(100) / 100.0) * Map.mapScaleY);
+    markObstacle(random(Map.mapSizeX), random(Map.mapSizeY), w, h, true);
+  }
+  markObstacle(Map.mapSizeX / 4, Map.mapSizeY / 2, Map.mapSizeX / 2, (int)(0.3 * Map.mapScaleY), true);
+  reference.begin(referenceCellCost, PLANNER_COST_MOWED, 1000000);
+  int found = 0;
+  int referenceFound = 0;
+  int overflows = 0;
+  int refined = 0;
+  int coarse = 0;
+  int costErrors = 0;
+  double timeSum = 0;
+  double timeMax = 0;
+  long expSum = 0;
+  long expMax = 0;
+  int nodesMax = 0;
+  int referenceNodesMax = 0;
+  int replans = 0;
+  int replanErrors = 0;
+  double incrementalSum = 0;
+  double fullSum = 0;
+  long incrementalExp = 0;
+  long fullExp = 0;
+  for (int i = 0; i < PATHS; i++) {
+    point_t from = randomPoint();
+    point_t to = randomPoint();
+    double t0 = hostTimeUs();
+    bool ok = Planner.planPath(from.x, from.y, to.x, to.y);
+    double t1 = hostTimeUs();
+    timeSum += t1 - t0;
+    timeMax = max(timeMax, t1 - t0);
+    expSum += Planner.search.expansions;
+    expMax = max(expMax, Planner.search.expansions);
+    nodesMax = max(nodesMax, Planner.search.nodeCount);
+    if (Planner.search.overflow) overflows++;
+    if (Planner.pathLevel > 0) coarse++;
+    uint16_t cost = (ok) ? plannerCost(from) : GRID_SEARCH_INFINITE;
+    if (referenceCost(from, to, 0) != GRID_SEARCH_INFINITE) referenceFound++;
+    referenceNodesMax = max(referenceNodesMax, reference.nodeCount);
+    if (!ok) continue;
+    found++;
+    if (Planner.search.nodeCount == 0) { // coarse path with legs searched on finest grid (see refinePath)
+      refined++;
+      continue;
+    }
+    if (cost != referenceCost(from, to, Planner.pathLevel)) costErrors++;
+    if (Planner.pathCount < 2) continue;
+    // obstacle at first waypoint: incremental repair against full search
+    point_t obstacle = Planner.path[0];
+    int size = PLANNER_BENCH_OBSTACLE;
+    int x0 = (int)(obstacle.x * Map.mapScaleX) - size / 2;
+    int y0 = (int)(obstacle.y * Map.mapScaleY) - size / 2;
+    markObstacle(x0, y0, size, size, true);
+    setReferenceGrid(Planner.pathLevel);
+    for (int yp = y0; yp < y0 + size; yp++) {
+      for (int xp = x0; xp < x0 + size; xp++) Planner.search.cellChanged(xp / refCells, yp / refCells);
+    }
+    t0 = hostTimeUs();
+    bool repaired = Planner.replanPath(from.x, from.y);
+    t1 = hostTimeUs();
+    long exp = Planner.search.expansions;
+    int level = Planner.pathLevel;
+    uint16_t repairedCost = (repaired) ? plannerCost(from) : GRID_SEARCH_INFINITE;
+    double t2 = hostTimeUs();
+    bool full = Planner.planPath(from.x, from.y, to.x, to.y);
+    double t3 = hostTimeUs();
+    uint16_t fullCost = (full) ? plannerCost(from) : GRID_SEARCH_INFINITE;
+    if ((repaired) && (full) && (Planner.pathLevel == level)) {
+      replans++;
+      incrementalSum += t1 - t0;
+      fullSum += t3 - t2;
+      incrementalExp += exp;
+      fullExp += Planner.search.expansions;
+      if (repairedCost != fullCost) replanErrors++;
+    }
+    markObstacle(x0, y0, size, size, false);
+  }
+  Planner.clear();
+  printf("area=%.0f grid=%dx%d paths=%d found=%d (reference=%d) coarse=%d refined=%d overflow=%d avg(us)=%.1f max(us)=%.1f expansions avg=%ld max=%ld nodes(max)=%d/%d (reference=%d) cost errors=%d\n",
+    area, Map.mapSizeX, Map.mapSizeY, PATHS, found, referenceFound, coarse, refined, overflows, timeSum / PATHS, timeMax,
+    expSum / PATHS, expMax, nodesMax, PLANNER_PATH_NODES, referenceNodesMax, costErrors);
+  if (replans > 0) printf("  replan: paths=%d incremental(us)=%.1f expansions=%ld full(us)=%.1f expansions=%ld cost errors=%d\n",
+    replans, incrementalSum / replans, incrementalExp / replans, fullSum / replans, fullExp / replans, replanErrors);
+  CHECK(costErrors == 0);
+  CHECK(replanErrors == 0);
+  CHECK(replans > 0);
+  CHECK(found == referenceFound);
+  checkRoute();
+}
+
+
+int main(){
+  randomSeed(1);
+  hostSerialQuiet = true;
+  Map.begin();
+  Planner.begin();
+  hostSerialQuiet = false;
+  printf("planner RAM: search=%d segments=%d PlannerClass=%d\n", (int)sizeof Planner.search,
+    (int)(sizeof Planner.segments + sizeof Planner.route), (int)sizeof(PlannerClass));
+  float areas[] = { 500, 1000, 2000 };
+  for (int k = 0; k < 3; k++) checkLawn(areas[k]);
+  return hostTestResult();
+}
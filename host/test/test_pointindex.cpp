@@ -0,0 +1,74 @@
+// nearest point queries: PointIndex against linear scan (same squared distances) for outlines of 150, 1000 and
+// 5000 points (0.1m spacing), query timing of both - and map closure distance (distanceToStart)
+
+#include "hosttest.h"
+
+
+template <int N, int BUCKETS> void checkIndex(){
+  static point_t pts[N];
+  static PointIndex<float, N, BUCKETS> index;
+  float radius = ((float)N) * 0.1 / (2 * PI);
+  index.begin(&pts[0].x, &pts[0].y, sizeof(point_t) / sizeof(float), MAP_INDEX_CELL_SIZE);
+  for (int i = 0; i < N; i++) {
+    float r = radius * (1.0 + 0.2 * sin(((float)i) / N * 14 * PI)); // wavy outline
+    pts[i].x = cos(((float)i) / N * 2 * PI) * r;
+    pts[i].y = sin(((float)i) / N * 2 * PI) * r;
+    index.add(i);
+  }
+  // queries near outline (particles) and far from it
+  const int queries = 2000;
+  static point_t q[queries];
+  for (int k = 0; k < queries; k++) {
+    int i = random(N);
+    float spread = (k % 10 == 0) ? 20.0 : 1.0;
+    q[k].x = pts[i].x + (random(1000) / 1000.0 - 0.5) * spread;
+    q[k].y = pts[i].y + (random(1000) / 1000.0 - 0.5) * spread;
+  }
+  static float scanDist[queries];
+  double t0 = hostTimeUs();
+  for (int k = 0; k < queries; k++) {
+    float best = 1e9;
+    for (int j = 0; j < N; j++) best = min(best, sq(q[k].x - pts[j].x) + sq(q[k].y - pts[j].y));
+    scanDist[k] = best;
+  }
+  double t1 = hostTimeUs();
+  int errors = 0;
+  volatile float sum = 0;
+  for (int k = 0; k < queries; k++) {
+    float d = index.nearestSq(q[k].x, q[k].y);
+    sum += d;
+    if (d != scanDist[k]) errors++;
+  }
+  double t2 = hostTimeUs();
+  // prefix queries (first points only)
+  for (int k = 0; k < queries; k++) {
+    int maxId = 1 + random(N);
+    float best = 1e9;
+    for (int j = 0; j < maxId; j++) best = min(best, sq(q[k].x - pts[j].x) + sq(q[k].y - pts[j].y));
+    if (index.nearestSq(q[k].x, q[k].y, maxId) != best) errors++;
+  }
+  printf("points=%d scan(us)=%.3f index(us)=%.3f speedup=%.1f errors=%d\n", N, (t1 - t0) / queries, (t2 - t1) / queries,
+    (t1 - t0) / (t2 - t1), errors);
+  CHECK(errors == 0);
+}
+
+
+int main(){
+  randomSeed(1);
+  checkIndex<150, 64>();
+  checkIndex<1000, 256>();
+  checkIndex<5000, 1024>();
+  // map closure: distance to first outline points
+  hostSerialQuiet = true;
+  Map.begin();
+  std::vector<point_t> outline;
+  starOutline(outline, 5, OUTLINE_SIZE);
+  setOutline(outline, OUTLINE_SIZE);
+  hostSerialQuiet = false;
+  float best = 1e9;
+  for (int i = 0; i < MAP_START_POINTS; i++) best = min(best, distance(1, 2, Map.perimeterOutline[i].x, Map.perimeterOutline[i].y));
+  CHECK(fabs(Map.distanceToStart(1, 2) - best) < 1e-5);
+  Map.perimeterOutlineSize = MAP_START_POINTS; // too few points for closure
+  CHECK(Map.distanceToStart(1, 2) > 9999);
+  return hostTestResult();
+}
@@ -0,0 +1,155 @@
+// fast random numbers for particle motion: distribution statistics of fastGaussRandom (moments, tail fractions,
+// histogram against normal density) and fastRandomFloat (chi-square of histogram), fastSinCos error, course
+// accuracy of particlesMotion (shared sin/cos of nominal course) and motion step time against the previous
+// version (gauss() and sin/cos per particle)
+
+#include "hosttest.h"
+
+#define SAMPLES 1000000
+#define BINS    100
+
+static void checkGauss(){
+  double sum = 0, sqSum = 0, cubeSum = 0, quadSum = 0;
+  int tail2 = 0, tail3 = 0;
+  static int hist[BINS]; // -5..5
+  for (int i = 0; i < SAMPLES; i++) {
+    double v = fastGaussRandom();
+    sum += v;
+    sqSum += v * v;
+    cubeSum += v * v * v;
+    quadSum += v * v * v * v;
+    if (fabs(v) > 2) tail2++;
+    if (fabs(v) > 3) tail3++;
+    int b = (int)floor((v + 5) / 10 * BINS);
+    if ((b >= 0) && (b < BINS)) hist[b]++;
+  }
+  double mean = sum / SAMPLES;
+  double variance = sqSum / SAMPLES - mean * mean;
+  double skewness = cubeSum / SAMPLES;
+  double kurtosis = quadSum / SAMPLES;
+  // histogram against normal density (bins with expected count >= 100)
+  double chi = 0;
+  int dof = 0;
+  for (int b = 0; b < BINS; b++) {
+    double lo = -5 + 10.0 * b / BINS;
+    double hi = lo + 10.0 / BINS;
+    double expected = SAMPLES * 0.5 * (erf(hi / sqrt(2.0)) - erf(lo / sqrt(2.0)));
+    if (expected < 100) continue;
+    chi += sq(hist[b] - expected) / expected;
+    dof++;
+  }
+  printf("fastGaussRandom samples=%d mean=%.4f variance=%.4f skewness=%.4f kurtosis=%.4f >2sigma=%.4f (0.0455) >3sigma=%.5f (0.0027) chi2=%.1f (bins=%d)\n",
+    SAMPLES, mean, variance, skewness, kurtosis, ((float)tail2) / SAMPLES, ((float)tail3) / SAMPLES, chi, dof);
+  CHECK(fabs(mean) < 0.01);
+  CHECK(fabs(variance - 1) < 0.01);
+  CHECK(fabs(skewness) < 0.02);
+  CHECK(fabs(kurtosis - 3) < 0.05);
+  CHECK(fabs(((float)tail2) / SAMPLES - 0.0455) < 0.002);
+  CHECK(fabs(((float)tail3) / SAMPLES - 0.0027) < 0.0005);
+  CHECK(chi < 2 * dof);
+}
+
+static void checkUniform(){
+  static int hist[BINS];
+  float minV = 1, maxV = 0;
+  for (int i = 0; i < SAMPLES; i++) {
+    float v = fastRandomFloat();
+    minV = min(minV, v);
+    maxV = max(maxV, v);
+    hist[min(BINS - 1, (int)(v * BINS))]++;
+  }
+  double expected = ((double)SAMPLES) / BINS;
+  double chi = 0;
+  for (int b = 0; b < BINS; b++) chi += sq(hist[b] - expected) / expected;
+  printf("fastRandomFloat samples=%d min=%.6f max=%.6f chi2=%.1f (bins=%d)\n", SAMPLES, minV, maxV, chi, BINS);
+  CHECK((minV > 0) && (maxV < 1));
+  CHECK(chi < 2 * BINS);
+}
+
+static void checkSinCos(){
+  float maxError = 0;
+  for (int i = 0; i < 100000; i++) {
+    float angle = (((float)i) / 100000.0 - 0.5) * 8 * PI;
+    float s, c;
+    fastSinCos(angle, s, c);
+    maxError = max(maxError, (float)max(fabs(s - sin(angle)), fabs(c - cos(angle))));
+  }
+  printf("fastSinCos max error=%.6f\n", maxError);
+  CHECK(maxError < 1e-4);
+}
+
+// particle course: nominal course plus heading offset (small angle expansion, larger offsets by table)
+static void checkMotionCourse(){
+  Map.steeringNoise = 0;
+  Map.distanceNoise = 0;
+  Map.headingNoise = 0;
+  int n = Map.filter.size();
+  float maxError = 0;
+  for (int k = 0; k < 8; k++) {
+    float course = -PI + k * PI / 4 + 0.1;
+    for (int i = 0; i < n; i++) {
+      Map.filter.x[i] = toCoord(-100);
+      Map.filter.y[i] = toCoord(-100);
+      Map.filter.theta[i] = (((float)i) / n - 0.5) * 0.8; // -0.4..0.4 rad
+    }
+    Map.particlesMotion(course, 150);
+    for (int i = 0; i < n; i++) {
+      float x = -100 + 150 * cos(course + Map.filter.theta[i]);
+      float y = -100 + 150 * sin(course + Map.filter.theta[i]);
+      maxError = max(maxError, distance(x, y, fromCoord(Map.filter.x[i]), fromCoord(Map.filter.y[i])));
+    }
+  }
+  printf("particlesMotion course max error=%.4f m (150 m)\n", maxError);
+  CHECK(maxError < 150 * 0.0002);
+}
+
+// motion step time: previous version (gauss() and sin/cos per particle, same heading offset drift) against
+// particlesMotion
+static void benchmarkMotion(){
+  Map.steeringNoise = MAP_STEERING_NOISE;
+  Map.distanceNoise = MAP_DISTANCE_NOISE;
+  Map.headingNoise = 0.001;
+  int n = Map.filter.size();
+  const int runs = 2000;
+  volatile float sink = 0;
+  for (int i = 0; i < n; i++) {
+    Map.filter.x[i] = toCoord(10);
+    Map.filter.y[i] = toCoord(10);
+    Map.filter.theta[i] = fastGaussRandom() * MAP_HEADING_BIAS_INIT;
+  }
+  double t0 = hostTimeUs();
+  for (int k = 0; k < runs; k++) {
+    float course = (k % 64) * 0.1;
+    for (int i = 0; i < n; i++) {
+      Map.filter.theta[i] = gauss(Map.filter.theta[i], Map.headingNoise);
+      float particleCourse = gauss(course + Map.filter.theta[i], Map.steeringNoise);
+      float particleDistance = gauss(0.05, Map.distanceNoise);
+      Map.filter.x[i] += toCoord(particleDistance * cos(particleCourse));
+      Map.filter.y[i] += toCoord(particleDistance * sin(particleCourse));
+    }
+    sink += Map.filter.x[0];
+  }
+  double t1 = hostTimeUs();
+  for (int k = 0; k < runs; k++) {
+    Map.particlesMotion((k % 64) * 0.1, 0.05);
+    sink += Map.filter.x[0];
+  }
+  double t2 = hostTimeUs();
+  printf("motion step particles=%d gauss+sin/cos(us)=%.1f particlesMotion(us)=%.1f speedup=%.1f\n", n,
+    (t1 - t0) / runs, (t2 - t1) / runs, (t1 - t0) / (t2 - t1));
+}
+
+
+int main(){
+  fastRandomSeed(1);
+  hostSerialQuiet = true;
+  Map.begin();
+  hostSerialQuiet = false;
+  Map.filter.setSize(Map.filter.capacity());
+  checkGauss();
+  checkUniform();
+  checkSinCos();
+  checkMotionCourse();
+  benchmarkMotion();
+  return hostTestResult();
+}
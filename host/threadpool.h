@@ -0,0 +1,74 @@
+// parallel host runs: jobs 0..n-1 are processed by worker threads, each worker has its own sketch singletons
+// (Map, Planner, ... see SUNRAY_INSTANCE) - setup runs once per worker before its first job (e.g. Map.begin),
+// work stealing: each worker gets a block of consecutive jobs (similar jobs share worker state, e.g. the map)
+// and takes them from the front of its queue, an idle worker steals from the back of the longest other queue
+//
+// usage:
+//   hostParallel(jobs, threads, [](){ Map.begin(); }, [&](int job){ results[job] = ...; });
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <Arduino.h>
+
+
+// worker threads (0: one per core)
+static inline int hostThreads(int threads){
+  if (threads > 0) return threads;
+  return max(1, (int)std::thread::hardware_concurrency());
+}
+
+struct host_queue_t {
+  std::mutex lock;
+  std::deque<int> jobs;
+};
+
+// next job of worker: own queue front, else back of longest other queue (-1: all done)
+static inline int hostNextJob(std::vector<host_queue_t> &queues, int worker){
+  host_queue_t &own = queues[worker];
+  {
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (!own.jobs.empty()) {
+      int job = own.jobs.front();
+      own.jobs.pop_front();
+      return job;
+    }
+  }
+  while (true) {
+    int victim = -1;
+    size_t longest = 0;
+    for (int w = 0; w < (int)queues.size(); w++) {
+      if (w == worker) continue;
+      std::lock_guard<std::mutex> guard(queues[w].lock);
+      if (queues[w].jobs.size() > longest) {
+        longest = queues[w].jobs.size();
+        victim = w;
+      }
+    }
+    if (victim < 0) return -1;
+    std::lock_guard<std::mutex> guard(queues[victim].lock);
+    if (queues[victim].jobs.empty()) continue; // taken meanwhile
+    int job = queues[victim].jobs.back();
+    queues[victim].jobs.pop_back();
+    return job;
+  }
+}
+
+static inline void hostParallel(int jobs, int threads, std::function<void()> setup, std::function<void(int)> run){
+  threads = min(hostThreads(threads), max(1, jobs));
+  std::vector<host_queue_t> queues(threads);
+  for (int t = 0; t < threads; t++) {
+    for (int job = jobs * t / threads; job < jobs * (t + 1) / threads; job++) queues[t].jobs.push_back(job);
+  }
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.push_back(std::thread([&, t](){
+      hostSerialQuiet = true;
+      setup();
+      for (int job = hostNextJob(queues, t); job >= 0; job = hostNextJob(queues, t)) run(job);
+    }));
+  }
+  for (int t = 0; t < threads; t++) workers[t].join();
+}
+
+#endif
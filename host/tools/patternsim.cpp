@@ -0,0 +1,117 @@
+// mowing pattern simulator: random mowing vs. lanes (PlannerClass::simulateRun, differential drive at motor rpm) on
+// the perimeter outlines of the Processing map files, runs from random starts are spread over all cores - writes a
+// CSV line per map, pattern and rpm (time to 90/99% coverage, travel distance, coverage, mowing rate) to stdout
+//
+//   ./build/patternsim [runs] [threads] [rpm,rpm,...]     e.g. ./build/patternsim 50 0 15,20,25 > patterns.csv
+
+#include "planner.h"
+#include "motor.h"
+#include "hosttest.h"
+#include "threadpool.h"
+
+static const char *mapFiles[] = { "outdoor_map.bin", "indoor_map.bin" };
+#define MAPS 2
+
+// robot and motor defaults (RobotClass::begin, MotorClass::begin)
+#define RPM_MAX             25
+#define WHEEL_DIAMETER      250    // mm
+#define WHEEL_BASE_CM       36
+#define REVERSE_SPEED_PERC  0.3
+#define ROTATION_SPEED_PERC 0.3
+
+static SUNRAY_INSTANCE int workerMap = -1; // map of worker (outline transferred to its Map)
+
+
+static void workerSetup(){
+  Map.begin();
+  Planner.begin();
+  Robot.state = STAT_IDLE;
+  Robot.reverseSpeedPerc = REVERSE_SPEED_PERC;
+  Robot.rotationSpeedPerc = ROTATION_SPEED_PERC;
+  Motor.rpmMax = RPM_MAX;
+  Motor.wheelDiameter = WHEEL_DIAMETER;
+  Motor.wheelBaseCm = WHEEL_BASE_CM;
+  workerMap = -1;
+}
+
+
+int main(int argc, char *argv[]){
+  int runs = (argc > 1) ? atoi(argv[1]) : 10;
+  int threads = (argc > 2) ? atoi(argv[2]) : 0;
+  std::vector<float> rpms;
+  const char *rpmList = (argc > 3) ? argv[3] : "15,20,25";
+  for (const char *p = rpmList; *p; p++) {
+    rpms.push_back(atof(p));
+    while ((*p) && (*p != ',')) p++;
+    if (*p == 0) break;
+  }
+  std::vector<std::vector<point_t> > outlines(MAPS);
+  for (int m = 0; m < MAPS; m++) {
+    std::string fileName = std::string(HOST_DATA_DIR) + mapFiles[m];
+    if (!loadOutline(fileName.c_str(), outlines[m])) return 1;
+  }
+  int patterns = PATTERN_LANES - PATTERN_RANDOM + 1;
+  int configs = MAPS * patterns * rpms.size();
+  int jobs = configs * runs;
+  std::vector<sim_result_t> results(jobs);
+  std::vector<char> valid(jobs, false); // written by workers (no vector<bool>)
+  std::vector<double> cpu(jobs, 0);
+  fprintf(stderr, "patternsim: maps=%d patterns=%d speeds=%d runs=%d threads=%d\n", MAPS, patterns, (int)rpms.size(),
+    runs, min(hostThreads(threads), jobs));
+  double startTime = hostTimeUs();
+  hostParallel(jobs, threads, workerSetup, [&](int job){
+    int config = job / runs;
+    int m = config / (patterns * rpms.size());
+    int p = PATTERN_RANDOM + (config / rpms.size()) % patterns;
+    float rpm = rpms[config % rpms.size()];
+    double t0 = hostTimeUs();
+    if (workerMap != m) {
+      setOutline(outlines[m], OUTLINE_SIZE);
+      Map.transferOutlineToMap();
+      Map.mapValid = true;
+      workerMap = m;
+    }
+    randomSeed(job + 1);
+    Planner.setSimSpeed(rpm);
+    valid[job] = Planner.simulateRun(p, results[job]);
+    cpu[job] = (hostTimeUs() - t0) / 1e6;
+  });
+  double wallTime = (hostTimeUs() - startTime) / 1e6;
+  printf("map,pattern,rpm,speed,runs,reached90,time90_min,reached99,time99_min,time_min,distance_m,coverage,rate_m2h,cpu_s\n");
+  double simTime = 0;
+  double cpuTime = 0;
+  for (int config = 0; config < configs; config++) {
+    int m = config / (patterns * rpms.size());
+    int p = PATTERN_RANDOM + (config / rpms.size()) % patterns;
+    float rpm = rpms[config % rpms.size()];
+    int n = 0, reached90 = 0, reached99 = 0;
+    double time90 = 0, time99 = 0, time = 0, distance = 0, coverage = 0, area = 0, cpuSum = 0;
+    for (int job = config * runs; job < (config + 1) * runs; job++) {
+      cpuSum += cpu[job];
+      if (!valid[job]) continue;
+      sim_result_t &r = results[job];
+      n++;
+      if (r.time90 >= 0) {
+        reached90++;
+        time90 += r.time90;
+      }
+      if (r.time99 >= 0) {
+        reached99++;
+        time99 += r.time99;
+      }
+      time += r.time;
+      distance += r.distance;
+      coverage += r.coverage;
+      area += r.area;
+    }
+    simTime += time;
+    cpuTime += cpuSum;
+    if (n == 0) continue;
+    printf("%s,%s,%.0f,%.3f,%d,%d,%.1f,%d,%.1f,%.1f,%.0f,%.2f,%.1f,%.2f\n", mapFiles[m],
+      (p == PATTERN_RANDOM) ? "random" : "lanes", rpm, rpm * PI * WHEEL_DIAMETER / 1000.0 / 60.0, n,
+      reached90, (reached90 > 0) ? time90 / reached90 / 60.0 : -1, reached99, (reached99 > 0) ? time99 / reached99 / 60.0 : -1,
+      time / n / 60.0, distance / n, coverage / n, (time > 0) ? area / time * 3600.0 : 0, cpuSum);
+  }
+  fprintf(stderr, "patternsim: simulated=%.1fh cpu=%.1fs wall=%.1fs\n", simTime / 3600.0, cpuTime, wallTime);
+  return 0;
+}
@@ -0,0 +1,42 @@
+// log replay on host localization (see replay.h): replays the Processing logs on the unchanged map code, writes the
+// pose trajectory of each log to <outdir>/<log>.csv and prints steps, CPU time per step, particles extent and
+// closure error - regression and performance baseline of the particle filter
+//
+//   ./build/replay [outdir] [log...]      e.g. ./build/replay build outdoor_track.log
+
+#include "replay.h"
+
+
+int main(int argc, char *argv[]){
+  std::string outDir = (argc > 1) ? argv[1] : "build";
+  hostSerialQuiet = true;
+  Map.begin();
+  hostSerialQuiet = false;
+  Robot.state = STAT_IDLE;
+  for (int k = 0; k < REPLAY_LOGS; k++) {
+    bool selected = (argc <= 2);
+    for (int a = 2; a < argc; a++) if (strcmp(argv[a], replayFile(k, 0)) == 0) selected = true;
+    if (!selected) continue;
+    std::vector<replay_step_t> steps;
+    std::vector<point_t> outline;
+    if (!loadLog((std::string(HOST_DATA_DIR) + replayFile(k, 0)).c_str(), steps)) return 1;
+    if (!loadOutline((std::string(HOST_DATA_DIR) + replayFile(k, 1)).c_str(), outline)) return 1;
+    std::string csvFile = outDir + "/" + replayFile(k, 0) + ".csv";
+    FILE *csv = fopen(csvFile.c_str(), "w");
+    if (csv == NULL) {
+      fprintf(stderr, "cannot write %s\n", csvFile.c_str());
+      return 1;
+    }
+    randomSeed(1);
+    fastRandomSeed(1);
+    replay_result_t r;
+    replayLog(steps, outline, r, csv);
+    fclose(csv);
+    printf("%s (%s): steps=%d distance=%.1f cpu(us) avg=%.1f max=%.1f particles dist x=%.2f y=%.2f avg=%.2f",
+      replayFile(k, 0), replayFile(k, 1), r.steps, r.distance, (r.steps > 0) ? r.cpuSum / r.steps : 0, r.cpuMax,
+      r.spreadX, r.spreadY, (r.steps > 0) ? r.spreadSum / r.steps : 0);
+    if (r.loops > 0) printf(" loops=%d closure error avg=%.2f max=%.2f", r.loops, r.closureSum / r.loops, r.closureMax);
+    printf(" => %s\n", csvFile.c_str());
+  }
+  return 0;
+}
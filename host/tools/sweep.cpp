@@ -0,0 +1,120 @@
+// particle filter parameter sweep on host (see replay.h, Processing replaySweep): replays the sweep logs on the
+// unchanged map code for each combination of steering, distance and measurement noise and max. particles
+// (MapClass::setFilterSettings), runs are spread over all cores (work stealing) - writes the configurations ranked
+// by error (closure error avg of tracking loops, else particles extent avg) and CPU time per step as CSV to stdout
+//
+//   ./build/sweep [threads] > sweep.csv
+
+#include "replay.h"
+#include "threadpool.h"
+
+// sweep grid (Processing sweep grid, max. particles are limited to the particle pool MAP_PARTICLES)
+static const float steeringNoise[] = { 0.002, 0.005, 0.01, 0.02 };
+static const float distanceNoise[] = { 0.005, 0.01, 0.03 };
+static const float measurementNoise[] = { 0.1, 0.2, 0.4 };
+static const int particles[] = { 100, 250, 500 };
+#define STEERINGS     4
+#define DISTANCES     3
+#define MEASUREMENTS  3
+#define PARTICLES     3
+#define CONFIGS       (STEERINGS * DISTANCES * MEASUREMENTS * PARTICLES)
+
+// logs recorded on the map file site (replayFile index)
+static const int sweepLogs[] = { 1, 2 };
+#define SWEEP_LOGS 2
+
+struct sweep_config_t {
+  int steps;
+  int loops;
+  float closureSum;
+  float closureMax;
+  double spreadSum;
+  double cpuSum;
+  double cpuMax;
+};
+
+static void sweepConfig(int config, int &s, int &d, int &m, int &p){
+  p = config % PARTICLES;
+  config /= PARTICLES;
+  m = config % MEASUREMENTS;
+  config /= MEASUREMENTS;
+  d = config % DISTANCES;
+  s = config / DISTANCES;
+}
+
+// configuration error: closure error avg (tracking loops) or particles extent avg (no loops)
+static float sweepError(const sweep_config_t &c){
+  if (c.loops > 0) return c.closureSum / c.loops;
+  if (c.steps > 0) return c.spreadSum / c.steps;
+  return 9999;
+}
+
+static void workerSetup(){
+  Map.begin();
+  Robot.state = STAT_IDLE;
+}
+
+
+int main(int argc, char *argv[]){
+  int threads = (argc > 1) ? atoi(argv[1]) : 0;
+  std::vector<std::vector<replay_step_t> > steps(SWEEP_LOGS);
+  std::vector<std::vector<point_t> > outlines(SWEEP_LOGS);
+  for (int l = 0; l < SWEEP_LOGS; l++) {
+    if (!loadLog((std::string(HOST_DATA_DIR) + replayFile(sweepLogs[l], 0)).c_str(), steps[l])) return 1;
+    if (!loadOutline((std::string(HOST_DATA_DIR) + replayFile(sweepLogs[l], 1)).c_str(), outlines[l])) return 1;
+  }
+  int jobs = CONFIGS * SWEEP_LOGS;
+  std::vector<replay_result_t> results(jobs);
+  std::vector<int> maxParticles(CONFIGS, 0);
+  fprintf(stderr, "sweep: configs=%d logs=%d threads=%d\n", CONFIGS, SWEEP_LOGS, min(hostThreads(threads), jobs));
+  double startTime = hostTimeUs();
+  hostParallel(jobs, threads, workerSetup, [&](int job){
+    int config = job / SWEEP_LOGS;
+    int l = job % SWEEP_LOGS;
+    int s, d, m, p;
+    sweepConfig(config, s, d, m, p);
+    randomSeed(job + 1);
+    fastRandomSeed(job + 1);
+    Map.setFilterSettings(steeringNoise[s], distanceNoise[d], measurementNoise[m], particles[p]);
+    if (l == 0) maxParticles[config] = Map.filter.maxSize;
+    replayLog(steps[l], outlines[l], results[job], NULL);
+  });
+  double wallTime = (hostTimeUs() - startTime) / 1e6;
+  std::vector<sweep_config_t> configs(CONFIGS);
+  double cpuTime = 0;
+  for (int job = 0; job < jobs; job++) {
+    sweep_config_t &c = configs[job / SWEEP_LOGS];
+    replay_result_t &r = results[job];
+    c.steps += r.steps;
+    c.loops += r.loops;
+    c.closureSum += r.closureSum;
+    c.closureMax = max(c.closureMax, r.closureMax);
+    c.spreadSum += r.spreadSum;
+    c.cpuSum += r.cpuSum;
+    c.cpuMax = max(c.cpuMax, r.cpuMax);
+    cpuTime += r.cpuSum;
+  }
+  // ranked by error, then CPU time
+  std::vector<int> order(CONFIGS);
+  for (int k = 0; k < CONFIGS; k++) order[k] = k;
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b){
+    float ea = sweepError(configs[a]);
+    float eb = sweepError(configs[b]);
+    if (ea != eb) return ea < eb;
+    return configs[a].cpuSum / max(1, configs[a].steps) < configs[b].cpuSum / max(1, configs[b].steps);
+  });
+  printf("rank,steering_noise,distance_noise,measurement_noise,max_particles,error,closure_error_avg,closure_error_max,loops,"
+    "particles_dist_avg,cpu_us_avg,cpu_us_max,steps\n");
+  for (int i = 0; i < CONFIGS; i++) {
+    int k = order[i];
+    sweep_config_t &c = configs[k];
+    int s, d, m, p;
+    sweepConfig(k, s, d, m, p);
+    int steps = max(1, c.steps);
+    printf("%d,%.4f,%.4f,%.4f,%d,%.3f,%.3f,%.3f,%d,%.3f,%.1f,%.1f,%d\n", i + 1, steeringNoise[s], distanceNoise[d],
+      measurementNoise[m], maxParticles[k], sweepError(c), c.closureSum / max(1, c.loops), c.closureMax, c.loops,
+      c.spreadSum / steps, c.cpuSum / steps, c.cpuMax, c.steps);
+  }
+  fprintf(stderr, "sweep: cpu=%.1fs wall=%.1fs\n", cpuTime / 1e6, wallTime);
+  return 0;
+}
@@ -34,6 +34,15 @@ String tcpHost = "raspberrypi.local";
 String logFile = ""; //"outdoor_mow_rand.log";  // if file exists, playback mode, otherwise record mode
 int logPlaySpeed = 1; // 1..100
 int logPlayIntervalMillis = 10; // 1..10
+boolean replayOnRobot = false; // log playback: replay motion/perimeter data on robot localization (robot must be idle, map outline 
+                               // is uploaded from map file), writes pose trajectory and CPU time per step to data/<logFile>.csv
+boolean replaySweep = false;   // log playback on robot: replay all sweep logs for each particle filter configuration of the sweep grid
+                               // (all combinations, requires replayOnRobot), writes ranked summary to data/sweep.csv
+String[] sweepLogs = {"outdoor_track.log", "outdoor_mow_rand.log"}; // logs recorded on the map file site
+float[] sweepSteeringNoise = {0.002, 0.005, 0.01, 0.02};
+float[] sweepDistanceNoise = {0.005, 0.01, 0.03};
+float[] sweepMeasurementNoise = {0.1, 0.2, 0.4};
+int[] sweepParticles = {100, 250, 500};
 int tcpPort = 8083;
 boolean useSatMap = false;
 double centerLat = 52.267312;    
@@ -59,6 +59,9 @@ static final byte imuEnable = 1;
 static final byte useGyro = 1;
 static final float gyroBiasDpsMax = 0.01;
 static final float imuMode = 0;
+// mowing
+static final float cuttingWidth = 0.3; // meter
+static final float coverageTarget = 95; // stop mowing at this coverage (percent)
 
 
 boolean verboseOutput = false;
@@ -164,6 +167,9 @@ float speedR = 0;
 float joyLeft = 0; 
 float joyRight = 0;
 float batteryVoltage = 0;
+float coverage = 0; // percent
+float mowedArea = 0; // m2
+float mowingRate = 0; // m2/h
 boolean joyActive = false;
 int state = 0;
 int imuState = IMU_RUN;
@@ -185,6 +191,36 @@ float periRight = 0;
 float distanceCmSet = 0;
 float angleRadSet = 0;
 boolean playPaused = true;
+PrintWriter replayOutput;
+volatile boolean replayWaiting = false;
+int replayWaitTime = 0;
+int replaySteps = 0;
+int replayLost = 0;
+float replayDistance = 0;  // travelled distance (meter)
+float replayCpuSum = 0;
+int replayCpuMax = 0;
+float replayOutlineLength = 0;
+float replayLoopStart = -1; // travelled distance at start of perimeter loop (tracking)
+PVector replayLoopPose = new PVector();
+float replayClosureErrorSum = 0;
+float replayClosureErrorMax = 0;
+int replayLoops = 0;
+PVector replayPose = new PVector();
+float replaySpreadX = 0;
+float replaySpreadY = 0;
+float replaySpreadSum = 0; // particles extent sum of all steps
+ArrayList<String> rawCaptures = new ArrayList<String>(); // raw perimeter captures received (!93): coil,age,time,magnitude,quality,samples
+String rawCaptureHeader = null;
+String rawCaptureSamples = "";
+int sweepRun = -1; // parameter sweep: current run (configuration * logs + log)
+float[] sweepErrorSum;
+float[] sweepErrorMax;
+int[] sweepLoops;
+float[] sweepSpreadSum;
+float[] sweepCpuSum;
+int[] sweepCpuMax;
+int[] sweepSteps;
+int[] sweepLost;
 Button btnMapping,btnStop,btnResetParticles,btnTrackClockwise,btnTrackAnticlockwise,btnMowRand,btnMowLane,btnADCcal,btnMPUselftest;
 Button btnIMUstartCal,btnIMUstopCal,btnMow50,btnMowON,btnMowOFF,btnLine,btnLineRev,btnLine90,btnRotate90;
 Button btnPlayPaused = null;
@@ -225,6 +261,12 @@ String float2String(float number){
   return s;
 }
 
+String float2String(float number, int decimals){
+  String s = String.format("%." + decimals + "f", number);
+  s = s.replaceAll(",", ".");
+  return s;
+}
+
 void sendPWM(float leftPWM, float rightPWM){
   if (demo){
     speedL = leftPWM;
@@ -273,7 +315,7 @@ void sendVerbose(){
 
 
 void sendPort(String s){
-  if (logState == LOG_PLAY) return;
+  if ((logState == LOG_PLAY) && (!replayOnRobot)) return;
   if (demo) return;
   if (useTcp) myTcp.write(s);
     else mySerial.write(s);
@@ -300,6 +342,7 @@ void setup(PApplet parent){
   sheetMenuMain = new Sheet(tabMenu, "1");
   sheetMenuMisc = new Sheet(tabMenu, "2");
   tabMenu.activeSheet = sheetMenuMain;  
+  if ((replaySweep) && (replayOnRobot)) startSweep();
   logging(null);
   createPlots();
   createMenu();
@@ -312,7 +355,7 @@ void setup(PApplet parent){
   stroke(0, 0, 0);  
   //frameRate(200);
   
-  if ((!demo) && (logState != LOG_PLAY))  {    
+  if ((!demo) && ((logState != LOG_PLAY) || (replayOnRobot)))  {    
     if (useTcp) myTcp =  new Client(parent, tcpHost, tcpPort);  
       else mySerial = new Serial(parent, comPort, 115200, 'N', 8, 1);          
     // A serialEvent() is generated when a newline character is received :    
@@ -322,6 +365,9 @@ void setup(PApplet parent){
       mySerial.clear();      
       delay(1000);
     }
+    if (logState == LOG_PLAY) startReplay();
+  }
+  if ((!demo) && (logState != LOG_PLAY))  {    
     //loadEEPROM();
     // motor settings
     sendPort("?83," + float2String(rpmMax) + "," + float2String(reverseSpeedPerc) + "," + float2String(rotationSpeedPerc) + "," 
@@ -339,6 +385,9 @@ void setup(PApplet parent){
     delay(200);
     // IMU settings
     sendPort("?82," + str(imuEnable) + "," + str(useGyro) +  "," + float2String(gyroBiasDpsMax) + "," + str(imuMode) + "\n");
+    delay(200);
+    // mowing settings
+    sendPort("?23," + float2String(cuttingWidth) + "," + float2String(coverageTarget) + "\n");
     sendVerbose();
     
     //if (mySerial != null) mySerial.buffer(32);    
@@ -380,6 +429,7 @@ void drawInfo(int px, int py){
   text("dist:  "+float2String(map.overallDist),          x,y+13*w);
   text("voltage:  "+float2String(batteryVoltage),          x,y+14*w);
   text("localize outline: "+ map.stateLocalizeOutline,          x,y+15*w);
+  text("coverage: "+float2String(coverage)+"% ("+float2String(mowedArea)+" m2, "+float2String(mowingRate)+" m2/h)", x,y+16*w);
 }
 
 
@@ -734,7 +784,15 @@ void processDataReceived(String data) {
     if (data.startsWith("!17")){
       // robot motion
       String[] list = splitTokens(data, ",");
-      if (list.length >= 3){
+      if ((list.length >= 3) && (logState == LOG_PLAY) && (replayOnRobot)){
+        float distance = Float.parseFloat(list[1]);
+        float yaw = Float.parseFloat(list[2]);
+        replayDistance += abs(distance);
+        replayWaiting = true;
+        replayWaitTime = millis();
+        sendPort("?19," + float2String(distance, 4) + "," + float2String(yaw, 4) + "," + float2String(periLeft) + "," 
+          + float2String(periRight) + "," + str(state) + "\n");
+      } else if (list.length >= 3){
         float distance = Float.parseFloat(list[1]);
         float yaw = Float.parseFloat(list[2]);
         map.run(yaw, distance, periLeft, periRight);
@@ -818,6 +876,15 @@ void processDataReceived(String data) {
         //saveMagData(line);
       }
     }
+    if (data.startsWith("!22")){
+      // coverage
+      String[] list = splitTokens(data, ",");
+      if (list.length >= 8){
+        coverage = Float.parseFloat(list[3]);
+        mowedArea = Float.parseFloat(list[4]);
+        mowingRate = Float.parseFloat(list[6]);
+      }
+    }
     if (data.startsWith("!88")){
       // battery data
       String[] list = splitTokens(data, ",");
@@ -916,6 +983,44 @@ void processDataReceived(String data) {
       // particles
       particles = data;       
     }
+    if (data.startsWith("!19")){
+      // replay step result
+      String[] list = splitTokens(data, ",");
+      if ((list.length >= 10) && (replayOutput != null)){
+        replayPose.x = Float.parseFloat(list[2]);
+        replayPose.y = Float.parseFloat(list[3]);
+        replaySpreadX = Float.parseFloat(list[5]);
+        replaySpreadY = Float.parseFloat(list[6]);
+        int cpu = Integer.parseInt(list[8]);
+        replaySteps++;
+        replayCpuSum += cpu;
+        replayCpuMax = max(replayCpuMax, cpu);
+        replaySpreadSum += sqrt(sq(replaySpreadX) + sq(replaySpreadY));
+        replayOutput.println(list[1] + "," + time + "," + state + "," + float2String(replayDistance, 3) + "," + list[2] + "," + list[3] 
+          + "," + list[4] + "," + list[5] + "," + list[6] + "," + list[7] + "," + list[8] + "," + list[9]);
+        replayClosure();
+      }
+      replayWaiting = false;
+    }
+    if (data.startsWith("!93")){
+      // raw perimeter capture frame (samples as hex digits)
+      String[] list = splitTokens(data, ",");
+      if ((list.length >= 2) && (Integer.parseInt(list[1]) < 0)) saveRawCaptures();
+      else if (list.length >= 10){
+        String header = list[1] + "," + list[2] + "," + list[3] + "," + list[4] + "," + list[5];
+        int offset = Integer.parseInt(list[6]);
+        int size = Integer.parseInt(list[7]);
+        int len = Integer.parseInt(list[8]);
+        if (offset == 0){
+          rawCaptureHeader = header;
+          rawCaptureSamples = "";
+        }
+        for (int i=0; i < len; i++){
+          rawCaptureSamples += "," + str((byte)unhex(list[9].substring(i*2, i*2+2)));
+        }
+        if ((header.equals(rawCaptureHeader)) && (offset + len >= size)) rawCaptures.add(rawCaptureHeader + rawCaptureSamples);
+      }
+    }
     if (data.startsWith("!99")){
       // marker
       println("add marker");
@@ -1010,6 +1115,200 @@ void mouseReleased(){
   
 
   
+  // log playback on robot localization: upload map outline (the robot replaces its map until replay end)
+  void startReplay(){
+    replaySteps = 0;
+    replayLost = 0;
+    replayDistance = 0;
+    replayCpuSum = 0;
+    replayCpuMax = 0;
+    replayOutlineLength = 0;
+    replayLoopStart = -1;
+    replayClosureErrorSum = 0;
+    replayClosureErrorMax = 0;
+    replayLoops = 0;
+    replaySpreadSum = 0;
+    String csvFile = logFile;
+    if (sweepRun >= 0) {
+      int[] c = sweepConfig(sweepRun / sweepLogs.length);
+      sendPort("?27," + float2String(sweepSteeringNoise[c[0]], 4) + "," + float2String(sweepDistanceNoise[c[1]], 4) + "," 
+        + float2String(sweepMeasurementNoise[c[2]], 4) + "," + str(sweepParticles[c[3]]) + "\n");
+      delay(200);
+      csvFile += "_" + str(sweepRun / sweepLogs.length);
+    }
+    println("replay: uploading outline (" + map.outlineList.size() + " points)");
+    sendPort("?21,0\n");
+    delay(200);
+    int n = map.outlineList.size();
+    if (n == 0) return;
+    int step = max(1, ceil(n / 148.0));  // robot outline size
+    for (int i=0; i < n; i+=step){
+      PVector pt = map.outlineList.get(i);
+      sendPort("?20," + float2String(pt.x) + "," + float2String(pt.y) + "\n");
+      delay(20);
+    }
+    PVector pt = map.outlineList.get(0);
+    sendPort("?20," + float2String(pt.x) + "," + float2String(pt.y) + "\n");
+    for (int i=1; i < n; i++) replayOutlineLength += PVector.dist(map.outlineList.get(i), map.outlineList.get(i-1));
+    delay(200);
+    sendPort("?21,1\n");
+    delay(1000);
+    File afile = new File(sketchPath() + "\\data\\" + csvFile + ".csv");
+    println("replay: writing poses to "+afile.getAbsolutePath());
+    replayOutput = createWriter(afile);
+    replayOutput.println("step,time,state,distance,x,y,heading_offset,particles_dist_x,particles_dist_y,overall_prob,cpu_us,particles");
+  }
+  
+  // received raw perimeter captures (?93) to csv file
+  void saveRawCaptures(){
+    File afile = new File(sketchPath() + "\\data\\raw_captures.csv");
+    println("raw captures: writing " + rawCaptures.size() + " captures to "+afile.getAbsolutePath());
+    PrintWriter out = createWriter(afile);
+    out.println("coil,age,time,magnitude,quality,samples");
+    for (String line : rawCaptures) out.println(line);
+    out.flush();
+    out.close();
+    rawCaptures.clear();
+  }
+  
+  // outline closure error: pose difference after tracking one perimeter length (outline length of map)
+  void replayClosure(){
+    if (state != STAT_TRACK){
+      replayLoopStart = -1;
+      return;
+    }
+    if (replayLoopStart < 0){
+      replayLoopStart = replayDistance;
+      replayLoopPose = replayPose.copy();
+      return;
+    }
+    if ((replayOutlineLength > 0) && (replayDistance - replayLoopStart >= replayOutlineLength)){
+      float err = PVector.dist(replayPose, replayLoopPose);
+      replayClosureErrorSum += err;
+      replayClosureErrorMax = max(replayClosureErrorMax, err);
+      replayLoops++;
+      replayLoopStart = replayDistance;
+      replayLoopPose = replayPose.copy();
+    }
+  }
+
+  void stopReplay(){
+    if (replayOutput == null) return;
+    replayOutput.flush();
+    replayOutput.close();
+    replayOutput = null;
+    sendPort("?21,2\n");
+    println("replay: steps=" + replaySteps + " lost=" + replayLost + " distance=" + float2String(replayDistance));
+    if (replaySteps > 0) println("replay: cpu(us) avg=" + float2String(replayCpuSum/replaySteps) + " max=" + replayCpuMax);
+    println("replay: particles dist x=" + float2String(replaySpreadX) + " y=" + float2String(replaySpreadY));
+    if (replayLoops > 0) println("replay: loops=" + replayLoops + " closure error avg=" + float2String(replayClosureErrorSum/replayLoops)
+      + " max=" + float2String(replayClosureErrorMax));
+    if (sweepRun >= 0) nextSweepRun();
+  }
+  
+  // parameter sweep: sweep grid index of each parameter for configuration (steering, distance, measurement noise, particles)
+  int[] sweepConfig(int config){
+    int[] c = new int[4];
+    c[3] = config % sweepParticles.length;
+    config /= sweepParticles.length;
+    c[2] = config % sweepMeasurementNoise.length;
+    config /= sweepMeasurementNoise.length;
+    c[1] = config % sweepDistanceNoise.length;
+    c[0] = config / sweepDistanceNoise.length;
+    return c;
+  }
+  
+  int sweepConfigs(){
+    return sweepSteeringNoise.length * sweepDistanceNoise.length * sweepMeasurementNoise.length * sweepParticles.length;
+  }
+  
+  void startSweep(){
+    int n = sweepConfigs();
+    println("sweep: " + n + " configurations, " + sweepLogs.length + " logs");
+    sweepErrorSum = new float[n];
+    sweepErrorMax = new float[n];
+    sweepLoops = new int[n];
+    sweepSpreadSum = new float[n];
+    sweepCpuSum = new float[n];
+    sweepCpuMax = new int[n];
+    sweepSteps = new int[n];
+    sweepLost = new int[n];
+    sweepRun = -1;
+    if (!nextSweepLog()) sweepRun = -1;
+  }
+  
+  // next run with existing log file (sets logFile), false if sweep completed
+  boolean nextSweepLog(){
+    while (true){
+      sweepRun++;
+      if (sweepRun >= sweepConfigs() * sweepLogs.length) return false;
+      logFile = sweepLogs[sweepRun % sweepLogs.length];
+      if (new File(sketchPath() + "\\data\\" + logFile).exists()) return true;
+      println("sweep: missing log " + logFile);
+    }
+  }
+  
+  // end of sweep run: add replay results to configuration and start next run
+  void nextSweepRun(){
+    int config = sweepRun / sweepLogs.length;
+    sweepErrorSum[config] += replayClosureErrorSum;
+    sweepErrorMax[config] = max(sweepErrorMax[config], replayClosureErrorMax);
+    sweepLoops[config] += replayLoops;
+    sweepSpreadSum[config] += replaySpreadSum;
+    sweepCpuSum[config] += replayCpuSum;
+    sweepCpuMax[config] = max(sweepCpuMax[config], replayCpuMax);
+    sweepSteps[config] += replaySteps;
+    sweepLost[config] += replayLost;
+    if (!nextSweepLog()){
+      saveSweep();
+      sweepRun = -1;
+      sendPort("?27,0,0,0,0\n"); // restore default settings
+      return;
+    }
+    println("sweep: run " + (sweepRun+1) + "/" + (sweepConfigs() * sweepLogs.length) + " log " + logFile);
+    logState = LOG_OFF;
+    logging(null);
+    startReplay();
+  }
+  
+  // configuration error: closure error avg (tracking loops) or particles extent avg (no loops)
+  float sweepError(int config){
+    if (sweepLoops[config] > 0) return sweepErrorSum[config] / sweepLoops[config];
+    if (sweepSteps[config] > 0) return sweepSpreadSum[config] / sweepSteps[config];
+    return 9999;
+  }
+  
+  // write configurations ranked by error (then CPU time) to data/sweep.csv
+  void saveSweep(){
+    int n = sweepConfigs();
+    Integer[] order = new Integer[n];
+    for (int i=0; i < n; i++) order[i] = i;
+    java.util.Arrays.sort(order, new java.util.Comparator<Integer>() {
+      public int compare(Integer a, Integer b){
+        int cmp = Float.compare(sweepError(a), sweepError(b));
+        if (cmp != 0) return cmp;
+        return Float.compare(sweepCpuSum[a] / max(1, sweepSteps[a]), sweepCpuSum[b] / max(1, sweepSteps[b]));
+      }
+    });
+    File afile = new File(sketchPath() + "\\data\\sweep.csv");
+    println("sweep: writing results to "+afile.getAbsolutePath());
+    PrintWriter out = createWriter(afile);
+    out.println("rank,steering_noise,distance_noise,measurement_noise,max_particles,error,closure_error_avg,closure_error_max,loops,"
+      + "particles_dist_avg,cpu_us_avg,cpu_us_max,steps,lost");
+    for (int i=0; i < n; i++){
+      int k = order[i];
+      int[] c = sweepConfig(k);
+      int steps = max(1, sweepSteps[k]);
+      out.println((i+1) + "," + float2String(sweepSteeringNoise[c[0]], 4) + "," + float2String(sweepDistanceNoise[c[1]], 4) + "," 
+        + float2String(sweepMeasurementNoise[c[2]], 4) + "," + sweepParticles[c[3]] + "," + float2String(sweepError(k), 3) + "," 
+        + float2String(sweepErrorSum[k] / max(1, sweepLoops[k]), 3) + "," + float2String(sweepErrorMax[k], 3) + "," + sweepLoops[k] + ","
+        + float2String(sweepSpreadSum[k] / steps, 3) + "," + float2String(sweepCpuSum[k] / steps) + "," + sweepCpuMax[k] + "," 
+        + sweepSteps[k] + "," + sweepLost[k]);
+    }
+    out.flush();
+    out.close();
+  }
+  
   public void logging(String data) {    
     if (logState == LOG_OFF){    
       if ((logFile != "") && (logFile != null)){
@@ -1028,6 +1327,12 @@ void mouseReleased(){
     }    
     if (logState == LOG_PLAY){
        if (logInput == null) return;       
+       if (replayWaiting){
+         // wait for replay step result
+         if (millis() < replayWaitTime + 2000) return;
+         replayLost++;
+         replayWaiting = false;
+       }
        String line = "";
        try {
          line = logInput.readLine();
@@ -1045,6 +1350,7 @@ void mouseReleased(){
            e.printStackTrace();
          }
          logInput = null;
+         if (replayOnRobot) stopReplay();
        }
     }     
     if (logState == LOG_REC){
@@ -40,7 +40,7 @@ Private-use only! (you need to ask for a commercial-use)
 #define NO_CHANNEL 255
 
 int16_t dmaData[ADC_SAMPLE_COUNT_MAX];
-ADCManager ADCMan;
+SUNRAY_INSTANCE ADCManager ADCMan;
 
 
 ADCManager::ADCManager(){
@@ -169,6 +169,14 @@ int8_t* ADCManager::getSamples(byte pin){
   return channels[ch].samples;
 }
 
+// zero-copy capture: caller keeps the completed samples, next capture goes to the given buffer (same size)
+int8_t* ADCManager::swapSamples(byte pin, int8_t *samples){
+  byte ch = pin-A0;
+  int8_t *prev = channels[ch].samples;
+  channels[ch].samples = samples;
+  return prev;
+}
+
 int ADCManager::getSampleCount(byte pin){
   byte ch = pin-A0;
   return channels[ch].sampleCount;
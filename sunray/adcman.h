@@ -42,6 +42,7 @@ How to use it:
 
 
 #include <Arduino.h>
+#include "instance.h"
 
 #define ADC_BITS  12    // 12 bit ADC  
 #define ADC_REF  3.3   // 3.3 Volt reference
@@ -56,7 +57,7 @@ enum {
 #define ADC_CHANNEL_COUNT_MAX 12
 
 // one channel data
-typedef struct ADCStruct {  
+struct ADCStruct {  
   int sampleCount;
   byte pin;  
   int8_t *samples;
@@ -79,6 +80,8 @@ class ADCManager
     virtual void run();
     virtual void setupChannel(byte pin, int samplecount, bool autocalibrate);    
     virtual int8_t* getSamples(byte pin);
+    // replace sample buffer of completed capture (before restartConv) - returns previous buffer
+    virtual int8_t* swapSamples(byte pin, int8_t *samples);
     virtual int getSampleCount(byte pin);
     virtual int16_t getValue(byte pin);    
     virtual float getVoltage(byte pin);
@@ -100,7 +103,7 @@ class ADCManager
     void saveCalib();        
 };
 
-extern ADCManager ADCMan;
+extern SUNRAY_INSTANCE ADCManager ADCMan;
 
 
 #endif
@@ -27,7 +27,7 @@ Private-use only! (you need to ask for a commercial-use)
 #include "adcman.h"
 #include <Arduino.h>
 
-BatteryClass Battery;
+SUNRAY_INSTANCE BatteryClass Battery;
 
 void BatteryClass::begin()
 {
@@ -2,6 +2,7 @@
 
 #ifndef BATTERY_H
 #define BATTERY_H
+#include "instance.h"
 
 
 
@@ -38,7 +39,7 @@ class BatteryClass {
 		void print();
 };
 
-extern BatteryClass Battery;
+extern SUNRAY_INSTANCE BatteryClass Battery;
 
 #endif
 
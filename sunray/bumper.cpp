@@ -28,7 +28,7 @@ Private-use only! (you need to ask for a commercial-use)
 #include "robot.h"
 #include <Arduino.h>
 
-BumperClass Bumper;
+SUNRAY_INSTANCE BumperClass Bumper;
 
 
 ISR(BumperLeftInterruptRoutine) {	  
@@ -2,6 +2,7 @@
 
 #ifndef BUMPER_H
 #define BUMPER_H
+#include "instance.h"
 
 
 
@@ -20,7 +21,7 @@ class BumperClass {
       unsigned long nextCheckTime;
 };
 
-extern BumperClass Bumper;
+extern SUNRAY_INSTANCE BumperClass Bumper;
 
 #endif
 
@@ -38,6 +38,7 @@
 #define pinSonarLeftEcho 36
 #define pinPerimeterRight A4       // perimeter
 #define pinPerimeterLeft A5
+#define pinPerimeterCenter A6      // perimeter center coil (PERIMETER_COILS 3)
 
 #define pinLED 13                  // LED
 #define pinBuzzer 53               // Buzzer
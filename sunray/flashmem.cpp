@@ -46,7 +46,7 @@ Private-use only! (you need to ask for a commercial-use)
 #endif  
 
 
-FlashClass Flash;
+SUNRAY_INSTANCE FlashClass Flash;
 
 
 int eereadwriteString(boolean readflag, int &ee, String& value)
@@ -2,6 +2,7 @@
 #define FLASHMEM_H
 
 #include <Arduino.h>
+#include "instance.h"
 
 
 class FlashClass
@@ -17,7 +18,7 @@ class FlashClass
 };
 
 
-extern FlashClass Flash;
+extern SUNRAY_INSTANCE FlashClass Flash;
 
 
 template <class T> int eewrite(int &ee, const T& value)
@@ -0,0 +1,365 @@
+// incremental grid path search (D* Lite) in a bounded node arena
+//
+// usage:
+//   GridSearch<512,256> search;
+//   search.begin(cellCost, 1, 4000);          // cell cost function, min. cost factor, max. expansions per search
+//   search.plan(startX, startY, goalX, goalY); // new search (cells)
+//   while (search.nextCell(x, y)) ...          // follow path from (x,y) to goal
+//   search.cellChanged(x, y);                 // cell cost changed (e.g. obstacle marked)...
+//   search.replan(x, y);                      // ...repair path from current cell
+//   search.weight = 3;                        // inflated heuristic: fewer expansions, path cost up to 3x optimal
+//
+// the search runs backwards from goal to start, so g(cell) is the path cost to the goal - when cell costs
+// change, only the affected nodes are updated and the path is repaired from the current cell (no new search),
+// nodes are allocated on demand from the arena (hashed by cell), the search fails if the arena is full or too
+// many nodes are expanded
+//
+// costs: cell cost factor 0 is blocked, edge costs are 10 (straight) or 14 (diagonal) times the mean cost
+// factor of both cells, diagonal moves must not cut blocked corners, heuristic is the octile distance (times
+// min. cost factor)
+
+#ifndef GRIDSEARCH_H
+#define GRIDSEARCH_H
+
+#include <inttypes.h>
+
+#define GRID_SEARCH_INFINITE  0xFFFF
+#define GRID_SEARCH_STRAIGHT  10
+#define GRID_SEARCH_DIAGONAL  14
+
+// cost factor of cell (0: blocked)
+typedef uint8_t (*grid_cost_t)(int x, int y);
+
+
+template <int NODES, int BUCKETS> class GridSearch {
+
+public:
+
+    int nodeCount;         // allocated nodes
+    long expansions;       // expanded nodes since last plan
+    bool overflow;         // last search failed: arena full or too many expansions
+    uint8_t weight;        // heuristic factor (1: optimal path, >1: weighted search, use plan() only, not replan())
+
+    GridSearch() {
+        costFunc = 0;
+        minCost = 1;
+        weight = 1;
+        maxExpansions = 0;
+        clear();
+    };
+
+    void begin(grid_cost_t func, uint8_t minCostFactor, long maxExp) {
+        costFunc = func;
+        minCost = minCostFactor;
+        weight = 1;
+        maxExpansions = maxExp;
+        clear();
+    };
+
+    void clear() {
+        nodeCount = 0;
+        heapCount = 0;
+        expansions = 0;
+        overflow = false;
+        km = 0;
+        startNode = -1;
+        for (int b = 0; b < BUCKETS; b++) head[b] = -1;
+    };
+
+    // new search from start cell to goal cell - returns false if there is no path
+    bool plan(int sx, int sy, int gx, int gy) {
+        clear();
+        startX = lastX = sx;
+        startY = lastY = sy;
+        int g = alloc(gx, gy);
+        if (g < 0) return false;
+        goalNode = g;
+        nodes[g].rhs = 0;
+        insert(g);
+        return computeShortestPath();
+    };
+
+    // repair path from (new) start cell after cell costs changed - returns false if there is no path
+    bool replan(int sx, int sy) {
+        if (nodeCount == 0) return false;
+        km += heuristic(lastX, lastY, sx, sy);
+        startX = lastX = sx;
+        startY = lastY = sy;
+        startNode = -1;
+        expansions = 0;
+        return computeShortestPath();
+    };
+
+    // cost of cell changed: update cell and its neighbours (edges)
+    void cellChanged(int x, int y) {
+        if (nodeCount == 0) return;
+        int idx = find(x, y);
+        if (idx >= 0) refresh(idx);
+          else if (costFunc(x, y) != 0) idx = alloc(x, y);
+        if (idx >= 0) updateVertex(idx);
+        for (int d = 0; d < 8; d++) {
+            int n = find(x + DX[d], y + DY[d]);
+            if (n < 0) continue;
+            refresh(n);
+            updateVertex(n);
+        }
+    };
+
+    // path cost from cell to goal (GRID_SEARCH_INFINITE if unknown)
+    uint16_t cost(int x, int y) {
+        int idx = find(x, y);
+        return (idx < 0) ? GRID_SEARCH_INFINITE : nodes[idx].g;
+    };
+
+    // next cell on path towards goal - returns false at goal (or if there is no path)
+    bool nextCell(int &x, int &y) {
+        int idx = find(x, y);
+        if ((idx < 0) || (idx == goalNode) || (nodes[idx].g == GRID_SEARCH_INFINITE)) return false;
+        uint32_t best = GRID_SEARCH_INFINITE;
+        int bestDir = -1;
+        for (int d = 0; d < 8; d++) {
+            int n = find(x + DX[d], y + DY[d]);
+            if ((n < 0) || (nodes[n].g == GRID_SEARCH_INFINITE)) continue;
+            uint32_t c = edgeCost(idx, n, d);
+            if (c == GRID_SEARCH_INFINITE) continue;
+            c += nodes[n].g;
+            if (c < best) {
+                best = c;
+                bestDir = d;
+            }
+        }
+        if (bestDir < 0) return false;
+        x += DX[bestDir];
+        y += DY[bestDir];
+        return true;
+    };
+
+protected:
+
+    struct node_t {
+        int16_t x;
+        int16_t y;
+        uint16_t g;
+        uint16_t rhs;
+        uint16_t key1;      // queue key (when inserted)
+        uint16_t key2;
+        int16_t next;       // next node in same bucket
+        int16_t heapPos;    // position in queue or -1
+        uint8_t cost;       // cell cost factor
+        uint8_t corners;    // diagonal directions blocked by corner cells (bit per direction)
+    };
+
+    static const int8_t DX[8];
+    static const int8_t DY[8];
+
+    grid_cost_t costFunc;
+    uint8_t minCost;
+    long maxExpansions;
+    int startX;
+    int startY;
+    int lastX;
+    int lastY;
+    int startNode;
+    int goalNode;
+    uint16_t km;           // key modifier (start movement)
+    int heapCount;
+    node_t nodes[NODES];
+    int16_t heap[NODES];
+    int16_t head[BUCKETS];
+
+    int bucket(int x, int y) {
+        uint32_t h = ((uint32_t)x) * 73856093u ^ ((uint32_t)y) * 19349663u;
+        return (h ^ (h >> 16)) & (BUCKETS - 1);
+    };
+
+    int find(int x, int y) {
+        for (int i = head[bucket(x, y)]; i >= 0; i = nodes[i].next) {
+            if ((nodes[i].x == x) && (nodes[i].y == y)) return i;
+        }
+        return -1;
+    };
+
+    // new node (g = rhs = infinite) - returns -1 if arena is full
+    int alloc(int x, int y) {
+        if (nodeCount == NODES) {
+            overflow = true;
+            return -1;
+        }
+        int i = nodeCount++;
+        node_t &n = nodes[i];
+        n.x = x;
+        n.y = y;
+        n.g = n.rhs = GRID_SEARCH_INFINITE;
+        n.heapPos = -1;
+        refresh(i);
+        int b = bucket(x, y);
+        n.next = head[b];
+        head[b] = i;
+        return i;
+    };
+
+    // read cost factor of node cell and its corner cells
+    void refresh(int i) {
+        node_t &n = nodes[i];
+        n.cost = costFunc(n.x, n.y);
+        n.corners = 0;
+        for (int d = 4; d < 8; d++) {
+            if ((costFunc(n.x + DX[d], n.y) == 0) || (costFunc(n.x, n.y + DY[d]) == 0)) n.corners |= (1 << d);
+        }
+    };
+
+    uint16_t heuristic(int x0, int y0, int x1, int y1) {
+        int dx = (x1 > x0) ? x1 - x0 : x0 - x1;
+        int dy = (y1 > y0) ? y1 - y0 : y0 - y1;
+        if (dx < dy) return minCost * weight * (GRID_SEARCH_STRAIGHT * dy + (GRID_SEARCH_DIAGONAL - GRID_SEARCH_STRAIGHT) * dx);
+        return minCost * weight * (GRID_SEARCH_STRAIGHT * dx + (GRID_SEARCH_DIAGONAL - GRID_SEARCH_STRAIGHT) * dy);
+    };
+
+    // cost of edge from node a to its neighbour b (direction d)
+    uint32_t edgeCost(int a, int b, int d) {
+        if ((nodes[a].cost == 0) || (nodes[b].cost == 0)) return GRID_SEARCH_INFINITE;
+        if (nodes[a].corners & (1 << d)) return GRID_SEARCH_INFINITE;
+        uint32_t base = (d < 4) ? GRID_SEARCH_STRAIGHT : GRID_SEARCH_DIAGONAL;
+        return (base * (nodes[a].cost + nodes[b].cost)) >> 1;
+    };
+
+    // key (k1, k2) packed for comparison
+    uint32_t calcKey(int i) {
+        uint32_t m = (nodes[i].g < nodes[i].rhs) ? nodes[i].g : nodes[i].rhs;
+        if (m == GRID_SEARCH_INFINITE) return 0xFFFFFFFF;
+        uint32_t k1 = m + heuristic(startX, startY, nodes[i].x, nodes[i].y) + km;
+        if (k1 > 0xFFFE) k1 = 0xFFFE;
+        return (k1 << 16) | m;
+    };
+
+    uint32_t heapKey(int i) {
+        return (((uint32_t)nodes[i].key1) << 16) | nodes[i].key2;
+    };
+
+    void heapSet(int pos, int i) {
+        heap[pos] = i;
+        nodes[i].heapPos = pos;
+    };
+
+    void siftUp(int pos) {
+        int i = heap[pos];
+        uint32_t k = heapKey(i);
+        while (pos > 0) {
+            int parent = (pos - 1) >> 1;
+            if (heapKey(heap[parent]) <= k) break;
+            heapSet(pos, heap[parent]);
+            pos = parent;
+        }
+        heapSet(pos, i);
+    };
+
+    void siftDown(int pos) {
+        int i = heap[pos];
+        uint32_t k = heapKey(i);
+        while (true) {
+            int child = 2 * pos + 1;
+            if (child >= heapCount) break;
+            if ((child + 1 < heapCount) && (heapKey(heap[child + 1]) < heapKey(heap[child]))) child++;
+            if (heapKey(heap[child]) >= k) break;
+            heapSet(pos, heap[child]);
+            pos = child;
+        }
+        heapSet(pos, i);
+    };
+
+    // insert node with current key (or update key if already queued)
+    void insert(int i) {
+        uint32_t k = calcKey(i);
+        nodes[i].key1 = k >> 16;
+        nodes[i].key2 = k & 0xFFFF;
+        if (nodes[i].heapPos < 0) {
+            heapSet(heapCount++, i);
+            siftUp(heapCount - 1);
+        } else {
+            siftUp(nodes[i].heapPos);
+            siftDown(nodes[i].heapPos);
+        }
+    };
+
+    void remove(int i) {
+        int pos = nodes[i].heapPos;
+        if (pos < 0) return;
+        nodes[i].heapPos = -1;
+        heapCount--;
+        if (pos == heapCount) return;
+        int moved = heap[heapCount];
+        heapSet(pos, moved);
+        siftUp(pos);
+        siftDown(nodes[moved].heapPos);
+    };
+
+    void updateVertex(int i) {
+        if (i != goalNode) {
+            uint32_t rhs = GRID_SEARCH_INFINITE;
+            for (int d = 0; d < 8; d++) {
+                int n = find(nodes[i].x + DX[d], nodes[i].y + DY[d]);
+                if ((n < 0) || (nodes[n].g == GRID_SEARCH_INFINITE)) continue;
+                uint32_t c = edgeCost(i, n, d);
+                if (c == GRID_SEARCH_INFINITE) continue;
+                c += nodes[n].g;
+                if (c < rhs) rhs = c;
+            }
+            nodes[i].rhs = (rhs >= GRID_SEARCH_INFINITE) ? GRID_SEARCH_INFINITE : rhs;
+        }
+        if (nodes[i].g != nodes[i].rhs) insert(i);
+          else remove(i);
+    };
+
+    // update neighbours of node (blocked cells are not allocated)
+    void updateNeighbours(int i) {
+        int x = nodes[i].x;
+        int y = nodes[i].y;
+        for (int d = 0; d < 8; d++) {
+            int n = find(x + DX[d], y + DY[d]);
+            if (n < 0) {
+                if (costFunc(x + DX[d], y + DY[d]) == 0) continue;
+                n = alloc(x + DX[d], y + DY[d]);
+                if (n < 0) return;
+            }
+            updateVertex(n);
+        }
+    };
+
+    bool computeShortestPath() {
+        overflow = false;
+        while (heapCount > 0) {
+            if (startNode < 0) startNode = find(startX, startY);
+            uint32_t startKey = (startNode < 0) ? 0xFFFFFFFF : calcKey(startNode);
+            bool startConsistent = (startNode < 0) || (nodes[startNode].g == nodes[startNode].rhs);
+            int u = heap[0];
+            uint32_t oldKey = heapKey(u);
+            if ((oldKey >= startKey) && (startConsistent)) break;
+            if (++expansions > maxExpansions) {
+                overflow = true;
+                return false;
+            }
+            uint32_t newKey = calcKey(u);
+            if (oldKey < newKey) {
+                insert(u);
+            } else if (nodes[u].g > nodes[u].rhs) {
+                nodes[u].g = nodes[u].rhs;
+                remove(u);
+                updateNeighbours(u);
+            } else {
+                nodes[u].g = GRID_SEARCH_INFINITE;
+                updateVertex(u);
+                updateNeighbours(u);
+            }
+            if (overflow) return false;
+        }
+        if (startNode < 0) startNode = find(startX, startY);
+        return ((startNode >= 0) && (nodes[startNode].rhs != GRID_SEARCH_INFINITE));
+    };
+};
+
+// straight directions first (0..3), then diagonal directions (4..7)
+template <int NODES, int BUCKETS> const int8_t GridSearch<NODES, BUCKETS>::DX[8] = { 1, 0, -1, 0, 1, -1, -1, 1 };
+template <int NODES, int BUCKETS> const int8_t GridSearch<NODES, BUCKETS>::DY[8] = { 0, 1, 0, -1, 1, 1, -1, -1 };
+
+
+#endif
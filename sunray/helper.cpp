@@ -22,6 +22,7 @@ Private-use only! (you need to ask for a commercial-use)
 
 #include <Arduino.h>
 #include "helper.h"
+#include "instance.h"
 #include "config.h"
 
 // rescale to -PI..+PI
@@ -143,16 +144,51 @@ float serialToFloat(HardwareSerial* serial){
   return b.floatingPoint;
 }
 
+#if defined(_SAM3XA_)
+extern "C" char *sbrk(int incr);
+extern char _srelocate; // start of .data (linker script)
+extern char _end; // end of .bss, start of heap
+#endif
+
 int freeRam () {
 #ifdef __AVR__
   extern int __heap_start, *__brkval; 
   int v; 
   return (int) &v - (__brkval == 0 ? (int) &__heap_start : (int) __brkval); 
+#elif defined(_SAM3XA_)
+  char v;
+  return &v - sbrk(0); // between heap and stack
 #else
   return 0;
 #endif
 }
 
+void ramUsage(int &staticRam, int &heap){
+#if defined(_SAM3XA_)
+  staticRam = &_end - &_srelocate;
+  heap = sbrk(0) - &_end;
+#else
+  staticRam = 0;
+  heap = 0;
+#endif
+}
+
+
+void cycleCounterBegin(){
+#if defined(_SAM3XA_)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+uint32_t cycleCounter(){
+#if defined(_SAM3XA_)
+  return DWT->CYCCNT;
+#else
+  return micros() * CYCLES_PER_MICROSECOND;
+#endif
+}
 
 
 /*
@@ -200,6 +236,96 @@ float gaussian(float mu, float sigma, float x)
 }
 
 
+// xorshift32 (Marsaglia)
+static SUNRAY_INSTANCE uint32_t fastRandomState = 2463534242UL;
+
+void fastRandomSeed(uint32_t seed){
+  if (seed != 0) fastRandomState = seed;
+}
+
+uint32_t fastRandom(){
+  fastRandomState ^= fastRandomState << 13;
+  fastRandomState ^= fastRandomState >> 17;
+  fastRandomState ^= fastRandomState << 5;
+  return fastRandomState;
+}
+
+float fastRandomFloat(){
+  return (((float)(fastRandom() >> 8)) + 0.5f) * (1.0f / 16777216.0f);
+}
+
+// ziggurat tables (128 layers, Marsaglia and Tsang 2000) 
+#define ZIGGURAT_R 3.442619855899
+static SUNRAY_INSTANCE bool zigguratInitialized = false;
+static SUNRAY_INSTANCE uint32_t zigguratK[128];
+static SUNRAY_INSTANCE float zigguratW[128];
+static SUNRAY_INSTANCE float zigguratF[128];
+
+static void zigguratInit(){
+  const double m = 2147483648.0;
+  double v = 9.91256303526217e-3;
+  double dn = ZIGGURAT_R;
+  double tn = dn;
+  double q = v / exp(-0.5 * dn * dn);
+  zigguratK[0] = (dn / q) * m;
+  zigguratK[1] = 0;
+  zigguratW[0] = q / m;
+  zigguratW[127] = dn / m;
+  zigguratF[0] = 1.0;
+  zigguratF[127] = exp(-0.5 * dn * dn);
+  for (int i=126; i >= 1; i--){
+    dn = sqrt(-2.0 * log(v / dn + exp(-0.5 * dn * dn)));
+    zigguratK[i+1] = (dn / tn) * m;
+    tn = dn;
+    zigguratF[i] = exp(-0.5 * dn * dn);
+    zigguratW[i] = dn / m;
+  }
+  zigguratInitialized = true;
+}
+
+float fastGaussRandom(){
+  if (!zigguratInitialized) zigguratInit();
+  while (true){
+    int32_t hz = (int32_t)fastRandom();
+    int iz = hz & 127;
+    uint32_t az = (hz < 0) ? -(uint32_t)hz : (uint32_t)hz;
+    float x = ((float)hz) * zigguratW[iz];
+    if (az < zigguratK[iz]) return x; // inside rectangle (~99% of samples)
+    if (iz == 0){
+      // base layer: sample from tail
+      float y;
+      do {
+        x = -log(fastRandomFloat()) / ((float)ZIGGURAT_R);
+        y = -log(fastRandomFloat());
+      } while (y + y < x * x);
+      return (hz > 0) ? ZIGGURAT_R + x : -ZIGGURAT_R - x;
+    }
+    // wedge
+    if (zigguratF[iz] + fastRandomFloat() * (zigguratF[iz-1] - zigguratF[iz]) < exp(-0.5f * x * x)) return x;
+  }
+}
+
+// sin table (full circle, one more entry for interpolation)
+#define SIN_TABLE_SIZE 256
+static SUNRAY_INSTANCE bool sinTableInitialized = false;
+static SUNRAY_INSTANCE float sinTable[SIN_TABLE_SIZE + 1];
+
+void fastSinCos(float angle, float &sinValue, float &cosValue){
+  if (!sinTableInitialized){
+    for (int i=0; i <= SIN_TABLE_SIZE; i++) sinTable[i] = sin(((float)i) / SIN_TABLE_SIZE * 2 * PI);
+    sinTableInitialized = true;
+  }
+  float f = angle * (SIN_TABLE_SIZE / (2 * PI));
+  int i = (int)f;
+  if (f < i) i--;
+  f -= i;
+  int idx = i & (SIN_TABLE_SIZE - 1);
+  sinValue = sinTable[idx] + f * (sinTable[idx+1] - sinTable[idx]);
+  idx = (i + SIN_TABLE_SIZE / 4) & (SIN_TABLE_SIZE - 1);
+  cosValue = sinTable[idx] + f * (sinTable[idx+1] - sinTable[idx]);
+}
+
+
 // Spannungsteiler Gesamtspannung ermitteln (Reihenschaltung R1-R2, U2 bekannt, U_GES zu ermitteln)
 float voltageDividerUges(float R1, float R2, float U2){
 	return (U2/R2 * (R1+R2));  // Uges 
@@ -36,6 +36,13 @@ float serialToFloat(HardwareSerial *serial);
 float parseFloatValue(String s, String key);
 
 int freeRam ();
+// static RAM (.data and .bss) and heap size (bytes)
+void ramUsage(int &staticRam, int &heap);
+
+// CPU cycle counter (Cortex-M3 DWT), call cycleCounterBegin once before using cycleCounter
+#define CYCLES_PER_MICROSECOND (F_CPU / 1000000)
+void cycleCounterBegin();
+uint32_t cycleCounter();
 
 /*
  * Returns random number in normal distribution centering on 0.
@@ -53,6 +60,58 @@ float gauss(float mean, float std_dev);
 // calculates the probability of x for 1-dim Gaussian with mean mu and var. sigma
 float gaussian(float mu, float sigma, float x);
 
+// fast pseudo random number generator (xorshift32)
+void fastRandomSeed(uint32_t seed);
+uint32_t fastRandom();
+
+// returns uniform random number in (0,1)
+float fastRandomFloat();
+
+// returns random number in standard normal distribution (ziggurat method, fast version of gaussRandom)
+float fastGaussRandom();
+
+// sin and cos of angle (rad) from lookup table (linear interpolation, max. error 0.0001)
+void fastSinCos(float angle, float &sinValue, float &cosValue);
+
+// fixed-point coordinates (meter): coord_t is a compact position (int16, COORD_SHIFT fractional bits: +-256 meter, 
+// 7.8 mm steps) e.g. for particles, lcoord_t an accumulated position (int32, LCOORD_SHIFT fractional bits: +-32 km, 
+// 15 um steps) e.g. for odometry - conversions round to nearest (toCoordDither: stochastic), coord_t saturates
+#define COORD_SHIFT   7
+#define COORD_ONE     (1 << COORD_SHIFT)
+#define LCOORD_SHIFT  16
+#define LCOORD_ONE    (1L << LCOORD_SHIFT)
+
+typedef int16_t coord_t;
+typedef int32_t lcoord_t;
+
+inline coord_t toCoord(float v){
+  float c = v * ((float)COORD_ONE) + ((v < 0) ? -0.5f : 0.5f);
+  if (c >= 32767.0f) return 32767;
+  if (c <= -32768.0f) return -32768;
+  return (coord_t)c;
+}
+
+// stochastic rounding of a step v in 1/65536 coordinate units (COORD_DITHER_ONE per meter, +-256 meter) with
+// dither (uniform 0..65535, fraction added before truncation) - unbiased for steps below 7.8 mm e.g. particle motion
+// per update, that round to nearest would lose (shallow course: zero y step), integer only (no float compare)
+#define COORD_DITHER_ONE (((float)COORD_ONE) * 65536.0f)
+
+inline coord_t toCoordDither(int32_t v, uint16_t dither){
+  return (coord_t)((v + (int32_t)dither) >> 16); // arithmetic shift: floor
+}
+
+inline float fromCoord(coord_t c){
+  return ((float)c) * (1.0f / COORD_ONE);
+}
+
+inline lcoord_t toLCoord(float v){
+  return (lcoord_t)(v * ((float)LCOORD_ONE) + ((v < 0) ? -0.5f : 0.5f));
+}
+
+inline float fromLCoord(lcoord_t c){
+  return ((float)c) * (1.0f / LCOORD_ONE);
+}
+
 
 // Spannungsteiler Gesamtspannung ermitteln (Reihenschaltung R1-R2, U2 bekannt, U_GES zu ermitteln)
 float voltageDividerUges(float R1, float R2, float U2);
@@ -41,6 +41,7 @@ Private-use only! (you need to ask for a commercial-use)
 #define GYRO_CAL_FIRST_INTERVAL 10000   // first gyro calibration
 #define GYRO_CAL_TIME  1000   // wait for one second for measurement
 #define GYRO_CAL_BIAS_DPS_MAX 0.01    // maximum allowed bias after calibration (degree per sec)
+#define GYRO_CAL_POSTPONE_MAX 5       // maximum gyro calibrations postponed in a row
 
 #define DEFAULT_MPU_HZ  (100)  // sensor sampling rate
 #define DMP_FIFO_RATE 5       // DMP FIFO rate
@@ -51,7 +52,7 @@ Private-use only! (you need to ask for a commercial-use)
 #define CMPS11   (0x60)          // CMPS11 compass sensor
 
 
-IMUClass IMU;
+SUNRAY_INSTANCE IMUClass IMU;
 //Adafruit_BNO055 bno = Adafruit_BNO055(55);
 
 
@@ -394,6 +395,7 @@ void IMUClass::begin()
   
   // mpu_set_compass_sample_rate(100);
   nextGyroCalTime = millis() + GYRO_CAL_FIRST_INTERVAL;
+  gyroCalPostponed = 0;
 }
 
 
@@ -727,6 +729,17 @@ bool IMUClass::needGyroCal(){
   return ((state == IMU_RUN) && (millis() >= nextGyroCalTime));
 }
 
+// postpone gyro calibration (e.g. heading is corrected by localization) - returns false if
+// calibration has been postponed too often
+bool IMUClass::postponeGyroCal(){
+  if (gyroCalPostponed >= GYRO_CAL_POSTPONE_MAX) return false;
+  gyroCalPostponed++;
+  nextGyroCalTime = millis() + GYRO_CAL_INTERVAL;
+  DEBUG(F("gyro calibration postponed, nextGyroCalTime="));
+  DEBUGLN(nextGyroCalTime);
+  return true;
+}
+
 bool IMUClass::needCompassCal(){
   return false;
   //return (!comCalibrated);
@@ -839,6 +852,7 @@ bool IMUClass::calibrateGyro(){
     }
     statsGyroCalibrationTimeMax = max(statsGyroCalibrationTimeMax, (millis()-gyroCalStartTime) / 1000);
     nextGyroCalTime = millis() + GYRO_CAL_INTERVAL;
+    gyroCalPostponed = 0;
   	DEBUG(F("nextGyroCalTime="));    
 	  DEBUGLN(nextGyroCalTime);
     //dmp_enable_gyro_cal(false);
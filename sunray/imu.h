@@ -21,6 +21,7 @@ How to use:
 #define IMU_H
 
 #include "helper_3dmath.h"
+#include "instance.h"
 //#include "adafruit/Adafruit_Sensor.h"
 //#include "adafruit/Adafruit_BNO055.h"
 //#include "adafruit/imumaths.h"
@@ -116,6 +117,7 @@ class IMUClass {
    void run();   
    float getYaw();
    bool needGyroCal();
+   bool postponeGyroCal();
    bool needCompassCal();      
    void startGyroCalibration();  
    void calibrateAcceleration();
@@ -132,6 +134,7 @@ class IMUClass {
    unsigned long nextComTime;
    unsigned long nextInfoTime;
    unsigned long nextGyroCalTime;
+   int gyroCalPostponed;
    unsigned long gyroCalStartTime;
    unsigned long gyroCalStopTime;
    unsigned long comMinMaxTimeout;   
@@ -153,7 +156,7 @@ class IMUClass {
 };
 
 
-extern IMUClass IMU;
+extern SUNRAY_INSTANCE IMUClass IMU;
 
 #endif
 
@@ -0,0 +1,16 @@
+// sketch singletons (Map, Planner, Robot, ...): one instance on the robot - host builds run one instance per
+// thread (e.g. parallel simulations), SUNRAY_INSTANCE is defined as thread_local by the host Arduino.h
+//
+// usage:
+//   extern SUNRAY_INSTANCE MapClass Map;        // header
+//   SUNRAY_INSTANCE MapClass Map;               // source
+//   static SUNRAY_INSTANCE int pathCells = 1;   // module state used by the singleton
+
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#ifndef SUNRAY_INSTANCE
+#define SUNRAY_INSTANCE
+#endif
+
+#endif
@@ -0,0 +1,138 @@
+// learned perimeter magnitude field: running mean and variance of left and right coil magnitude per cell
+//
+// usage:
+//   MagField<512> field;
+//   field.begin(0.5, 3000);                     // cell size (meter), magnitude scale (normalized magnitude 1.0)
+//   field.learn(x, y, leftMag, rightMag);       // robot well localized
+//   int idx = field.find(x, y);                 // learned cell or -1
+//   if (field.count(idx) >= 8) ... field.mean(idx, 0), field.variance(idx, 0)
+//
+// cells are stored in a hash table (open addressing, linear probing) so only visited cells use memory - if the
+// table is full, new cells are not learned (rejected counter); statistics are fixed-point (normalized magnitude,
+// 12 fractional bits), the sample count saturates at MAG_FIELD_COUNT_MAX so mean and variance follow slow
+// changes of the field (exponential forgetting)
+
+#ifndef MAGFIELD_H
+#define MAGFIELD_H
+
+#include <inttypes.h>
+#include <math.h>
+
+#define MAG_FIELD_SHIFT      12      // fixed-point fractional bits
+#define MAG_FIELD_ONE        (1 << MAG_FIELD_SHIFT)
+#define MAG_FIELD_COUNT_MAX  32      // sample count saturation (forgetting rate 1/32)
+#define MAG_FIELD_PROBES     16      // max. probed slots per lookup
+
+
+template <int N> class MagField {
+
+public:
+
+    int cells;           // learned cells
+    long rejected;       // samples not learned (table full)
+    float cellSize;
+
+    MagField() {
+        begin(0.5, 1);
+    };
+
+    void begin(float size, float magScale) {
+        cellSize = size;
+        scale = 1.0 / size;
+        magToFixed = ((float)MAG_FIELD_ONE) / magScale;
+        clear();
+    };
+
+    void clear() {
+        cells = 0;
+        rejected = 0;
+        for (int i = 0; i < N; i++) entries[i].count = 0;
+    };
+
+    // add magnitude sample of both coils at position (meter)
+    void learn(float x, float y, float leftMag, float rightMag) {
+        int idx = slot(cell(x), cell(y), true);
+        if (idx < 0) {
+            rejected++;
+            return;
+        }
+        entry_t &e = entries[idx];
+        if (e.count < MAG_FIELD_COUNT_MAX) e.count++;
+        update(e, 0, leftMag);
+        update(e, 1, rightMag);
+    };
+
+    // learned cell at position (meter) or -1
+    int find(float x, float y) {
+        return slot(cell(x), cell(y), false);
+    };
+
+    uint8_t count(int idx) {
+        return entries[idx].count;
+    };
+
+    // mean of coil (0: left, 1: right) as normalized magnitude
+    float mean(int idx, int coil) {
+        return ((float)entries[idx].mean[coil]) / MAG_FIELD_ONE;
+    };
+
+    // variance of coil (normalized magnitude^2)
+    float variance(int idx, int coil) {
+        return ((float)entries[idx].var[coil]) / MAG_FIELD_ONE;
+    };
+
+protected:
+
+    struct entry_t {
+        int16_t x;
+        int16_t y;
+        uint8_t count;       // samples (0: empty slot)
+        int16_t mean[2];     // normalized magnitude (fixed-point)
+        uint16_t var[2];     // normalized magnitude^2 (fixed-point)
+    };
+
+    float scale;
+    float magToFixed;
+    entry_t entries[N];
+
+    int cell(float v) {
+        return (int)floor(v * scale);
+    };
+
+    // slot of cell (insert: allocate empty slot) or -1
+    int slot(int cx, int cy, bool insert) {
+        uint32_t h = ((uint32_t)cx) * 73856093u ^ ((uint32_t)cy) * 19349663u;
+        int idx = (h ^ (h >> 16)) & (N - 1);
+        for (int p = 0; p < MAG_FIELD_PROBES; p++) {
+            entry_t &e = entries[idx];
+            if (e.count == 0) {
+                if (!insert) return -1;
+                e.x = cx;
+                e.y = cy;
+                e.mean[0] = e.mean[1] = 0;
+                e.var[0] = e.var[1] = 0;
+                cells++;
+                return idx;
+            }
+            if ((e.x == cx) && (e.y == cy)) return idx;
+            idx = (idx + 1) & (N - 1);
+        }
+        return -1;
+    };
+
+    // running mean and variance (Welford, count already incremented)
+    void update(entry_t &e, int coil, float mag) {
+        int32_t v = (int32_t)(mag * magToFixed);
+        if (v > 16383) v = 16383; // normalized magnitude 4.0
+        if (v < -16383) v = -16383;
+        int32_t delta = v - e.mean[coil];
+        int32_t m = e.mean[coil] + delta / e.count;
+        int32_t var = e.var[coil];
+        var += (((delta * (v - m)) >> MAG_FIELD_SHIFT) - var) / e.count;
+        e.mean[coil] = m;
+        e.var[coil] = (var < 0) ? 0 : ((var > 65535) ? 65535 : var);
+    };
+};
+
+
+#endif
@@ -28,12 +28,50 @@ Private-use only! (you need to ask for a commercial-use)
 #include "config.h"
 #include "flashmem.h"
 #include "imu.h"
+#include "sonar.h"
+#include "bumper.h"
+#include "planner.h"
 
-MapClass Map;
+SUNRAY_INSTANCE MapClass Map;
 
-#define ADDR 100
-#define MAGIC 1
+static_assert(sizeof(MapClass) <= MAP_RAM_BUDGET, "MapClass exceeds RAM budget");
 
+#define ADDR 1024
+#define MAGIC 4
+
+// zone flash layout: zone index at ADDR, followed by one slot per zone (tile directories, outline and
+// tile pool, each starting at a flash page so a flash page holds 8 tiles) - the signal field is computed from the outline
+#define ZONE_PAGE_SIZE  256
+#define ZONE_PAGES(n)   (((n) + ZONE_PAGE_SIZE - 1) / ZONE_PAGE_SIZE * ZONE_PAGE_SIZE)
+#define ZONE_ADDR       (ADDR + ZONE_PAGES(sizeof(map_zone_index_t)))
+#define ZONE_DIR        0
+#define ZONE_DIR_SIZE   (MAP_TILES_MAX * sizeof(uint16_t))
+#define ZONE_OUTLINE    (ZONE_DIR + ZONE_PAGES(MAP_LAYERS * ZONE_DIR_SIZE))
+#define ZONE_POOL       (ZONE_OUTLINE + ZONE_PAGES(OUTLINE_SIZE * sizeof(point_t)))
+#define ZONE_SLOT_SIZE  (ZONE_POOL + ZONE_PAGES(MAP_TILE_POOL_SIZE * MAP_TILE_SIZE * sizeof(uint16_t)))
+
+// mowed state snapshot (flash, after zone slots): header, mowed layer directory, its tiles in directory order
+#define MOWED_ADDR      (ZONE_ADDR + MAP_ZONES_MAX * ZONE_SLOT_SIZE)
+#define MOWED_DIR       (MOWED_ADDR + ZONE_PAGES(sizeof(map_mowed_t)))
+#define MOWED_POOL      (MOWED_DIR + ZONE_PAGES(ZONE_DIR_SIZE))
+
+// zone index (flash)
+struct map_zone_index_t {
+  int16_t magic;
+  int16_t activeZone;
+  map_zone_t zones[MAP_ZONES_MAX];
+};
+
+
+// mowed state snapshot (flash)
+struct map_mowed_t {
+  int16_t sizeX; // grid size (cells)
+  int16_t sizeY;
+  int16_t tiles; // allocated tiles of mowed layer
+  int16_t tilesPromoted;
+  int32_t cellsPromoted;
+  uint32_t mowingTime;
+};
 
 void MapClass::begin()
 {
@@ -46,9 +84,20 @@ void MapClass::begin()
   lastMotorRightTicks = 0;
 
   perimeterWireLengthMeter = 15;
-  steeringNoise = 0.005;
-  distanceNoise = 0.01;
-  measurementNoise = 0.01;
+  steeringNoise = MAP_STEERING_NOISE;
+  distanceNoise = MAP_DISTANCE_NOISE;
+  measurementNoise = MAP_MEASUREMENT_NOISE;
+  headingNoise = 0.001;
+  headingBias = 0;
+  headingBiasSpread = MAP_HEADING_BIAS_INIT;
+  cuttingWidth = MAP_CUTTING_WIDTH;
+  coverageTarget = MAP_COVERAGE_TARGET;
+  mapCellsInside = 0;
+  mapCellsMowed = 0;
+  mapTilesPromoted = 0;
+  mapCellsPromoted = 0;
+  mowingTime = 0;
+  lastMowingTime = 0;
 
   mapValid = false;
   robotState.x = 0;
@@ -56,16 +105,41 @@ void MapClass::begin()
   //robotState.orientation = 0;
   currMapX = 0;
   currMapY = 0;
-  mapScaleX = 0;
-  mapScaleY = 0;
-  nextSampleTime = 0;
+  setMapScale(0, 0);
+  mapResolution = MAP_RESOLUTION;
+  map_data_t md;
+  md.v = 0;
+  md.s.side = MAP_DATA_SIDE_OUT;
+  clearMap(MAP_TILE_SIZE, MAP_TILE_SIZE, md);
   perimeterOutlineSize = 0;
   distAvgSum = 0;
   overallProb = 0;
 	verboseOutput = false;
+  filterStage = FILTER_STAGE_IDLE;
+  filterBudget = FILTER_BUDGET_US;
+  filterUpdates = 0;
+  filterDistanceSum = 0;
+  filterUpdateTime = 0;
+  filterUpdateDuration = 0;
+  filterMaxSliceTime = 0;
+  filterLastUpdateTime = 0;
+  filterRobotState = STAT_IDLE;
+  replaySteps = 0;
+  for (int i = 0; i < FILTER_STAGES; i++) filterStageTime[i] = 0;
+  cycleCounterBegin();
+  filter.minSize = MAP_PARTICLES_MIN;
+  magField.begin(MAP_LEARN_CELL_SIZE, MAP_LIKELIHOOD_MAG_MAX);
+  filter.binScale = 2.0 / COORD_ONE; // KLD bins per coordinate unit (0.5 meter)
+  buildLikelihoodField();
+  setMeasurement(0, 0);
 
   clearOutline();
   //exampleOutline();
+  lastSonarMeasurements = 0;
+  lastBumperPressed = false;
+  mapCellsObstacle = 0;
+  occupancy.begin(MAP_OCC_MIN, MAP_OCC_MAX);
+  loadZoneIndex();
   //correctOutline();
   //transferOutlineToMap();
   loadMap();
@@ -75,70 +149,196 @@ void MapClass::begin()
 }
 
 
-void MapClass::setParticlesState(float x, float y, float orientation) {
-  for (int i = 0; i < OUTLINE_PARTICLES; i++) {
-    outlineParticles[i].x = x;
-    outlineParticles[i].y = y;
-    //particles[i].orientation=orientation;
+void MapClass::setParticlesState(float x, float y, float theta) {
+  filter.setSize(filter.minSize); // pose known
+  coord_t cx = toCoord(x);
+  coord_t cy = toCoord(y);
+  for (int i = 0; i < filter.size(); i++) {
+    filter.x[i] = cx;
+    filter.y[i] = cy;
+    filter.theta[i] = theta;
   }
+  filter.resetWeights();
 }
 
 void MapClass::robotMotion(float course, float distance) {
   //robotState.orientation = course;
+  float lastX = robotState.x;
+  float lastY = robotState.y;
   robotState.x += distance * cos(course);
   robotState.y += distance * sin(course);
 
-  if (Robot.state == STAT_MOW) {
-    map_data_t md = getMapDataMeter(robotState.x, robotState.y);
-    if (md.s.state == MAP_DATA_STATE_UNMOWED) {
-      md.s.state = MAP_DATA_STATE_MOWED;
-      setMapDataMeter(robotState.x, robotState.y, md);
+  if (Robot.state == STAT_MOW) mowSegment(lastX, lastY, robotState.x, robotState.y);
+}
+
+// mark cells swept by the cutter moving from (x0,y0) to (x1,y1) as mowed (meter): inside cells with center 
+// closer than half cutting width to the motion segment (at least the cell under the robot)
+void MapClass::mowSegment(float x0, float y0, float x1, float y1) {
+  if ((!mapValid) || (mapScaleX <= 0)) return;
+  float radius = max(cuttingWidth / 2, 0.5 / mapScaleX);
+  float radiusSq = radius * radius;
+  float dx = x1 - x0;
+  float dy = y1 - y0;
+  float lenSq = dx * dx + dy * dy;
+  int xmin = max(0, (int)floor((min(x0, x1) - radius) * mapScaleX));
+  int xmax = min(mapSizeX - 1, (int)floor((max(x0, x1) + radius) * mapScaleX));
+  int ymin = max(0, (int)floor((min(y0, y1) - radius) * mapScaleY));
+  int ymax = min(mapSizeY - 1, (int)floor((max(y0, y1) + radius) * mapScaleY));
+  for (int yp = ymin; yp <= ymax; yp++) {
+    float cy = (((float)yp) + 0.5) / mapScaleY;
+    int row = mapSizeY - 1 - yp;
+    for (int xp = xmin; xp <= xmax; xp++) {
+      float cx = (((float)xp) + 0.5) / mapScaleX;
+      // distance of cell center to segment
+      float t = 0;
+      if (lenSq > 0) t = constrain(((cx - x0) * dx + (cy - y0) * dy) / lenSq, 0.0, 1.0);
+      float ex = x0 + t * dx - cx;
+      float ey = y0 + t * dy - cy;
+      if (ex * ex + ey * ey > radiusSq) continue;
+      if ( (getMapBit(MAP_LAYER_SIDE, xp, row)) || (getMapBit(MAP_LAYER_MOWED, xp, row))
+           || (getMapBit(MAP_LAYER_OBSTACLE, xp, row)) ) continue;
+      if (setMapBit(MAP_LAYER_MOWED, xp, row, true)) mapCellsMowed++;
+    }
+  }
+}
+
+// count inside and mowed cells (call after map was built or loaded, the counters are updated while mowing)
+void MapClass::countMapCells() {
+  mapCellsInside = 0;
+  mapCellsMowed = 0;
+  mapCellsObstacle = 0;
+  for (int ty = 0; ty < mapTilesY; ty++) {
+    int h = min(MAP_TILE_SIZE, mapSizeY - (ty << MAP_TILE_BITS));
+    for (int tx = 0; tx < mapTilesX; tx++) {
+      int w = min(MAP_TILE_SIZE, mapSizeX - (tx << MAP_TILE_BITS));
+      uint16_t mask = (w == MAP_TILE_SIZE) ? 0xFFFF : (1 << w) - 1;
+      int tileIdx = ty * mapTilesX + tx;
+      if (mapLayers[MAP_LAYER_SIDE][tileIdx] == (MAP_TILE_UNIFORM | MAP_DATA_SIDE_OUT)) continue;
+      for (int y = 0; y < h; y++) {
+        uint16_t inside = ~getMapRow(MAP_LAYER_SIDE, tileIdx, y) & mask;
+        uint16_t obstacle = getMapRow(MAP_LAYER_OBSTACLE, tileIdx, y) & inside;
+        inside &= ~obstacle;
+        mapCellsObstacle += __builtin_popcount(obstacle);
+        mapCellsInside += __builtin_popcount(inside);
+        mapCellsMowed += __builtin_popcount(getMapRow(MAP_LAYER_MOWED, tileIdx, y) & inside);
+      }
     }
   }
 }
 
+// start new mowing session: all mowed cells become unmowed
+void MapClass::resetMowed() {
+  clearMapLayer(MAP_LAYER_MOWED);
+  mapCellsMowed = 0;
+  mapTilesPromoted = 0;
+  mapCellsPromoted = 0;
+  mowingTime = 0;
+}
+
+// mowed inside cells (percent) - cells of promoted tiles are not counted
+float MapClass::coverage() {
+  if (mapCellsInside == 0) return 0;
+  return ((float)(mapCellsMowed - mapCellsPromoted)) * 100.0 / ((float)mapCellsInside);
+}
+
+// mowed area (square meter)
+float MapClass::mowedArea() {
+  if (mapScaleX <= 0) return 0;
+  return ((float)(mapCellsMowed - mapCellsPromoted)) / (mapScaleX * mapScaleY);
+}
+
+// mowing rate (square meter per hour)
+float MapClass::mowingRate() {
+  if (mowingTime < 1000) return 0;
+  return mowedArea() / (((float)mowingTime) / 3600000.0);
+}
+
+bool MapClass::isCoverageReached() {
+  return ( (mapValid) && (mapCellsInside > 0) && (coverage() >= coverageTarget) );
+}
+
 void MapClass::particlesMotion(float course, float distance) {
+  particlesMotion(course, distance, 0, filter.size());
+}
+
+// particle course is the nominal course plus a small angle (heading offset, steering noise): sin/cos of the
+// nominal course is shared by all particles, sin/cos of small angle by series (error below 1e-4 up to MAP_SMALL_ANGLE),
+// particle step in dither units (COORD_DITHER_ONE, distance and noise scaled once) is rounded by integer dither
+void MapClass::particlesMotion(float course, float distance, int startIdx, int endIdx) {
   // particles motion
-  for (int i = 0; i < OUTLINE_PARTICLES; i++) {
-    float particleCourse = gauss(course, steeringNoise); // steering noise
-    float particleDistance = gauss(distance, distanceNoise); // distance noise
-    //particles[i].orientation = particleCourse;
-    outlineParticles[i].x += particleDistance * cos(particleCourse);
-    outlineParticles[i].y += particleDistance * sin(particleCourse);
+  float sinCourse, cosCourse;
+  float sinNominal, cosNominal;
+  fastSinCos(course, sinNominal, cosNominal);
+  float stepDistance = distance * COORD_DITHER_ONE;
+  float stepNoise = distanceNoise * COORD_DITHER_ONE;
+  for (int i = startIdx; i < endIdx; i++) {
+    filter.theta[i] += fastGaussRandom() * headingNoise; // heading offset drift
+    float angle = filter.theta[i] + fastGaussRandom() * steeringNoise; // steering noise
+    float particleDistance = stepDistance + fastGaussRandom() * stepNoise; // distance noise
+    if ((angle < (float)MAP_SMALL_ANGLE) && (angle > -(float)MAP_SMALL_ANGLE)) { // float compare (no double math)
+      float angleSq = angle * angle;
+      float sinAngle = angle * (1.0f - angleSq * (1.0f / 6.0f));
+      float cosAngle = 1.0f - angleSq * (0.5f - angleSq * (1.0f / 24.0f));
+      sinCourse = sinNominal * cosAngle + cosNominal * sinAngle;
+      cosCourse = cosNominal * cosAngle - sinNominal * sinAngle;
+    } else fastSinCos(course + angle, sinCourse, cosCourse);
+    uint32_t dither = fastRandom(); // stochastic rounding: sub-unit motion is kept on average
+    filter.x[i] += toCoordDither((int32_t)(particleDistance * cosCourse), dither >> 16);
+    filter.y[i] += toCoordDither((int32_t)(particleDistance * sinCourse), dither & 0xFFFF);
   }
 }
 
 void MapClass::computeParticlesState() {
-  float maxx = -9999;
-  float minx = 9999;
-  float maxy = -9999;
-  float miny = 9999;
-  particlesState.x = 0;
-  particlesState.y = 0;
-  //particlesState.orientation=0;
-  for (int i = 0; i < OUTLINE_PARTICLES; i++) {
-    particlesState.x += outlineParticles[i].x;
-    particlesState.y += outlineParticles[i].y;
-    // orientation is tricky because it is cyclic. By normalizing
-    // around the first particle we are somewhat more robust to
-    // the 0=2pi problem
-    /*particlesState.orientation += ( fmod((particles[i].orientation
-                    - particles[0].orientation + M_PI) , (2.0 * M_PI))
-                    + particles[0].orientation - M_PI);*/
-    maxx = max(maxx, outlineParticles[i].x);
-    maxy = max(maxy, outlineParticles[i].y);
-    minx = min(minx, outlineParticles[i].x);
-    miny = min(miny, outlineParticles[i].y);
-  }
-  particlesState.x /= ((float)OUTLINE_PARTICLES);
-  particlesState.y /= ((float)OUTLINE_PARTICLES);
-  //particlesState.orientation/=((float)PARTICLES);
-  particlesDistanceX = maxx - minx;
-  particlesDistanceY = maxy - miny;
+  computeParticlesState(0, filter.size());
+}
+
+// weighted particles center, heading offset and particles extent (particles range, state is updated when last
+// particle is processed)
+void MapClass::computeParticlesState(int startIdx, int endIdx) {
+  if (startIdx == 0) {
+    stateSumX = 0;
+    stateSumY = 0;
+    stateSumTheta = 0;
+    stateSqSumTheta = 0;
+    stateMaxX = -32768;
+    stateMinX = 32767;
+    stateMaxY = -32768;
+    stateMinY = 32767;
+  }
+  for (int i = startIdx; i < endIdx; i++) {
+    stateSumX += filter.weights[i] * filter.x[i];
+    stateSumY += filter.weights[i] * filter.y[i];
+    // heading offset is small (no 0=2pi problem)
+    stateSumTheta += filter.weights[i] * filter.theta[i];
+    stateSqSumTheta += filter.weights[i] * filter.theta[i] * filter.theta[i];
+    stateMaxX = max(stateMaxX, filter.x[i]);
+    stateMaxY = max(stateMaxY, filter.y[i]);
+    stateMinX = min(stateMinX, filter.x[i]);
+    stateMinY = min(stateMinY, filter.y[i]);
+  }
+  if (endIdx == filter.size()) {
+    particlesState.x = stateSumX / COORD_ONE;
+    particlesState.y = stateSumY / COORD_ONE;
+    headingBias = stateSumTheta;
+    headingBiasSpread = sqrt(max(0.0f, stateSqSumTheta - stateSumTheta * stateSumTheta));
+    particlesDistanceX = fromCoord(stateMaxX) - fromCoord(stateMinX);
+    particlesDistanceY = fromCoord(stateMaxY) - fromCoord(stateMinY);
+  }
 }
 
 
 void MapClass::run() {
+  if (Robot.state == STAT_MOW) {
+    if (lastMowingTime != 0) mowingTime += millis() - lastMowingTime;
+    lastMowingTime = millis();
+  } else if (lastMowingTime != 0) {
+    if ((Robot.state == STAT_IDLE) || (Robot.state == STAT_CHG)) {
+      // mowing stopped (idle or docked): save coverage (no flash writes in the loop while mowing)
+      if (mapValid) saveMap();
+      lastMowingTime = 0;
+    } else lastMowingTime = millis(); // mowing paused (e.g. gyro calibration): pause is no mowing time
+  }
+  senseObstacles();
   if (fabs(Motor.distanceCmAvg) < 0.01) return;
   distAvgSum += Motor.distanceCmAvg / 100.0;
   //if (fabs(distAvgSum) < 0.001) return;
@@ -150,42 +350,275 @@ void MapClass::run() {
 		ROBOTMSG.println(yaw, 4);	
 	}
 	
-  /*
-    robotMotion(yaw, distAvgSum);
+  robotMotion(yaw + headingBias, distAvgSum);
 
-    if ((Robot.state == STAT_CREATE_MAP) && (Robot.trackState == TRK_RUN)) {
+  if ((Robot.state == STAT_CREATE_MAP) && (Robot.trackState == TRK_RUN)) {
     float dist = sqrt( sq(currMapX-robotState.x) + sq(currMapY-robotState.y) ) ;
-    if ( dist >= ((float)perimeterWireLengthMeter)/((float)OUTLINE_PARTICLES) ){
-      if (perimeterOutlineSize < OUTLINE_PARTICLES-1){
-        robot_state_t pt;
+    if ( dist >= ((float)perimeterWireLengthMeter)/((float)OUTLINE_SIZE) ){
+      if (perimeterOutlineSize < OUTLINE_SIZE-1){
+        point_t pt;
         pt.x = robotState.x;
         pt.y = robotState.y;
-        outlineParticles[perimeterOutlineSize]=pt;
+        perimeterOutline[perimeterOutlineSize]=pt;
       	perimeterOutlineSize++;
         //updateMap();
         currMapX = robotState.x;
         currMapY = robotState.y;
       }
     }
+  }
+
+  if ((Robot.state != STAT_CREATE_MAP) && (Robot.state != STAT_CAL_GYRO) && (mapValid)) {
+    // start particle filter update (processed by runFilter), motion of a running update is added to next update
+    filterDistanceSum += distAvgSum;
+    if (filterStage == FILTER_STAGE_IDLE) {
+      filterRobotState = Robot.state;
+      filterCourse = yaw;
+      filterDistance = filterDistanceSum;
+      filterDistanceSum = 0;
+      filterLeftMag = Perimeter.getMagnitude(IDX_LEFT);
+      filterRightMag = Perimeter.getMagnitude(IDX_RIGHT);
+      setMeasurement(filterLeftMag, filterRightMag);
+      if (isWellLocalized()) magField.learn(robotState.x, robotState.y, filterLeftMag, filterRightMag);
+      filterStage = FILTER_STAGE_MOTION;
+      filterIndex = 0;
+      filterStartTime = millis();
+      for (int i = 0; i < FILTER_STAGES; i++) filterStageCycles[i] = 0;
     }
+  }
+  distAvgSum = 0;
+}
+
+// is robot position and heading known precisely? (particles close together, recent filter update)
+bool MapClass::isWellLocalized() {
+  if ((!mapValid) || (filterUpdates == 0)) return false;
+  if (millis() > filterLastUpdateTime + MAP_LOCALIZED_TIMEOUT) return false;
+  return isConverged();
+}
+
+// are particles close together? (position and heading offset)
+bool MapClass::isConverged() {
+  return ( (particlesDistanceX < MAP_LOCALIZED_DISTANCE) && (particlesDistanceY < MAP_LOCALIZED_DISTANCE)
+           && (headingBiasSpread < MAP_LOCALIZED_HEADING) );
+}
+
+// occupancy layer: sonar rays (new distance evaluation) and bumper contacts (pressed) update obstacle log-odds
+// of map cells, only while mowing well localized
+void MapClass::senseObstacles() {
+  bool bumper = Bumper.pressed();
+  bool contact = (bumper) && (!lastBumperPressed);
+  lastBumperPressed = bumper;
+  bool ranges = (Sonar.measurements != lastSonarMeasurements);
+  lastSonarMeasurements = Sonar.measurements;
+  if ((!contact) && (!ranges)) return;
+  if ((Robot.state != STAT_MOW) || (!isWellLocalized())) return;
+  float course = IMU.getYaw() + headingBias;
+  if (contact) {
+    float contactCourse = course;
+    if (Motor.speedRpmSet < 0) contactCourse += PI; // reversing: contact at back
+    if (Bumper.leftPressed) senseContact(contactCourse + MAP_BUMPER_ANGLE);
+    if (Bumper.rightPressed) senseContact(contactCourse - MAP_BUMPER_ANGLE);
+  }
+  if ((ranges) && (Sonar.enabled)) {
+    senseRange(course, SONAR_ANGLE_LEFT / 180.0 * PI, Sonar.distanceLeft);
+    senseRange(course, 0, Sonar.distanceCenter);
+    senseRange(course, SONAR_ANGLE_RIGHT / 180.0 * PI, Sonar.distanceRight);
+  }
+}
+
+// sonar range (cm) at mounting angle (rad): cells passed by the ray are free, the end cell is occupied
+// (no echo: all cells free)
+void MapClass::senseRange(float course, float angle, unsigned int distance) {
+  if (distance == 0) return;
+  bool echo = (distance < SONAR_RANGE_MAX);
+  float s, c;
+  fastSinCos(course, s, c);
+  float x = (robotState.x + SONAR_OFFSET * c) * mapScaleX;
+  float y = (robotState.y + SONAR_OFFSET * s) * mapScaleY;
+  fastSinCos(course + angle, s, c);
+  occ_ray_t ray;
+  occupancy.beginRay(ray, x, y, c, s, min(distance, (unsigned int)SONAR_RANGE_MAX) / 100.0 * mapScaleX);
+  int cx, cy;
+  while (occupancy.nextRayCell(ray, cx, cy)) {
+    if ((echo) && (ray.steps < 0)) updateOccupancy(cx, cy, MAP_OCC_HIT, true);
+      else updateOccupancy(cx, cy, MAP_OCC_MISS, false);
+  }
+}
 
-    if ((Robot.state != STAT_CREATE_MAP) && (Robot.state != STAT_CAL_GYRO)) {
-      particlesMotion(yaw, distAvgSum);
-      float leftMag = Perimeter.getMagnitude(IDX_LEFT);
-      float rightMag = Perimeter.getMagnitude(IDX_RIGHT);
-      sense(leftMag, rightMag);
-      if (millis() >= nextSampleTime){
-        nextSampleTime = millis() + 1000;
-        computeParticlesState();
+// bumper contact at angle (rad) from robot center
+void MapClass::senseContact(float angle) {
+  float s, c;
+  fastSinCos(angle, s, c);
+  int xp = (int)floor((robotState.x + MAP_BUMPER_DISTANCE * c) * mapScaleX);
+  int yp = (int)floor((robotState.y + MAP_BUMPER_DISTANCE * s) * mapScaleY);
+  updateOccupancy(xp, yp, MAP_OCC_BUMPER, true);
+}
+
+// add log-odds to inside cell (insert: add cell to occupancy layer), mark cell as obstacle or restore cell 
+// state - obstacle cells of a loaded map start at marking level so they can be cleared by sonar rays
+void MapClass::updateOccupancy(int xp, int yp, int delta, bool insert) {
+  if ((xp < 0) || (yp < 0) || (xp >= mapSizeX) || (yp >= mapSizeY)) return;
+  int row = mapSizeY - 1 - yp;
+  map_data_t md = getMapCell(xp, row);
+  if (md.s.side != MAP_DATA_SIDE_IN) return;
+  int idx = occupancy.find(xp, yp);
+  if (idx < 0) {
+    if (md.s.state == MAP_DATA_STATE_OBSTACLE) {
+      idx = occupancy.insert(xp, yp);
+      if (idx < 0) return;
+      occupancy.add(idx, MAP_OCC_MARK);
+      occupancy.setMarked(idx, true, MAP_DATA_STATE_UNMOWED);
+    } else {
+      if (!insert) return;
+      idx = occupancy.insert(xp, yp);
+      if (idx < 0) return;
+    }
+  }
+  occupancy.add(idx, delta);
+  int logOdds = occupancy.logOdds(idx);
+  if ((!occupancy.isMarked(idx)) && (logOdds >= MAP_OCC_MARK)) {
+    uint8_t state = md.s.state;
+    md.s.state = MAP_DATA_STATE_OBSTACLE;
+    if (!setMapCell(xp, row, md)) return;
+    occupancy.setMarked(idx, true, state);
+    mapCellsInside--;
+    if (state == MAP_DATA_STATE_MOWED) mapCellsMowed--;
+    mapCellsObstacle++;
+  } else if ((occupancy.isMarked(idx)) && (logOdds <= MAP_OCC_UNMARK)) {
+    md.s.state = occupancy.markedState(idx);
+    if (!setMapCell(xp, row, md)) return;
+    occupancy.setMarked(idx, false, 0);
+    mapCellsInside++;
+    if (md.s.state == MAP_DATA_STATE_MOWED) mapCellsMowed++;
+    mapCellsObstacle--;
+  } else return;
+  Planner.cellChanged((((float)xp) + 0.5) / mapScaleX, (((float)yp) + 0.5) / mapScaleY);
+}
+
+// marked obstacle within distance (meter) ahead of robot (rays at robot center and cutter edges)
+bool MapClass::isObstacleAhead(float distance) {
+  if ((!mapValid) || (mapCellsObstacle == 0) || (!isWellLocalized())) return false;
+  float s, c;
+  fastSinCos(IMU.getYaw() + headingBias, s, c);
+  for (int i = -1; i <= 1; i++) {
+    float x = (robotState.x - i * cuttingWidth / 2 * s) * mapScaleX;
+    float y = (robotState.y + i * cuttingWidth / 2 * c) * mapScaleY;
+    occ_ray_t ray;
+    occupancy.beginRay(ray, x, y, c, s, distance * mapScaleX);
+    int cx, cy;
+    while (occupancy.nextRayCell(ray, cx, cy)) {
+      if ((cx < 0) || (cy < 0) || (cx >= mapSizeX) || (cy >= mapSizeY)) break;
+      if (getMapBit(MAP_LAYER_OBSTACLE, cx, mapSizeY - 1 - cy)) return true;
+    }
+  }
+  return false;
+}
+
+// replay recorded sensor data (log playback on PC, robot must be idle): moved distance (meter), IMU yaw (rad),
+// perimeter magnitudes and robot state of one control loop step - runs one complete particle filter update,
+// returns CPU time (microseconds)
+unsigned long MapClass::replayStep(float distance, float yaw, float leftMag, float rightMag, int state) {
+  if ((Robot.state != STAT_IDLE) || (filterStage != FILTER_STAGE_IDLE)) return 0;
+  uint32_t startCycles = cycleCounter();
+  robotMotion(yaw + headingBias, distance);
+  if ((state != STAT_CREATE_MAP) && (state != STAT_CAL_GYRO) && (mapValid)) {
+    filterRobotState = state;
+    particlesMotion(yaw, distance);
+    sense(leftMag, rightMag);
+    computeParticlesState();
+    robotState.x = particlesState.x;
+    robotState.y = particlesState.y;
+    if ((mapValid) && (isConverged())) magField.learn(robotState.x, robotState.y, leftMag, rightMag);
+  }
+  replaySteps++;
+  return (cycleCounter() - startCycles) / CYCLES_PER_MICROSECOND;
+}
+
+// replay map: 0=clear outline (followed by outline points), 1=transfer outline to map (map is not saved),
+// 2=end replay (load map from flash), 3=loop closure of outline (recorded outline, before 1)
+void MapClass::replayMap(int cmd) {
+  if (Robot.state != STAT_IDLE) return;
+  switch (cmd) {
+    case 0:
+      clearOutline();
+      break;
+    case 1:
+      transferOutlineToMap();
+      mapValid = true;
+      distributeParticlesOutline();
+      replaySteps = 0;
+      break;
+    case 2:
+      clearOutline();
+      mapValid = loadMap();
+      distributeParticlesOutline();
+      break;
+    case 3:
+      correctOutline();
+      break;
+  }
+}
+
+void MapClass::replayOutlinePoint(float x, float y) {
+  if ((Robot.state != STAT_IDLE) || (perimeterOutlineSize >= OUTLINE_SIZE - 1)) return;
+  perimeterOutline[perimeterOutlineSize].x = x;
+  perimeterOutline[perimeterOutlineSize].y = y;
+  perimeterOutlineSize++;
+}
+
+// process particle filter stages (call this in main loop): processes slices of particles until the
+// CPU time budget (filterBudget) is used up, continues with next call
+void MapClass::runFilter() {
+  if (filterStage == FILTER_STAGE_IDLE) return;
+  uint32_t startCycles = cycleCounter();
+  uint32_t budgetCycles = filterBudget * CYCLES_PER_MICROSECOND;
+  uint32_t sliceStartCycles = startCycles;
+  uint32_t cycles = startCycles;
+  while ((filterStage != FILTER_STAGE_IDLE) && (cycles - startCycles < budgetCycles)) {
+    int endIdx = min(filter.size(), filterIndex + FILTER_SLICE);
+    switch (filterStage) {
+      case FILTER_STAGE_MOTION:
+        particlesMotion(filterCourse, filterDistance, filterIndex, endIdx);
+        break;
+      case FILTER_STAGE_SENSE:
+        weightParticles(filterIndex, endIdx);
+        break;
+      case FILTER_STAGE_RESAMPLE:
+        overallProb = filter.normalize();
+        filter.resample(fastRandomFloat());
+        endIdx = filter.size();
+        break;
+      case FILTER_STAGE_STATE:
+        computeParticlesState(filterIndex, endIdx);
+        break;
+    }
+    filterIndex = endIdx;
+    cycles = cycleCounter();
+    filterStageCycles[filterStage] += cycles - sliceStartCycles;
+    sliceStartCycles = cycles;
+    if (filterIndex == filter.size()) {
+      // stage completed
+      filterIndex = 0;
+      filterStage++;
+      if (filterStage == FILTER_STAGES) {
+        // update completed
         robotState.x = particlesState.x;
         robotState.y = particlesState.y;
+        filterUpdateTime = 0;
+        for (int i = 0; i < FILTER_STAGES; i++) {
+          filterStageTime[i] = filterStageCycles[i] / CYCLES_PER_MICROSECOND;
+          filterUpdateTime += filterStageTime[i];
+        }
+        filterUpdateDuration = millis() - filterStartTime;
+        filterLastUpdateTime = millis();
+        filterUpdates++;
+        filterStage = FILTER_STAGE_IDLE;
       }
     }
-  */
-  distAvgSum = 0;
+  }
+  filterMaxSliceTime = max(filterMaxSliceTime, (cycles - startCycles) / CYCLES_PER_MICROSECOND);
 }
 
-
 void MapClass::clearOutline() {
   DEBUGLN(F("clearOutline"));
   perimeterOutlineSize = 0;
@@ -197,171 +630,504 @@ void MapClass::clearOutline() {
 }
 
 void MapClass::exampleOutline() {
-  for (int i = 0; i < OUTLINE_PARTICLES; i++) {
-    robot_state_t pt1;
-    pt1.x = cos(((float)i) / (OUTLINE_PARTICLES) * 1.6 * PI) * 0.5;
-    pt1.y = sin(((float)i) / (OUTLINE_PARTICLES) * 1.6 * PI) * 0.5;
-    outlineParticles[i] = pt1;
+  for (int i = 0; i < OUTLINE_SIZE; i++) {
+    point_t pt1;
+    pt1.x = cos(((float)i) / (OUTLINE_SIZE) * 1.6 * PI) * 0.5;
+    pt1.y = sin(((float)i) / (OUTLINE_SIZE) * 1.6 * PI) * 0.5;
+    perimeterOutline[i] = pt1;
   }
 }
 
+// distance to first outline points (map closure) - only MAP_START_POINTS points, a linear scan (squared distances)
+// is faster than any index here
 float MapClass::distanceToStart(float x, float y) {
   float res = 99999;
-  if (perimeterOutlineSize < OUTLINE_PARTICLES * 0.2) return res;
-  for (int i = 0; i < 10; i++) {
-    float dist = sqrt( sq(x - outlineParticles[i].x) + sq(y - outlineParticles[i].y) );
-    res = min(res, dist);
+  if (perimeterOutlineSize < OUTLINE_SIZE * 0.2) return res;
+  float bestSq = 1e9;
+  for (int i = 0; i < MAP_START_POINTS; i++) {
+    bestSq = min(bestSq, sq(x - perimeterOutline[i].x) + sq(y - perimeterOutline[i].y));
   }
-  return res;
+  return sqrt(bestSq);
 }
 
 
+// loop closure: distribute the start-to-end error over all outline points (least squares for independent step
+// errors) - the correction of point k is the error times the variance sum of steps 1..k divided by the variance
+// sum of all steps, step variance grows with step length (odometry) and with travelled distance (heading drift)
 void MapClass::correctOutline() {
   DEBUGLN(F("correctOutline"));
   int sz = perimeterOutlineSize;
-  if (sz == 0) return;
-  for (int i = perimeterOutlineSize - 1; i > 0; i--) {
-    // determine error
-    float errx = outlineParticles[perimeterOutlineSize - 1].x - outlineParticles[0].x;
-    float erry = outlineParticles[perimeterOutlineSize - 1].y - outlineParticles[0].y;
-    float dist = sqrt( sq(errx) + sq(erry) );
-    if (dist < 0.01) break;
-    // determine piece distance
-    float diffX = outlineParticles[i].x - outlineParticles[i - 1].x;
-    float diffY = outlineParticles[i].y - outlineParticles[i - 1].y;
-    if (  (sign(errx) == sign(diffX)) && (sign(erry) == sign(diffY))
-          && (fabs(diffX) < fabs(errx))
-          && (fabs(diffY) < fabs(erry))     )
-    {
-      // outline piece helps us to reduce error => remove piece
-      for (int j = i; j < perimeterOutlineSize; j++) {
-        outlineParticles[j].x -= diffX;
-        outlineParticles[j].y -= diffY;
-      }
-    }
+  if (sz < 2) return;
+  unsigned long startTime = micros();
+  float errx = perimeterOutline[sz - 1].x - perimeterOutline[0].x;
+  float erry = perimeterOutline[sz - 1].y - perimeterOutline[0].y;
+  // variance sum of all steps
+  float total = 0;
+  float dist = 0;
+  for (int i = 1; i < sz; i++) {
+    float len = sqrt( sq(perimeterOutline[i].x - perimeterOutline[i - 1].x) + sq(perimeterOutline[i].y - perimeterOutline[i - 1].y) );
+    total += len * MAP_CLOSURE_DIST_NOISE + sq(len) * (dist + len / 2) * MAP_CLOSURE_HEADING_NOISE;
+    dist += len;
+  }
+  // correct points (step lengths are taken from uncorrected points)
+  float sum = 0;
+  float maxCorr = 0;
+  dist = 0;
+  float lastX = perimeterOutline[0].x;
+  float lastY = perimeterOutline[0].y;
+  for (int i = 1; (i < sz) && (total > 0); i++) {
+    float len = sqrt( sq(perimeterOutline[i].x - lastX) + sq(perimeterOutline[i].y - lastY) );
+    lastX = perimeterOutline[i].x;
+    lastY = perimeterOutline[i].y;
+    sum += len * MAP_CLOSURE_DIST_NOISE + sq(len) * (dist + len / 2) * MAP_CLOSURE_HEADING_NOISE;
+    dist += len;
+    float f = sum / total;
+    perimeterOutline[i].x -= errx * f;
+    perimeterOutline[i].y -= erry * f;
+    maxCorr = max(maxCorr, sqrt( sq(errx) + sq(erry) ) * f);
   }
   // connect end and start
-  robot_state_t pt;
-  pt.x = outlineParticles[0].x;
-  pt.y = outlineParticles[0].y;
-  outlineParticles[perimeterOutlineSize] = pt;
-  perimeterOutlineSize++;
+  point_t pt;
+  pt.x = perimeterOutline[0].x;
+  pt.y = perimeterOutline[0].y;
+  perimeterOutline[sz - 1] = pt;
+  DEBUG(F("closure error="));
+  DEBUG(sqrt( sq(errx) + sq(erry) ));
+  DEBUG(F(" length="));
+  DEBUG(dist);
+  DEBUG(F(" points="));
+  DEBUG(sz);
+  DEBUG(F(" max. correction="));
+  DEBUG(maxCorr);
+  DEBUG(F(" cpu(us)="));
+  DEBUGLN(micros() - startTime);
 }
 
 void MapClass::transferOutlineToMap() {
   DEBUGLN(F("transferOutlineToMap"));
   map_data_t md;
+  md.v = 0;
   md.s.signal = 0;
   md.s.state = MAP_DATA_STATE_UNMOWED;
   md.s.side = MAP_DATA_SIDE_OUT;
-  memset(mapData, md.v, sizeof mapData);
   float minX = 9999;
   float maxX =  -9999;
   float minY = 9999;
   float maxY =  -9999;
 
   for (int i = 0; i < perimeterOutlineSize; i++) {
-    float x = outlineParticles[i].x;
-    float y = outlineParticles[i].y;
+    float x = perimeterOutline[i].x;
+    float y = perimeterOutline[i].y;
     minX = min(minX, x);
     maxX = max(maxX, x);
     minY = min(minY, y);
     maxY = max(maxY, y);
   }
   for (int i = 0; i < perimeterOutlineSize; i++) {
-    outlineParticles[i].x -= minX;
-    outlineParticles[i].y -= minY;
+    perimeterOutline[i].x -= minX;
+    perimeterOutline[i].y -= minY;
   }
   float deltaX = fabs(maxX - minX);
   float deltaY = fabs(maxY - minY);
-  float delta = max(deltaX, deltaY);
-  mapScaleX = ((float)MAP_SIZE_X - 1) / delta;
-  mapScaleY = ((float)MAP_SIZE_Y - 1) / delta;
+  if (max(deltaX, deltaY) >= 32767.0 / COORD_ONE) DEBUGLN(F("Map error: extent exceeds particle coordinates"));
   robotState.x -= minX;
   robotState.y -= minY;
-  float meterPerPixel = min(1 / mapScaleX, 1 / mapScaleY);
+  // start with requested resolution, use a coarser grid if map extent or tile pool is exceeded (side layer must
+  // leave one tile for each tile with inside cells for the mowed layer and MAP_TILE_RESERVE tiles for obstacle layer)
+  float meterPerPixel = mapResolution;
+  while (true) {
+    int sizeX = ((int)(deltaX / meterPerPixel)) + 2;
+    int sizeY = ((int)(deltaY / meterPerPixel)) + 2;
+    int tiles = ((sizeX + MAP_TILE_MASK) >> MAP_TILE_BITS) * ((sizeY + MAP_TILE_MASK) >> MAP_TILE_BITS);
+    if (tiles <= MAP_TILES_MAX) {
+      clearMap(sizeX, sizeY, md);
+      setMapScale(1.0 / meterPerPixel, 1.0 / meterPerPixel);
+      rasterizeOutline(true); // perimeter pixels (obstacle layer) stop the fill
+      DEBUGLN(F("resetMapData"));
+      //resetMapDataOutside(0, 0);
+      resetMapDataInside(mapSizeX * 0.3, mapSizeY * 0.3); // set inside state, remaining is outside (FIXME: will not work if perimeter or outside at that pixel)
+      resetMapDataSignal(); // signal strength from perimeter pixels
+      clearMapLayer(MAP_LAYER_OBSTACLE);
+      compactMapTiles();
+      int insideTiles = 0;
+      for (int i = 0; i < mapTilesX * mapTilesY; i++) {
+        if (mapLayers[MAP_LAYER_SIDE][i] != (MAP_TILE_UNIFORM | MAP_DATA_SIDE_OUT)) insideTiles++;
+      }
+      if ((mapTileOverflow == 0) && (mapTilesUsed + insideTiles <= MAP_TILE_POOL_SIZE - MAP_TILE_RESERVE)) break;
+    }
+    meterPerPixel *= 1.25;
+  }
+  buildLikelihoodField();
+  countMapCells();
+  magField.clear();
+  occupancy.clear();
+  mowingTime = 0;
+  mapTilesPromoted = 0;
+  mapCellsPromoted = 0;
+  if (meterPerPixel > mapResolution) {
+    DEBUG(F("Map warning: map too large for requested resolution="));
+    DEBUGLN(mapResolution);
+  }
+  DEBUG(F("map size="));
+  DEBUG(mapSizeX);
+  DEBUG(F("x"));
+  DEBUG(mapSizeY);
+  DEBUG(F(" resolution="));
+  DEBUG(meterPerPixel);
+  DEBUG(F(" signal resolution="));
+  DEBUG(meterPerPixel * (1 << mapSignalShift));
+  DEBUG(F(" tiles="));
+  DEBUGLN(mapTilesUsed);
+}
+
+// perimeter pixels of outline (meter): signal field (coarse cells with distance 0), wire=true: also obstacle layer
+// (stops flood fill)
+void MapClass::rasterizeOutline(bool wire) {
+  float meterPerPixel = 1.0 / mapScaleX;
   for (int i = 1; i < perimeterOutlineSize; i++) {
-    float wx = (outlineParticles[i].x - outlineParticles[i - 1].x);
-    float wy = (outlineParticles[i].y - outlineParticles[i - 1].y);
+    float wx = (perimeterOutline[i].x - perimeterOutline[i - 1].x);
+    float wy = (perimeterOutline[i].y - perimeterOutline[i - 1].y);
     int steps = max(1, max(((int)(fabs(wx) / meterPerPixel)), ((int)(fabs(wy) / meterPerPixel)))) * 2;
     float stepx = wx / ((float)steps);
     float stepy = wy / ((float)steps);
-    float x = outlineParticles[i - 1].x;
-    float y = outlineParticles[i - 1].y;
+    float x = perimeterOutline[i - 1].x;
+    float y = perimeterOutline[i - 1].y;
     for (int j = 0; j < steps; j++) {
-      map_data_t md = getMapDataMeter(x, y);
-      md.s.signal = MAP_DATA_SIGNAL_MAX;
-      md.s.side == MAP_DATA_SIDE_IN;
-      setMapDataMeter(x, y, md, 1);
+      int xp = ((int)(x * mapScaleX));
+      int yp = ((int)(y * mapScaleY));
+      if (isXYOnMap(xp, yp)) setWireCell(xp, mapSizeY - 1 - yp, wire);
       x += stepx;
       y += stepy;
     }
   }
-  DEBUGLN(F("resetMapData"));
-  //resetMapDataOutside(0, 0);
-  resetMapDataInside(MAP_SIZE_X * 0.3, MAP_SIZE_Y * 0.3); // set inside state, remaining is outside (FIXME: will not work if perimeter or outside at that pixel)
-  for (int y = 0; y < MAP_SIZE_Y; y++) {
-    for (int x = 0; x < MAP_SIZE_X; x++) {
-      map_data_t md = mapData[y][x];
-      if (md.s.signal == MAP_DATA_SIGNAL_MAX) { // for each perimeter pixel (inside/outside)
-        md.s.signal = 0;
-        mapData[y][x] = md;
-        resetMapDataSignal(x, y, MAP_DATA_SIGNAL_MAX); // start "painting" from here
+}
+
+// perimeter pixel (x=column, y=row)
+void MapClass::setWireCell(int x, int y, bool wire) {
+  if (wire) setMapBit(MAP_LAYER_OBSTACLE, x, y, true);
+  setSignalDist((y >> mapSignalShift) * mapSignalSizeX + (x >> mapSignalShift), 0);
+}
+
+void MapClass::setSignalDist(int idx, int dist) {
+  int shift = (idx & 1) << 2;
+  mapSignal[idx >> 1] = (mapSignal[idx >> 1] & ~(MAP_SIGNAL_DIST_MAX << shift)) | (dist << shift);
+}
+
+void MapClass::resetMapDataOutside(int x, int y) {
+  floodFill(x, y, MAP_DATA_SIDE_OUT);
+}
+
+void MapClass::resetMapDataInside(int x, int y) {
+  floodFill(x, y, MAP_DATA_SIDE_IN);
+}
+
+// signal strength of each cell: decreases by one per cell (city-block distance) from perimeter pixels (MAP_DATA_SIGNAL_MAX),
+// computed on the coarse signal field by a two-pass distance transform (forward pass: left/top neighbours, backward
+// pass: right/bottom neighbours) - a cell gets the signal of its coarse cell distance (see clearMap)
+void MapClass::resetMapDataSignal() {
+  for (int y = 0; y < mapSignalSizeY; y++) {
+    for (int x = 0; x < mapSignalSizeX; x++) {
+      int idx = y * mapSignalSizeX + x;
+      int dist = getSignalDist(idx);
+      if (dist == 0) continue; // perimeter pixels
+      if (x > 0) dist = min(dist, getSignalDist(idx - 1) + 1);
+      if (y > 0) dist = min(dist, getSignalDist(idx - mapSignalSizeX) + 1);
+      setSignalDist(idx, dist);
+    }
+  }
+  for (int y = mapSignalSizeY - 1; y >= 0; y--) {
+    for (int x = mapSignalSizeX - 1; x >= 0; x--) {
+      int idx = y * mapSignalSizeX + x;
+      int dist = getSignalDist(idx);
+      if (x < mapSignalSizeX - 1) dist = min(dist, getSignalDist(idx + 1) + 1);
+      if (y < mapSignalSizeY - 1) dist = min(dist, getSignalDist(idx + mapSignalSizeX) + 1);
+      setSignalDist(idx, dist);
+    }
+  }
+}
+
+// can cell be filled with given side? (perimeter pixels stop the fill)
+bool MapClass::isFillable(int x, int y, int side) {
+  if (!isXYOnMap(x, y)) return false;
+  return ((!getMapBit(MAP_LAYER_OBSTACLE, x, y)) && (getMapBit(MAP_LAYER_SIDE, x, y) != side));
+}
+
+// push fill seed at start of each fillable run of cell line x0,y0 - x1,y1 (a row or a column)
+void MapClass::pushFillSeeds(int x0, int y0, int x1, int y1, int side) {
+  bool inRun = false;
+  for (int y = y0; y <= y1; y++) {
+    for (int x = x0; x <= x1; x++) {
+      if (isFillable(x, y, side)) {
+        if (!inRun) pushFillSeed(x, y);
+        inRun = true;
+      } else inRun = false;
+    }
+  }
+}
+
+void MapClass::pushFillSeed(int x, int y) {
+  if (fillStackSize == MAP_FILL_STACK_SIZE) {
+    fillStackOverflow = true; // seed is recovered by rescan when stack is empty
+    return;
+  }
+  fillStack[fillStackSize].x = x;
+  fillStack[fillStackSize].y = y;
+  fillStackSize++;
+}
+
+// non-recursive scanline flood fill (4-connected) of side layer starting at cell x,y (x=column, y=row):
+// implicit tiles (side and obstacle layer) are filled as a whole, spans in allocated tiles are filled cell by cell,
+// the seed stack has fixed size - if it overflows, seeds are recovered by scanning the grid for
+// fillable cells next to already filled cells (map has been cleared before, so all cells of that side belong to the fill)
+void MapClass::floodFill(int x, int y, int side) {
+  fillStackSize = 0;
+  fillStackOverflow = false;
+  if (!isFillable(x, y, side)) return;
+  pushFillSeed(x, y);
+  while (fillStackSize > 0) {
+    fillStackSize--;
+    x = fillStack[fillStackSize].x;
+    y = fillStack[fillStackSize].y;
+    if (isFillable(x, y, side)) {
+      int tileIdx = (y >> MAP_TILE_BITS) * mapTilesX + (x >> MAP_TILE_BITS);
+      if (isUniformFillTile(tileIdx)) {
+        // implicit tile: all cells fillable and connected - fill complete tile, continue at tile border
+        mapLayers[MAP_LAYER_SIDE][tileIdx] = MAP_TILE_UNIFORM | side;
+        int x0 = x & ~MAP_TILE_MASK;
+        int y0 = y & ~MAP_TILE_MASK;
+        int x1 = min(mapSizeX, x0 + MAP_TILE_SIZE) - 1;
+        int y1 = min(mapSizeY, y0 + MAP_TILE_SIZE) - 1;
+        pushFillSeeds(x0, y0 - 1, x1, y0 - 1, side);
+        pushFillSeeds(x0, y1 + 1, x1, y1 + 1, side);
+        pushFillSeeds(x0 - 1, y0, x0 - 1, y1, side);
+        pushFillSeeds(x1 + 1, y0, x1 + 1, y1, side);
+      } else {
+        // allocated tile: extend span to the left and right (stop at implicit tiles, they are filled as a whole)
+        int x0 = x;
+        int x1 = x;
+        while ( isFillable(x0 - 1, y, side)
+                && (((x0 & MAP_TILE_MASK) != 0) || (!isUniformFillTile(tileIdx - 1))) ) {
+          x0--;
+          if ((x0 & MAP_TILE_MASK) == MAP_TILE_MASK) tileIdx--;
+        }
+        tileIdx = (y >> MAP_TILE_BITS) * mapTilesX + (x >> MAP_TILE_BITS);
+        while ( isFillable(x1 + 1, y, side)
+                && (((x1 & MAP_TILE_MASK) != MAP_TILE_MASK) || (!isUniformFillTile(tileIdx + 1))) ) {
+          x1++;
+          if ((x1 & MAP_TILE_MASK) == 0) tileIdx++;
+        }
+        if (isFillable(x0 - 1, y, side)) pushFillSeed(x0 - 1, y);
+        if (isFillable(x1 + 1, y, side)) pushFillSeed(x1 + 1, y);
+        for (int xx = x0; xx <= x1; xx++) {
+          if (!setMapBit(MAP_LAYER_SIDE, xx, y, side)) return; // tile pool exhausted
+        }
+        pushFillSeeds(x0, y - 1, x1, y - 1, side);
+        pushFillSeeds(x0, y + 1, x1, y + 1, side);
+      }
+    }
+    if ((fillStackSize == 0) && (fillStackOverflow)) {
+      // recover dropped seeds
+      fillStackOverflow = false;
+      for (int yy = 0; yy < mapSizeY; yy++) {
+        for (int xx = 0; xx < mapSizeX; xx++) {
+          if (!isFillable(xx, yy, side)) continue;
+          if (  isFilled(xx - 1, yy, side) || isFilled(xx + 1, yy, side)
+                || isFilled(xx, yy - 1, side) || isFilled(xx, yy + 1, side) ) pushFillSeed(xx, yy);
+        }
       }
     }
   }
 }
 
-void MapClass::resetMapDataOutside(int x, int y) {
-  if (!isXYOnMap(x, y)) return;
-  map_data_t md = mapData[y][x];
-  if (md.s.signal == MAP_DATA_SIGNAL_MAX) return; // hit perimeter
-  if (md.s.side == MAP_DATA_SIDE_OUT) return; // already outside
-  md.s.side = MAP_DATA_SIDE_OUT;
-  mapData[y][x] = md;
-  resetMapDataOutside(x - 1, y);
-  resetMapDataOutside(x + 1, y);
-  resetMapDataOutside(x, y - 1);
-  resetMapDataOutside(x, y + 1);
+// has cell been filled with given side? (no perimeter pixel)
+bool MapClass::isFilled(int x, int y, int side) {
+  if (!isXYOnMap(x, y)) return false;
+  return ((!getMapBit(MAP_LAYER_OBSTACLE, x, y)) && (getMapBit(MAP_LAYER_SIDE, x, y) == side));
 }
 
-void MapClass::resetMapDataInside(int x, int y) {
-  if (!isXYOnMap(x, y)) return;
-  map_data_t md = mapData[y][x];
-  if (md.s.signal == MAP_DATA_SIGNAL_MAX) return; // hit perimeter
-  if (md.s.side == MAP_DATA_SIDE_IN) return; // already visited
-  md.s.side = MAP_DATA_SIDE_IN;
-  md.s.state = MAP_DATA_STATE_UNMOWED;
-  mapData[y][x] = md;
-  resetMapDataInside(x - 1, y);
-  resetMapDataInside(x + 1, y);
-  resetMapDataInside(x, y - 1);
-  resetMapDataInside(x, y + 1);
+// tile without perimeter pixels and with all cells on same side (implicit tile of side and obstacle layer)
+bool MapClass::isUniformFillTile(int tileIdx) {
+  return ( (mapLayers[MAP_LAYER_SIDE][tileIdx] & MAP_TILE_UNIFORM)
+           && (mapLayers[MAP_LAYER_OBSTACLE][tileIdx] == MAP_TILE_UNIFORM) );
+}
+
+
+// set grid size and set all cells to given value (no tiles allocated), signal field: coarse cell size for grid size
+// and all cells far away from perimeter pixels
+void MapClass::clearMap(int sizeX, int sizeY, map_data_t value) {
+  mapSizeX = sizeX;
+  mapSizeY = sizeY;
+  mapTilesX = (sizeX + MAP_TILE_MASK) >> MAP_TILE_BITS;
+  mapTilesY = (sizeY + MAP_TILE_MASK) >> MAP_TILE_BITS;
+  for (int i = 0; i < mapTilesX * mapTilesY; i++) {
+    mapLayers[MAP_LAYER_SIDE][i] = MAP_TILE_UNIFORM | value.s.side;
+    mapLayers[MAP_LAYER_MOWED][i] = MAP_TILE_UNIFORM | (value.s.state == MAP_DATA_STATE_MOWED);
+    mapLayers[MAP_LAYER_OBSTACLE][i] = MAP_TILE_UNIFORM | (value.s.state == MAP_DATA_STATE_OBSTACLE);
+  }
+  mapTilesUsed = 0;
+  mapTileOverflow = 0;
+  mapTileWrites = 0;
+  mapSignalShift = 1;
+  while (((sizeX + (1 << mapSignalShift) - 1) >> mapSignalShift) * ((sizeY + (1 << mapSignalShift) - 1) >> mapSignalShift)
+         > MAP_SIGNAL_CELLS_MAX) mapSignalShift++;
+  mapSignalSizeX = (sizeX + (1 << mapSignalShift) - 1) >> mapSignalShift;
+  mapSignalSizeY = (sizeY + (1 << mapSignalShift) - 1) >> mapSignalShift;
+  memset(mapSignal, (MAP_SIGNAL_DIST_MAX << 4) | MAP_SIGNAL_DIST_MAX, (mapSignalSizeX * mapSignalSizeY + 1) / 2);
+  for (int dist = 0; dist <= MAP_SIGNAL_DIST_MAX; dist++) {
+    mapSignalLevels[dist] = max(0, MAP_DATA_SIGNAL_MAX - (dist << mapSignalShift)); // saturated: lower bound of distance
+  }
+}
+
+// release all tiles of layer (all bits zero)
+void MapClass::clearMapLayer(int layer) {
+  int i = 0;
+  while (i < mapTilesUsed) {
+    if ((mapTileOwner[i] >> MAP_TILE_OWNER_SHIFT) == layer) releaseMapTile(i, 0);
+      else i++;
+  }
+  for (int i = 0; i < mapTilesX * mapTilesY; i++) mapLayers[layer][i] = MAP_TILE_UNIFORM;
 }
 
-void MapClass::resetMapDataSignal(int x, int y, int signalStrength) {
-  if (!isXYOnMap(x, y)) return;
-  map_data_t md = mapData[y][x];
-  if (md.s.signal >= signalStrength) return; // signal already higher or equal (visited)
-  md.s.signal =  signalStrength;
-  mapData[y][x] = md;
-  int strength = max(0, signalStrength - 1);
-  resetMapDataSignal(x - 1, y, strength);
-  resetMapDataSignal(x + 1, y, strength);
-  resetMapDataSignal(x, y - 1, strength);
-  resetMapDataSignal(x, y + 1, strength);
+// allocate tile of layer from tile pool (and initialize all tile bits with implicit tile value) - if the pool is
+// exhausted, tiles that have become uniform are released and a mowed tile may be promoted
+bool MapClass::allocMapTile(int layer, int tileIdx) {
+  if (mapTilesUsed == MAP_TILE_POOL_SIZE) {
+    if (mapTileWrites >= MAP_TILE_CELLS) compactMapTiles();
+    if (mapTilesUsed == MAP_TILE_POOL_SIZE) promoteMowedTile();
+    if (mapTilesUsed == MAP_TILE_POOL_SIZE) {
+      mapTileOverflow++;
+      return false;
+    }
+  }
+  uint16_t value = (mapLayers[layer][tileIdx] & 1) ? 0xFFFF : 0;
+  for (int y = 0; y < MAP_TILE_SIZE; y++) mapTilePool[mapTilesUsed][y] = value;
+  mapTileOwner[mapTilesUsed] = (layer << MAP_TILE_OWNER_SHIFT) | tileIdx;
+  mapLayers[layer][tileIdx] = mapTilesUsed;
+  mapTilesUsed++;
+  return true;
 }
 
+// release allocated tile i (store it implicitly with bit value), the last tile of pool is moved into released slot
+void MapClass::releaseMapTile(int i, int value) {
+  mapLayers[mapTileOwner[i] >> MAP_TILE_OWNER_SHIFT][mapTileOwner[i] & ((1 << MAP_TILE_OWNER_SHIFT) - 1)] = MAP_TILE_UNIFORM | value;
+  mapTilesUsed--;
+  if (i == mapTilesUsed) return;
+  memcpy(mapTilePool[i], mapTilePool[mapTilesUsed], sizeof mapTilePool[0]);
+  mapTileOwner[i] = mapTileOwner[mapTilesUsed];
+  mapLayers[mapTileOwner[i] >> MAP_TILE_OWNER_SHIFT][mapTileOwner[i] & ((1 << MAP_TILE_OWNER_SHIFT) - 1)] = i;
+}
+
+// bit value of allocated tile i if all its cells have same bit (mowed layer: outside cells are don't care), 
+// otherwise -1
+int MapClass::uniformMapTile(int i) {
+  int layer = mapTileOwner[i] >> MAP_TILE_OWNER_SHIFT;
+  int tileIdx = mapTileOwner[i] & ((1 << MAP_TILE_OWNER_SHIFT) - 1);
+  bool zeros = true;
+  bool ones = true;
+  for (int y = 0; y < MAP_TILE_SIZE; y++) {
+    uint16_t care = (layer == MAP_LAYER_MOWED) ? ~getMapRow(MAP_LAYER_SIDE, tileIdx, y) : 0xFFFF;
+    uint16_t bits = mapTilePool[i][y] & care;
+    if (bits != 0) zeros = false;
+    if (bits != care) ones = false;
+  }
+  if (zeros) return 0;
+  if (ones) return 1;
+  return -1;
+}
+
+// release all allocated tiles with all cells of same bit (store them implicitly),
+// returns number of released tiles
+int MapClass::compactMapTiles() {
+  int released = 0;
+  int i = 0;
+  while (i < mapTilesUsed) {
+    int value = uniformMapTile(i);
+    if (value >= 0) {
+      releaseMapTile(i, value);
+      released++;
+    } else i++;
+  }
+  mapTileWrites = 0;
+  return released;
+}
+
+// tile pool exhausted (obstacle layer exceeds MAP_TILE_RESERVE): the mowed tile with fewest unmowed inside cells
+// becomes completely mowed (lossy, the unmowed cells are kept in mapCellsPromoted and are not counted by coverage)
+// - returns false if there is no mowed tile
+bool MapClass::promoteMowedTile() {
+  int best = -1;
+  int bestCells = MAP_TILE_CELLS + 1;
+  for (int i = 0; i < mapTilesUsed; i++) {
+    if ((mapTileOwner[i] >> MAP_TILE_OWNER_SHIFT) != MAP_LAYER_MOWED) continue;
+    int tileIdx = mapTileOwner[i] & ((1 << MAP_TILE_OWNER_SHIFT) - 1);
+    int cells = 0;
+    for (int y = 0; y < MAP_TILE_SIZE; y++) {
+      cells += __builtin_popcount((uint16_t)~( getMapRow(MAP_LAYER_SIDE, tileIdx, y) | getMapRow(MAP_LAYER_OBSTACLE, tileIdx, y)
+                                               | mapTilePool[i][y] ));
+    }
+    if (cells < bestCells) {
+      best = i;
+      bestCells = cells;
+    }
+  }
+  if (best < 0) return false;
+  if (mapTilesPromoted == 0) DEBUGLN(F("Map warning: tile pool exhausted, promoting mowed tiles"));
+  releaseMapTile(best, 1);
+  mapTilesPromoted++;
+  mapCellsPromoted += bestCells;
+  mapCellsMowed += bestCells;
+  return true;
+}
+
+// set bit of layer (x=column, y=row) - returns false if tile pool is exhausted
+bool MapClass::setMapBit(int layer, int x, int y, bool value) {
+  int tileIdx = (y >> MAP_TILE_BITS) * mapTilesX + (x >> MAP_TILE_BITS);
+  uint16_t tile = mapLayers[layer][tileIdx];
+  if (tile & MAP_TILE_UNIFORM) {
+    if ((tile & 1) == value) return true; // implicit tile already has this value
+    if (!allocMapTile(layer, tileIdx)) return false;
+    tile = mapLayers[layer][tileIdx];
+  }
+  if (value) mapTilePool[tile][y & MAP_TILE_MASK] |= (1 << (x & MAP_TILE_MASK));
+    else mapTilePool[tile][y & MAP_TILE_MASK] &= ~(1 << (x & MAP_TILE_MASK));
+  mapTileWrites++;
+  return true;
+}
+
+// set grid cell (x=column, y=row): side and state (signal is computed from outline) - returns false if tile pool 
+// is exhausted
+bool MapClass::setMapCell(int x, int y, map_data_t value) {
+  bool res = setMapBit(MAP_LAYER_SIDE, x, y, value.s.side);
+  res = setMapBit(MAP_LAYER_OBSTACLE, x, y, (value.s.state == MAP_DATA_STATE_OBSTACLE)) && res;
+  if ((value.s.side == MAP_DATA_SIDE_IN) && (value.s.state != MAP_DATA_STATE_OBSTACLE)) {
+    res = setMapBit(MAP_LAYER_MOWED, x, y, (value.s.state == MAP_DATA_STATE_MOWED)) && res;
+  }
+  return res;
+}
+
+// all cells within city-block distance radius of cell (x=column, y=row) are inside perimeter (cells off map are 
+// ignored) - the inside area is bounded by perimeter pixels, so this is true if the cell is inside and more than 
+// radius cells away from perimeter pixels
+bool MapClass::isInside(int x, int y, int radius) {
+  for (int dy = -radius; dy <= radius; dy++) {
+    int r = radius - abs(dy);
+    for (int dx = -r; dx <= r; dx++) {
+      if (!isXYOnMap(x + dx, y + dy)) continue;
+      if (getMapBit(MAP_LAYER_SIDE, x + dx, y + dy) != MAP_DATA_SIDE_IN) return false;
+    }
+  }
+  return true;
+}
 
 void MapClass::setMapData(int xp, int yp, map_data_t value) {
-  if ((xp >= MAP_SIZE_X) || (xp < 0)) return;
-  if ((yp >= MAP_SIZE_Y) || (yp < 0)) return;
-  mapData[MAP_SIZE_Y - 1 - yp][xp] = value;
+  if ((xp >= mapSizeX) || (xp < 0)) return;
+  if ((yp >= mapSizeY) || (yp < 0)) return;
+  setMapCell(xp, mapSizeY - 1 - yp, value);
 }
 
 bool MapClass::isXYOnMap(int x, int y) {
-  if ((x >= MAP_SIZE_X) || (x < 0)) return false;
-  if ((y >= MAP_SIZE_Y) || (y < 0)) return false;
+  if ((x >= mapSizeX) || (x < 0)) return false;
+  if ((y >= mapSizeY) || (y < 0)) return false;
   return true;
 }
 
@@ -376,166 +1142,726 @@ void MapClass::setMapDataMeter(float x, float y, map_data_t value, int thickness
   }
 }
 
-float MapClass::distanceToParticles(float x, float y) {
-  float res = 99999;
-  for (int i = 0; i < OUTLINE_PARTICLES; i++) {
-    float dist = sqrt( sq(x - outlineParticles[i].x) + sq(y - outlineParticles[i].y) );
-    res = min(res, dist);
-  }
-  return res;
-}
-
 void MapClass::distributeParticlesOutline() {
   float x;
   float y;
   DEBUGLN(F("distributeParticlesOutline"));
   if (!mapValid) return;
   //if (perimeterOutlineSize == 0) return;
-  float minDist = ((float)perimeterWireLengthMeter) / ((float)OUTLINE_PARTICLES) * 0.7;
-  for (int i = 0; i < OUTLINE_PARTICLES; i++) {
+  filter.setSize(filter.capacity()); // pose unknown: all particles
+  for (int i = 0; i < filter.size(); i++) {
     while (true) {
-      x = ((float)rand()) / ((float)RAND_MAX) * ((float)MAP_SIZE_X) / mapScaleX;
-      y = ((float)rand()) / ((float)RAND_MAX) * ((float)MAP_SIZE_Y) / mapScaleY;
+      x = ((float)rand()) / ((float)RAND_MAX) * ((float)mapSizeX) / mapScaleX;
+      y = ((float)rand()) / ((float)RAND_MAX) * ((float)mapSizeY) / mapScaleY;
       map_data_t md = getMapDataMeter(x, y);
       /*DEBUG(x);
         DEBUG(F(","));
         DEBUG(y);
         DEBUG(F(","));
         DEBUGLN(md.s.signal);      */
-      if ( (md.s.signal == MAP_DATA_SIGNAL_MAX)
-           //&& (distanceToParticles(x,y) > minDist)
-         ) break;
+      if (md.s.signal == MAP_DATA_SIGNAL_MAX) break;
     }
-    outlineParticles[i].x = x;
-    outlineParticles[i].y = y;
-    //particles[i].orientation = robotState.orientation;
-    //particles[i].orientation += gauss(0.0, STEERING_NOISE);
+    filter.x[i] = toCoord(x);
+    filter.y[i] = toCoord(y);
+    filter.theta[i] = fastGaussRandom() * MAP_HEADING_BIAS_INIT; // heading offset unknown (gyro drift)
   }
+  filter.resetWeights();
 }
 
 bool MapClass::isXYOnMapMeter(float x, float y) {
   int xp = ((int)(x * mapScaleX));
   int yp = ((int)(y * mapScaleY));
-  if ((xp >= MAP_SIZE_X) || (xp < 0)) return false;
-  if ((yp >= MAP_SIZE_Y) || (yp < 0)) return false;
+  if ((xp >= mapSizeX) || (xp < 0)) return false;
+  if ((yp >= mapSizeY) || (yp < 0)) return false;
   return true;
 }
 
+// set map scale (meter to pixel) and fixed-point scale (coordinate unit to pixel, 16 fractional bits)
+void MapClass::setMapScale(float scaleX, float scaleY) {
+  mapScaleX = scaleX;
+  mapScaleY = scaleY;
+  coordScaleX = (int32_t)(scaleX * (65536.0 / COORD_ONE) + 0.5);
+  coordScaleY = (int32_t)(scaleY * (65536.0 / COORD_ONE) + 0.5);
+}
+
 map_data_t MapClass::getMapDataMeter(float x, float y) {
   map_data_t md;
+  md.v = 0;
   md.s.side = MAP_DATA_SIDE_OUT;
   int xp = ((int)(x * mapScaleX));
   int yp = ((int)(y * mapScaleY));
-  if ((xp >= MAP_SIZE_X) || (xp < 0)) return md;
-  if ((yp >= MAP_SIZE_Y) || (yp < 0)) return md;
-  return mapData[MAP_SIZE_Y - 1 - yp][xp];
+  if ((xp >= mapSizeX) || (xp < 0)) return md;
+  if ((yp >= mapSizeY) || (yp < 0)) return md;
+  return getMapCell(xp, mapSizeY - 1 - yp);
 }
 
 //  computes the probability of a particle
-float MapClass::measurementProb(int particleIdx, float leftMag, float rightMag) {
-  // calculate Gaussian
-  // gaussian(mu, sigma, x)
-  //prob = gaussian(sim.world.getBfield(x, y), measurement_noise, measurement);
-  float prob = 1.0;
-  robot_state_t particle = outlineParticles[particleIdx];
-  if (!isXYOnMapMeter(particle.x, particle.y)) return 0;
-  map_data_t md = getMapDataMeter(particle.x, particle.y);
-  //float strength = 1.0 / ((float)(32-md.s.signal));
-  if ((Robot.state == STAT_CREATE_MAP) || (Robot.state == STAT_TRACK)) {
-    // tracking perimeter
-    //prob = gaussian(strength, measurementNoise, 1.0);
-    if (md.s.signal < MAP_DATA_SIGNAL_MAX - 1) return 0;
-    //return ((float)md.s.signal) / ((float)MAP_DATA_SIGNAL_MAX);
-  } else {
-    // mowing
-    if (md.s.side == MAP_DATA_SIDE_OUT) {
-      if ((leftMag < 0) && (rightMag < 0)) return 0;
-    } else {
-      if ((leftMag > 0) && (rightMag > 0)) return 0;
-      //  prob = gaussian(strength*700, measurementNoise, measurement);
+// quantize perimeter magnitude: sign (inside: negative) and level of normalized magnitude (0..1)
+static int likelihoodBin(float mag) {
+  int level = ((int)(fabs(mag) * MAP_LIKELIHOOD_LEVELS / MAP_LIKELIHOOD_MAG_MAX));
+  level = min(level, MAP_LIKELIHOOD_LEVELS - 1);
+  if (mag < 0) return level;
+  return MAP_LIKELIHOOD_LEVELS + level;
+}
+
+// particle filter noise parameters and max. active particles (value <= 0: default) - e.g. for parameter sweeps
+// on log replay, robot must be idle
+void MapClass::setFilterSettings(float steering, float distance, float measurement, int particles) {
+  if (Robot.state != STAT_IDLE) return;
+  steeringNoise = (steering > 0) ? steering : MAP_STEERING_NOISE;
+  distanceNoise = (distance > 0) ? distance : MAP_DISTANCE_NOISE;
+  measurementNoise = (measurement > 0) ? measurement : MAP_MEASUREMENT_NOISE;
+  filter.maxSize = (particles > 0) ? constrain(particles, filter.minSize, filter.capacity()) : filter.capacity();
+  if (filter.size() > filter.maxSize) filter.setSize(filter.maxSize);
+  buildLikelihoodField();
+}
+
+// build likelihood field (call after map or measurementNoise changes): the probability of a quantized 
+// magnitude reading only depends on cell side and signal (distance to perimeter wire), so one table row 
+// per reading covers all cells - expected normalized magnitude drops with distance to wire, measured
+// magnitude level is gaussian (measurementNoise) around expected magnitude, sign may be wrong near wire
+void MapClass::buildLikelihoodField() {
+  float cellSize = (mapScaleX > 0) ? 1.0 / mapScaleX : mapResolution;
+  float coilProb[MAP_LIKELIHOOD_CLASSES][MAP_LIKELIHOOD_BINS];
+  float maxProb = 0;
+  for (int c = 0; c < MAP_LIKELIHOOD_CLASSES; c++) {
+    int side = c >> 5;
+    int signal = c & MAP_DATA_SIGNAL_MAX;
+    float dist = ((float)(MAP_DATA_SIGNAL_MAX - signal)) * cellSize;
+    float expected = 1.0 / (1.0 + dist / MAP_LIKELIHOOD_FALLOFF);
+    likelihoodExpected[c] = (side == MAP_DATA_SIDE_IN) ? -expected : expected;
+    // sign: coils may be on both sides of wire near perimeter
+    float signProb = (signal >= MAP_DATA_SIGNAL_MAX - 1) ? 0.5 : 1.0 - MAP_LIKELIHOOD_SIGN_ERROR;
+    float levelProb[MAP_LIKELIHOOD_LEVELS];
+    float levelSum = 0;
+    for (int l = 0; l < MAP_LIKELIHOOD_LEVELS; l++) {
+      float d = (((float)l) + 0.5) / MAP_LIKELIHOOD_LEVELS - expected;
+      levelProb[l] = exp(-d * d / (2 * measurementNoise * measurementNoise));
+      levelSum += levelProb[l];
+    }
+    for (int l = 0; l < MAP_LIKELIHOOD_LEVELS; l++) {
+      float p = (1.0 - MAP_LIKELIHOOD_OUTLIER) * levelProb[l] / levelSum + MAP_LIKELIHOOD_OUTLIER / MAP_LIKELIHOOD_LEVELS;
+      coilProb[c][l] = p * ((side == MAP_DATA_SIDE_IN) ? signProb : 1.0 - signProb);
+      coilProb[c][MAP_LIKELIHOOD_LEVELS + l] = p * ((side == MAP_DATA_SIDE_IN) ? 1.0 - signProb : signProb);
+      maxProb = max(maxProb, max(coilProb[c][l], coilProb[c][MAP_LIKELIHOOD_LEVELS + l]));
+    }
+    // tracking perimeter: cell must be close to perimeter wire (gaussian, sigma one cell)
+    float trackDist = MAP_DATA_SIGNAL_MAX - signal;
+    likelihoodTrack[c] = max(1, (int)(255 * exp(-trackDist * trackDist / 2)));
+  }
+  // reading probability (left and right coil): scaled to 1..255
+  float scale = 255.0 / (maxProb * maxProb);
+  for (int left = 0; left < MAP_LIKELIHOOD_BINS; left++) {
+    for (int right = 0; right < MAP_LIKELIHOOD_BINS; right++) {
+      for (int c = 0; c < MAP_LIKELIHOOD_CLASSES; c++) {
+        int p = (int)(coilProb[c][left] * coilProb[c][right] * scale + 0.5);
+        likelihoodField[left * MAP_LIKELIHOOD_BINS + right][c] = constrain(p, 1, 255);
+      }
     }
   }
-  return prob;
 }
 
-// sensing and resampling
+// select likelihood field row of a perimeter reading (for robot state of current filter update)
+void MapClass::setMeasurement(float leftMag, float rightMag) {
+  uint8_t *probs = likelihoodTrack;
+  if ((filterRobotState != STAT_CREATE_MAP) && (filterRobotState != STAT_TRACK)) {
+    probs = likelihoodField[likelihoodBin(leftMag) * MAP_LIKELIHOOD_BINS + likelihoodBin(rightMag)];
+  }
+  for (int c = 0; c < MAP_LIKELIHOOD_CLASSES; c++) measurementProbs[c] = ((float)probs[c]) / 255.0;
+  learnedActive = (probs != likelihoodTrack) && (magField.cells > 0);
+  measLeftMag = leftMag / MAP_LIKELIHOOD_MAG_MAX;
+  measRightMag = rightMag / MAP_LIKELIHOOD_MAG_MAX;
+}
+
+// probability of current measurement in learned cell: gaussian around learned mean of both coils (variance is 
+// learned variance plus min. noise), scaled to 1 at learned mean like the likelihood field - returns -1 if the 
+// likelihood field should be used: learned cell is less certain (e.g. cell on perimeter wire) or learned mean
+// matches expected magnitude of map cell (likelihood field has finer cells)
+float MapClass::learnedProb(int idx, float expected) {
+  float varL = magField.variance(idx, 0) + MAP_LEARN_NOISE_MIN * MAP_LEARN_NOISE_MIN;
+  float varR = magField.variance(idx, 1) + MAP_LEARN_NOISE_MIN * MAP_LEARN_NOISE_MIN;
+  float varMax = sq(measurementNoise);
+  if ((varL > varMax) || (varR > varMax)) return -1;
+  float meanL = magField.mean(idx, 0);
+  float meanR = magField.mean(idx, 1);
+  if ( (sq(meanL - expected) < varL) && (sq(meanR - expected) < varR) ) return -1;
+  float dL = measLeftMag - meanL;
+  float dR = measRightMag - meanR;
+  float g = exp(-dL * dL / (2 * varL) - dR * dR / (2 * varR));
+  return (1.0 - MAP_LIKELIHOOD_OUTLIER) * g + MAP_LIKELIHOOD_OUTLIER;
+}
+
+float MapClass::measurementProb(float x, float y, float leftMag, float rightMag) {
+  setMeasurement(leftMag, rightMag);
+  return measurementProb(x, y);
+}
+
+// sensing and resampling: weight particles with measurement probability, resample (low-variance) if
+// effective sample size is too low
 // http://www.mrpt.org/tutorials/programming/statistics-and-bayes-filtering/resampling_schemes/
 void MapClass::sense(float leftMag, float rightMag) {
-  overallProb = 0;
-  for (int i = 0; i < OUTLINE_PARTICLES; i++) {
-    float measurement_prob1 = measurementProb(i, leftMag, rightMag);
-    overallProb += measurement_prob1 / ((float)OUTLINE_PARTICLES);
-    int idx = rand() % OUTLINE_PARTICLES;
-    float measurement_prob2 = measurementProb(idx, leftMag, rightMag);
-    //float rnd = ((float)rand())/((float)RAND_MAX);
-    if (measurement_prob1 > measurement_prob2) {
-      //if (rnd > 0.5)
-      outlineParticles[idx] = outlineParticles[i];
-    }
-    else if (measurement_prob2 >  measurement_prob1) {
-      //if (rnd > 0.5)
-      outlineParticles[i] = outlineParticles[idx];
-    }
+  setMeasurement(leftMag, rightMag);
+  weightParticles(0, filter.size());
+  overallProb = filter.normalize();
+  filter.resample(fastRandomFloat());
+}
+
+void MapClass::weightParticles(int startIdx, int endIdx) {
+  for (int i = startIdx; i < endIdx; i++) {
+    filter.weights[i] *= measurementProb(filter.x[i], filter.y[i]);
   }
-  /*std::vector<float>w;
-    for (int i=0; i < PARTICLES; i++){
-    float measurement_prob = measurementProb(i, measurement);
-    w.push_back(measurement_prob);
-    }
-    // resampling
-    std::vector<robot_state_t>newParticles;
-    int index = floor( ((float)rand())/((float)RAND_MAX) * PARTICLES);
-    float beta = 0.0;
-    float mw = *std::max_element(w.begin(), w.end());
-    for (int i=0; i < PARTICLES; i++){
-    //beta += random() * 2.0 * mw;
-    beta += 1.0 * mw;
-    while (beta > w[index]){
-      beta -= w[index];
-      index = (index + 1) % PARTICLES;
-    }
-    newParticles.push_back(particles[index]);
-    }
-    particles = newParticles;*/
 }
 
 
-void MapClass::loadSaveMap(boolean readflag) {
-  int addr = ADDR;
-  short magic = MAGIC;
-  DEBUG(F("Map EEPROM addr="));
-  DEBUG(ADDR);
-  eereadwrite(readflag, addr, magic); // magic
-  eereadwrite(readflag, addr, mapScaleX);
-  eereadwrite(readflag, addr, mapScaleY);
-  for (int y = 0; y < MAP_SIZE_Y; y++) {
-    for (int x = 0; x < MAP_SIZE_X; x++) {
-      eereadwrite(readflag, addr, Map.mapData[y][x]);
-    }
+// zone data checksum (Fletcher-32 over bytes, continued from sum)
+static uint32_t zoneChecksum(uint32_t sum, const byte *data, int size) {
+  uint32_t a = sum & 0xFFFF;
+  uint32_t b = sum >> 16;
+  for (int i = 0; i < size; i++) {
+    a = (a + data[i]) % 65535;
+    b = (b + a) % 65535;
+  }
+  return (b << 16) | a;
+}
+
+// write block to flash (address 4-byte aligned), only flash pages that differ are written - returns written pages
+static int writeZoneBlock(uint32_t addr, const byte *data, int size) {
+  int pages = 0;
+  for (int i = 0; i < size; i += ZONE_PAGE_SIZE) {
+    int n = min(ZONE_PAGE_SIZE, size - i);
+    if (memcmp(Flash.readAddress(addr + i), data + i, n) == 0) continue;
+    Flash.write(addr + i, (byte*)(data + i), n);
+    pages++;
+  }
+  return pages;
+}
+
+// read zone index from flash (no valid index: all zones empty)
+void MapClass::loadZoneIndex() {
+  map_zone_index_t index;
+  memcpy(&index, Flash.readAddress(ADDR), sizeof index);
+  if (index.magic != MAGIC) {
+    DEBUGLN(F("Map: no zone index"));
+    memset(&index, 0, sizeof index);
+  }
+  activeZone = ((index.activeZone >= 0) && (index.activeZone < MAP_ZONES_MAX)) ? index.activeZone : 0;
+  memcpy(zones, index.zones, sizeof zones);
+}
+
+void MapClass::saveZoneIndex() {
+  map_zone_index_t index;
+  memset(&index, 0, sizeof index);
+  index.magic = MAGIC;
+  index.activeZone = activeZone;
+  memcpy(index.zones, zones, sizeof zones);
+  writeZoneBlock(ADDR, (byte*)&index, sizeof index);
+}
+
+// select zone (persistent) and load its map
+boolean MapClass::selectZone(int zone) {
+  if ((Robot.state != STAT_IDLE) || (zone < 0) || (zone >= MAP_ZONES_MAX)) return false;
+  if (zone != activeZone) {
+    activeZone = zone;
+    saveZoneIndex();
   }
-  DEBUG(F(" endaddr="));
-  DEBUGLN(addr);
+  clearOutline();
+  mapValid = loadMap();
+  if (mapValid) distributeParticlesOutline();
+  return mapValid;
 }
 
+// delete zone (robot must be idle)
+boolean MapClass::deleteZone(int zone) {
+  if ((Robot.state != STAT_IDLE) || (zone < 0) || (zone >= MAP_ZONES_MAX)) return false;
+  memset(&zones[zone], 0, sizeof zones[zone]);
+  saveZoneIndex();
+  if (zone == activeZone) mapValid = false;
+  return true;
+}
+
+// load map of active zone: the zone index holds grid size, scale and checksum, the zone data (tile directories,
+// outline, tile pool) is block copied from its flash slot, the signal field is computed from the outline
 boolean MapClass::loadMap() {
-  short magic = 0;
-  int addr = ADDR;
-  eeread(addr, magic);
-  if (magic != MAGIC) {
+  unsigned long startTime = micros();
+  map_zone_t &z = zones[activeZone];
+  if (z.sizeX == 0) {
     DEBUGLN(F("Map error: no map"));
     return false;
   }
-  DEBUGLN(F("Map: found map"));
-  loadSaveMap(true);
+  if ( (z.sizeX < 0) || (z.sizeY <= 0) || (z.tilesUsed < 0) || (z.tilesUsed > MAP_TILE_POOL_SIZE)
+       || (z.outlineSize < 0) || (z.outlineSize > OUTLINE_SIZE)
+       || (((z.sizeX + MAP_TILE_MASK) >> MAP_TILE_BITS) * ((z.sizeY + MAP_TILE_MASK) >> MAP_TILE_BITS) > MAP_TILES_MAX) ) {
+    DEBUGLN(F("Map error: invalid map size"));
+    return false;
+  }
+  uint32_t addr = ZONE_ADDR + activeZone * ZONE_SLOT_SIZE;
+  int dirSize = ((z.sizeX + MAP_TILE_MASK) >> MAP_TILE_BITS) * ((z.sizeY + MAP_TILE_MASK) >> MAP_TILE_BITS) * sizeof mapLayers[0][0];
+  int outlineSize = z.outlineSize * sizeof perimeterOutline[0];
+  int poolSize = z.tilesUsed * sizeof mapTilePool[0];
+  uint32_t sum = 0;
+  for (int layer = 0; layer < MAP_LAYERS; layer++) {
+    sum = zoneChecksum(sum, Flash.readAddress(addr + ZONE_DIR + layer * ZONE_DIR_SIZE), dirSize);
+  }
+  sum = zoneChecksum(sum, Flash.readAddress(addr + ZONE_OUTLINE), outlineSize);
+  sum = zoneChecksum(sum, Flash.readAddress(addr + ZONE_POOL), poolSize);
+  if (sum != z.checksum) {
+    DEBUGLN(F("Map error: checksum"));
+    return false;
+  }
+  map_data_t md;
+  md.v = 0;
+  clearMap(z.sizeX, z.sizeY, md);
+  setMapScale(z.scaleX, z.scaleY);
+  mapTilesUsed = z.tilesUsed;
+  for (int layer = 0; layer < MAP_LAYERS; layer++) {
+    memcpy(mapLayers[layer], Flash.readAddress(addr + ZONE_DIR + layer * ZONE_DIR_SIZE), dirSize);
+    for (int i = 0; i < mapTilesX * mapTilesY; i++) {
+      if ((mapLayers[layer][i] & MAP_TILE_UNIFORM) == 0) mapTileOwner[mapLayers[layer][i]] = (layer << MAP_TILE_OWNER_SHIFT) | i;
+    }
+  }
+  memcpy(perimeterOutline, Flash.readAddress(addr + ZONE_OUTLINE), outlineSize);
+  memcpy(mapTilePool, Flash.readAddress(addr + ZONE_POOL), poolSize);
+  perimeterOutlineSize = z.outlineSize;
+  rasterizeOutline(false);
+  resetMapDataSignal();
+  buildLikelihoodField();
+  countMapCells();
+  magField.clear();
+  occupancy.clear();
+  mowingTime = z.mowingTime;
+  mapTilesPromoted = 0;
+  mapCellsPromoted = 0;
   mapValid = true;
+  DEBUG(F("Map: loaded zone "));
+  DEBUG(activeZone);
+  DEBUG(F(" "));
+  DEBUG(z.name);
+  DEBUG(F(" grid="));
+  DEBUG(mapSizeX);
+  DEBUG(F("x"));
+  DEBUG(mapSizeY);
+  DEBUG(F(" tiles="));
+  DEBUG(mapTilesUsed);
+  DEBUG(F(" coverage="));
+  DEBUG(coverage());
+  DEBUG(F(" time(us)="));
+  DEBUGLN(micros() - startTime);
   return true;
 }
 
+// save map (grid layers including mowed state, outline, scale) to zone (name=NULL: keep name) and select zone,
+// only changed flash pages are written (e.g. mowed tiles) - robot must be idle or docked (no flash writes while moving)
+boolean MapClass::saveZone(int zone, const char *name) {
+  if ((Robot.state != STAT_IDLE) && (Robot.state != STAT_CHG)) return false;
+  if ((zone < 0) || (zone >= MAP_ZONES_MAX)) return false;
+  unsigned long startTime = millis();
+  map_zone_t &z = zones[zone];
+  if (name != NULL) {
+    strncpy(z.name, name, MAP_ZONE_NAME_SIZE - 1);
+    z.name[MAP_ZONE_NAME_SIZE - 1] = 0;
+  } else if (z.sizeX == 0) {
+    strcpy(z.name, "zone0");
+    z.name[4] += zone;
+  }
+  uint32_t addr = ZONE_ADDR + zone * ZONE_SLOT_SIZE;
+  int dirSize = mapTilesX * mapTilesY * sizeof mapLayers[0][0];
+  int outlineSize = perimeterOutlineSize * sizeof perimeterOutline[0];
+  int poolSize = mapTilesUsed * sizeof mapTilePool[0];
+  int pages = 0;
+  uint32_t sum = 0;
+  for (int layer = 0; layer < MAP_LAYERS; layer++) {
+    pages += writeZoneBlock(addr + ZONE_DIR + layer * ZONE_DIR_SIZE, (byte*)mapLayers[layer], dirSize);
+    sum = zoneChecksum(sum, (byte*)mapLayers[layer], dirSize);
+  }
+  pages += writeZoneBlock(addr + ZONE_OUTLINE, (byte*)perimeterOutline, outlineSize);
+  pages += writeZoneBlock(addr + ZONE_POOL, (byte*)mapTilePool, poolSize);
+  z.scaleX = mapScaleX;
+  z.scaleY = mapScaleY;
+  z.sizeX = mapSizeX;
+  z.sizeY = mapSizeY;
+  z.tilesUsed = mapTilesUsed;
+  z.outlineSize = perimeterOutlineSize;
+  z.mowingTime = mowingTime;
+  sum = zoneChecksum(sum, (byte*)perimeterOutline, outlineSize);
+  z.checksum = zoneChecksum(sum, (byte*)mapTilePool, poolSize);
+  activeZone = zone;
+  saveZoneIndex();
+  DEBUG(F("Map: saved zone "));
+  DEBUG(zone);
+  DEBUG(F(" "));
+  DEBUG(z.name);
+  DEBUG(F(" pages="));
+  DEBUG(pages);
+  DEBUG(F(" time(ms)="));
+  DEBUGLN(millis() - startTime);
+  return true;
+}
 
 void MapClass::saveMap() {
   DEBUGLN(F("saveMap"));
-  loadSaveMap(false);
   mapValid = true;
+  saveZone(activeZone, NULL);
+}
+
+// save mowed state (mowed layer, counters) to flash, e.g. before a simulation resets mowed cells
+// (only changed flash pages are written)
+boolean MapClass::saveMowed() {
+  if (!mapValid) return false;
+  map_mowed_t m;
+  m.sizeX = mapSizeX;
+  m.sizeY = mapSizeY;
+  m.tiles = 0;
+  m.tilesPromoted = mapTilesPromoted;
+  m.cellsPromoted = mapCellsPromoted;
+  m.mowingTime = mowingTime;
+  // tiles are collected into flash pages (ZONE_PAGE_SIZE / 32 tiles per page)
+  uint16_t page[ZONE_PAGE_SIZE / sizeof mapTilePool[0]][MAP_TILE_SIZE];
+  int perPage = ZONE_PAGE_SIZE / sizeof mapTilePool[0];
+  int tileCount = mapTilesX * mapTilesY;
+  for (int i = 0; i < tileCount; i++) {
+    uint16_t tile = mapLayers[MAP_LAYER_MOWED][i];
+    if (tile & MAP_TILE_UNIFORM) continue;
+    memcpy(page[m.tiles % perPage], mapTilePool[tile], sizeof page[0]);
+    m.tiles++;
+    if ((m.tiles % perPage) == 0) writeZoneBlock(MOWED_POOL + (m.tiles - perPage) * sizeof page[0], (byte*)page, sizeof page);
+  }
+  if ((m.tiles % perPage) != 0) {
+    writeZoneBlock(MOWED_POOL + (m.tiles - m.tiles % perPage) * sizeof page[0], (byte*)page, (m.tiles % perPage) * sizeof page[0]);
+  }
+  writeZoneBlock(MOWED_DIR, (byte*)mapLayers[MAP_LAYER_MOWED], tileCount * sizeof mapLayers[0][0]);
+  writeZoneBlock(MOWED_ADDR, (byte*)&m, sizeof m);
+  return true;
+}
+
+// restore mowed state saved by saveMowed (grid must not have changed)
+boolean MapClass::restoreMowed() {
+  map_mowed_t m;
+  memcpy(&m, Flash.readAddress(MOWED_ADDR), sizeof m);
+  if ((!mapValid) || (m.sizeX != mapSizeX) || (m.sizeY != mapSizeY)) {
+    DEBUGLN(F("Map error: no mowed state"));
+    return false;
+  }
+  clearMapLayer(MAP_LAYER_MOWED);
+  const uint16_t *dir = (const uint16_t*)Flash.readAddress(MOWED_DIR);
+  int k = 0;
+  for (int i = 0; i < mapTilesX * mapTilesY; i++) {
+    uint16_t tile = dir[i];
+    if (tile & MAP_TILE_UNIFORM) {
+      mapLayers[MAP_LAYER_MOWED][i] = tile;
+      continue;
+    }
+    if (allocMapTile(MAP_LAYER_MOWED, i)) {
+      memcpy(mapTilePool[mapLayers[MAP_LAYER_MOWED][i]], Flash.readAddress(MOWED_POOL + k * sizeof mapTilePool[0]), sizeof mapTilePool[0]);
+    }
+    k++;
+  }
+  countMapCells();
+  mapTilesPromoted = m.tilesPromoted;
+  mapCellsPromoted = m.cellsPromoted;
+  mowingTime = m.mowingTime;
+  return true;
 }
 
 
+// particle filter benchmark: sense update time (weighting, normalization, resampling) for N particles on current map,
+// particle coordinate type T (float: meter, coord_t: fixed-point) with unit coordinate units per meter
+template <typename T, int N> void particlesSpeedTest(MapClass &map, float unit) {
+  ParticleFilter<T, N> *pf = new ParticleFilter<T, N>();
+  DEBUG(F("map speedTest particles="));
+  DEBUG(N);
+  if (pf == NULL) {
+    DEBUGLN(F(" out of memory"));
+    return;
+  }
+  if (unit == 1) DEBUG(F(" float"));
+    else DEBUG(F(" fixed"));
+  DEBUG(F(" bytes="));
+  DEBUG(sizeof(ParticleFilter<T, N>));
+  pf->binScale /= unit;
+  for (int i = 0; i < N; i++) {
+    pf->x[i] = ((float)rand()) / ((float)RAND_MAX) * ((float)map.mapSizeX) / map.mapScaleX * unit;
+    pf->y[i] = ((float)rand()) / ((float)RAND_MAX) * ((float)map.mapSizeY) / map.mapScaleY * unit;
+    pf->theta[i] = 0;
+  }
+  pf->resampleThreshold = 2.0; // resample on each update
+  pf->minSize = N; // fixed particle count
+  unsigned long startTime = micros();
+  for (int k = 0; k < 10; k++) {
+    float mag = (k & 1) ? 1000 : -1000;
+    map.setMeasurement(mag, mag);
+    for (int i = 0; i < N; i++) pf->weights[i] *= map.measurementProb(pf->x[i], pf->y[i]);
+    pf->normalize();
+    pf->resample(fastRandomFloat());
+  }
+  float updateTime = ((float)(micros() - startTime)) / 10.0;
+  DEBUG(F(" resampled="));
+  DEBUG(pf->resampleCount);
+  DEBUG(F(" update(us)="));
+  DEBUGLN(updateTime);
+  delete pf;
+}
+
+// nearest point benchmark: query time of linear scan (sqrt per point) vs. point index for N outline points 
+// (perimeter wire with 0.1m point spacing), both must give same distances
+template <int N, int BUCKETS> void pointIndexSpeedTest() {
+  point_t *pts = new point_t[N];
+  PointIndex<float, N, BUCKETS> *index = new PointIndex<float, N, BUCKETS>();
+  DEBUG(F("map speedTest points="));
+  DEBUG(N);
+  if ((pts == NULL) || (index == NULL)) {
+    DEBUGLN(F(" out of memory"));
+    delete[] pts;
+    delete index;
+    return;
+  }
+  float radius = ((float)N) * 0.1 / (2 * PI);
+  index->begin(&pts[0].x, &pts[0].y, sizeof(point_t) / sizeof(float), MAP_INDEX_CELL_SIZE);
+  for (int i = 0; i < N; i++) {
+    float r = radius * (1.0 + 0.2 * sin(((float)i) / N * 14 * PI)); // wavy outline
+    pts[i].x = cos(((float)i) / N * 2 * PI) * r;
+    pts[i].y = sin(((float)i) / N * 2 * PI) * r;
+    index->add(i);
+  }
+  // queries near outline (map closure, particles)
+  const int queries = 100;
+  point_t q[queries];
+  float scanDist[queries];
+  for (int k = 0; k < queries; k++) {
+    int i = fastRandom() % N;
+    q[k].x = pts[i].x + (fastRandomFloat() - 0.5);
+    q[k].y = pts[i].y + (fastRandomFloat() - 0.5);
+  }
+  unsigned long startTime = micros();
+  for (int k = 0; k < queries; k++) {
+    float res = 99999;
+    for (int j = 0; j < N; j++) res = min(res, (float)sqrt( sq(q[k].x - pts[j].x) + sq(q[k].y - pts[j].y) ));
+    scanDist[k] = res;
+  }
+  float scanTime = ((float)(micros() - startTime)) / queries;
+  int errors = 0;
+  float distSum = 0;
+  startTime = micros();
+  for (int k = 0; k < queries; k++) {
+    float dist = sqrt(index->nearestSq(q[k].x, q[k].y));
+    distSum += dist;
+    if (fabs(dist - scanDist[k]) > 0.0001) errors++;
+  }
+  float indexTime = ((float)(micros() - startTime)) / queries;
+  DEBUG(F(" scan(us)="));
+  DEBUG(scanTime);
+  DEBUG(F(" index(us)="));
+  DEBUG(indexTime);
+  DEBUG(F(" avgDist="));
+  DEBUG(distSum / queries);
+  DEBUG(F(" errors="));
+  DEBUGLN(errors);
+  delete[] pts;
+  delete index;
+}
+
+// particles motion benchmark: CPU cycles per particle (cycle counter) of motion step with gauss() and sin/cos
+// (previous version) vs. fast random numbers, ziggurat gaussian and shared sin/cos of course, distribution statistics
+// of fast gaussian and sin/cos table error
+void motionSpeedTest(MapClass &map) {
+  map.particlesMotion(0.5, 0.1); // initialize tables
+  int particles = map.filter.size();
+  uint32_t startCycles = cycleCounter();
+  for (int k = 0; k < 10; k++) {
+    for (int i = 0; i < particles; i++) {
+      map.filter.theta[i] = gauss(map.filter.theta[i], map.headingNoise);
+      float particleCourse = gauss(0.5 + map.filter.theta[i], map.steeringNoise);
+      float particleDistance = gauss(0.1, map.distanceNoise);
+      map.filter.x[i] += toCoord(particleDistance * cos(particleCourse));
+      map.filter.y[i] += toCoord(particleDistance * sin(particleCourse));
+    }
+  }
+  float slowCycles = ((float)(cycleCounter() - startCycles)) / (10.0 * particles);
+  startCycles = cycleCounter();
+  for (int k = 0; k < 10; k++) map.particlesMotion(0.5, 0.1);
+  float fastCycles = ((float)(cycleCounter() - startCycles)) / (10.0 * particles);
+  float sum = 0;
+  float sqSum = 0;
+  float cubeSum = 0;
+  float quadSum = 0;
+  int n = 10000;
+  for (int i = 0; i < n; i++) {
+    float v = fastGaussRandom();
+    sum += v;
+    sqSum += v * v;
+    cubeSum += v * v * v;
+    quadSum += v * v * v * v;
+  }
+  float mean = sum / n;
+  float variance = sqSum / n - mean * mean;
+  float maxError = 0;
+  for (int i = 0; i < 1000; i++) {
+    float angle = (((float)i) / 1000.0 - 0.5) * 4 * PI;
+    float s, c;
+    fastSinCos(angle, s, c);
+    maxError = max(maxError, max(fabs(s - sin(angle)), fabs(c - cos(angle))));
+  }
+  DEBUG(F("map speedTest motion particles="));
+  DEBUG(particles);
+  DEBUG(F(" cycles/particle gauss+sin/cos="));
+  DEBUG(slowCycles);
+  DEBUG(F(" fast="));
+  DEBUG(fastCycles);
+  DEBUG(F(" speedup="));
+  DEBUG(slowCycles / fastCycles);
+  DEBUG(F(" gaussian mean="));
+  DEBUG(mean);
+  DEBUG(F(" variance="));
+  DEBUG(variance);
+  DEBUG(F(" skewness="));
+  DEBUG(cubeSum / n);
+  DEBUG(F(" kurtosis="));
+  DEBUG(quadSum / n);
+  DEBUG(F(" sin/cos error="));
+  ROBOTMSG.println(maxError, 6);
+}
+
+// map benchmark: RAM usage (map, static data, heap, free), memory usage and lookup time for synthetic (circular) lawns of different size,
+// particles motion time, particle filter update time for different particle counts (float vs. fixed-point coordinates), flood fill and signal computation time for different grid sizes
+void MapClass::speedTest() {
+  int staticRam, heap;
+  ramUsage(staticRam, heap);
+  DEBUG(F("map speedTest ram map="));
+  DEBUG(sizeof(MapClass));
+  DEBUG(F(" grid="));
+  DEBUG(sizeof mapLayers + sizeof mapTilePool + sizeof mapTileOwner + sizeof mapSignal);
+  DEBUG(F(" particles="));
+  DEBUG(sizeof filter);
+  DEBUG(F(" learned="));
+  DEBUG(sizeof magField);
+  DEBUG(F(" static="));
+  DEBUG(staticRam);
+  DEBUG(F(" heap="));
+  DEBUG(heap);
+  DEBUG(F(" free="));
+  DEBUGLN(freeRam());
+  float areas[] = { 100, 500, 2000 };
+  for (int k = 0; k < 3; k++) {
+    float radius = sqrt(areas[k] / PI);
+    perimeterOutlineSize = OUTLINE_SIZE - 1;
+    for (int i = 0; i < perimeterOutlineSize; i++) {
+      perimeterOutline[i].x = cos(((float)i) / ((float)(perimeterOutlineSize - 1)) * 2 * PI) * radius;
+      perimeterOutline[i].y = sin(((float)i) / ((float)(perimeterOutlineSize - 1)) * 2 * PI) * radius;
+    }
+    unsigned long startTime = millis();
+    transferOutlineToMap();
+    unsigned long transferTime = millis() - startTime;
+    // lookup time (100x100 lookups evenly distributed over map)
+    float stepX = ((float)mapSizeX) / mapScaleX / 100.0;
+    float stepY = ((float)mapSizeY) / mapScaleY / 100.0;
+    int inside = 0;
+    startTime = micros();
+    for (int y = 0; y < 100; y++) {
+      for (int x = 0; x < 100; x++) {
+        if (getMapDataMeter(stepX * x, stepY * y).s.side == MAP_DATA_SIDE_IN) inside++;
+      }
+    }
+    float lookupTime = ((float)(micros() - startTime)) / 10000.0;
+    // same lookups with fixed-point coordinates (particles), cells may differ at cell borders (coordinate rounding)
+    coord_t coordX[100];
+    coord_t coordY[100];
+    for (int i = 0; i < 100; i++) {
+      coordX[i] = toCoord(stepX * i);
+      coordY[i] = toCoord(stepY * i);
+    }
+    int insideFixed = 0;
+    startTime = micros();
+    for (int y = 0; y < 100; y++) {
+      for (int x = 0; x < 100; x++) {
+        if (getMapDataCoord(coordX[x], coordY[y]).s.side == MAP_DATA_SIDE_IN) insideFixed++;
+      }
+    }
+    float lookupFixedTime = ((float)(micros() - startTime)) / 10000.0;
+    DEBUG(F("map speedTest area="));
+    DEBUG(areas[k]);
+    DEBUG(F(" resolution="));
+    DEBUG(1.0 / mapScaleX);
+    DEBUG(F(" size="));
+    DEBUG(mapSizeX);
+    DEBUG(F("x"));
+    DEBUG(mapSizeY);
+    DEBUG(F(" tiles="));
+    DEBUG(mapTilesUsed);
+    DEBUG(F("/"));
+    DEBUG(mapTilesX * mapTilesY);
+    DEBUG(F(" bytes="));
+    DEBUG(mapTilesUsed * sizeof mapTilePool[0] + MAP_LAYERS * mapTilesX * mapTilesY * sizeof mapLayers[0][0]
+          + (mapSignalSizeX * mapSignalSizeY + 1) / 2);
+    DEBUG(F(" inside="));
+    DEBUG(inside);
+    DEBUG(F(" transfer(ms)="));
+    DEBUG(transferTime);
+    DEBUG(F(" lookup(us)="));
+    DEBUG(lookupTime);
+    DEBUG(F(" fixed(us)="));
+    DEBUG(lookupFixedTime);
+    DEBUG(F(" insideFixed="));
+    DEBUGLN(insideFixed);
+  }
+  motionSpeedTest(*this);
+  particlesSpeedTest<float, 150>(*this, 1);
+  particlesSpeedTest<coord_t, 150>(*this, COORD_ONE);
+  particlesSpeedTest<float, 500>(*this, 1);
+  particlesSpeedTest<coord_t, 500>(*this, COORD_ONE);
+  particlesSpeedTest<float, 2000>(*this, 1);
+  particlesSpeedTest<coord_t, 2000>(*this, COORD_ONE);
+  pointIndexSpeedTest<150, 64>();
+  pointIndexSpeedTest<1000, 512>();
+  pointIndexSpeedTest<5000, 2048>();
+  // flood fill and signal distance transform time for synthetic grids (circular perimeter)
+  int sizes[] = { 100, 400 };
+  for (int k = 0; k < 2; k++) {
+    map_data_t md;
+    md.v = 0;
+    md.s.side = MAP_DATA_SIDE_OUT;
+    clearMap(sizes[k], sizes[k], md);
+    float radius = sizes[k] * 0.4;
+    int steps = radius * 2 * PI * 2;
+    for (int i = 0; i < steps; i++) {
+      setWireCell(sizes[k] / 2 + cos(((float)i) / ((float)steps) * 2 * PI) * radius,
+                  sizes[k] / 2 + sin(((float)i) / ((float)steps) * 2 * PI) * radius, true);
+    }
+    unsigned long startTime = micros();
+    resetMapDataInside(sizes[k] / 2, sizes[k] / 2);
+    unsigned long fillTime = micros() - startTime;
+    startTime = micros();
+    resetMapDataSignal();
+    unsigned long signalTime = micros() - startTime;
+    clearMapLayer(MAP_LAYER_OBSTACLE);
+    compactMapTiles();
+    int inside = 0;
+    for (int y = 0; y < mapSizeY; y++) {
+      for (int x = 0; x < mapSizeX; x++) {
+        if (getMapBit(MAP_LAYER_SIDE, x, y) == MAP_DATA_SIDE_IN) inside++;
+      }
+    }
+    DEBUG(F("map speedTest grid="));
+    DEBUG(mapSizeX);
+    DEBUG(F("x"));
+    DEBUG(mapSizeY);
+    DEBUG(F(" tiles="));
+    DEBUG(mapTilesUsed);
+    DEBUG(F(" overflow="));
+    DEBUG(mapTileOverflow);
+    DEBUG(F(" inside="));
+    DEBUG(inside);
+    DEBUG(F(" fill(us)="));
+    DEBUG(fillTime);
+    DEBUG(F(" signal(us)="));
+    DEBUGLN(signalTime);
+  }
+  // restore stored map
+  clearOutline();
+  mapValid = loadMap();
+  if (!mapValid) {
+    map_data_t md;
+    md.v = 0;
+    md.s.side = MAP_DATA_SIDE_OUT;
+    clearMap(MAP_TILE_SIZE, MAP_TILE_SIZE, md);
+  }
+  distributeParticlesOutline();
+}
@@ -14,7 +14,8 @@ example usage:
                              Map.correctOutline();
                              Map.transferOutlineToMap();
                              Map.distributeParticlesOutline();
-  4) call this in main loop: Map.run();
+  4) call this in control loop: Map.run();
+     call this in main loop:    Map.runFilter();
 												     Serial.print(Map.robotState.x);
 														 Serial.print(",");
 														 Serial.print(Map.robotState.y);
@@ -26,12 +27,124 @@ example usage:
 
 #include <Arduino.h>
 #include "robot.h"
-
-#define MAP_SIZE_X 20
-#define MAP_SIZE_Y 20
-
-// outline OR particles count
-#define OUTLINE_PARTICLES 150 
+#include "helper.h"
+#include "particles.h"
+#include "pointindex.h"
+#include "magfield.h"
+#include "occupancy.h"
+#include "instance.h"
+
+// map grid (tiled bit layers): the grid size is set by transferOutlineToMap (depending on outline extent and resolution),
+// the grid is split into tiles of MAP_TILE_SIZE x MAP_TILE_SIZE cells and each cell attribute (side, mowed, obstacle)
+// is a bit layer with its own tile directory - tiles with all bits of same value (e.g. completely outside of 
+// perimeter, completely mowed) are stored implicitly in the directory (no RAM required), all other tiles of all 
+// layers are allocated from one tile pool (one bit per cell, 32 bytes per tile)
+#define MAP_TILE_BITS      4        // 16x16 cells per tile
+#define MAP_TILE_SIZE      (1 << MAP_TILE_BITS)
+#define MAP_TILE_MASK      (MAP_TILE_SIZE - 1)
+#define MAP_TILE_CELLS     (MAP_TILE_SIZE * MAP_TILE_SIZE)
+#define MAP_TILES_MAX      1536     // tile directory size (max. map extent in tiles, e.g. 62x62m at 0.1m)
+#define MAP_TILE_POOL_SIZE 640      // allocated tiles of all layers (640 * 32 bytes = 20 KB RAM)
+#define MAP_TILE_RESERVE   64       // tiles kept free for obstacle layer when building the map (besides one mowed tile
+                                    // for each tile with inside cells, so mowed cells can always be stored)
+#define MAP_TILE_UNIFORM   0x8000   // tile directory flag: implicit tile (lowest bit holds bit value of all cells)
+#define MAP_TILE_OWNER_SHIFT 14     // tile pool owner: layer (highest bits) and tile directory index
+
+#define MAP_LAYER_SIDE     0        // bit set: outside of perimeter (MAP_DATA_SIDE_OUT)
+#define MAP_LAYER_MOWED    1        // bit set: mowed (outside cells are don't care)
+#define MAP_LAYER_OBSTACLE 2        // bit set: obstacle (while building the map: perimeter pixels)
+#define MAP_LAYERS         3
+
+// signal field: city-block distance (4 bits, saturating) of each coarse cell (2^n x 2^n grid cells) to the next
+// coarse cell with perimeter pixels - the coarse cell size is the smallest one (at least 2x2 cells) so that the 
+// field fits, e.g. 0.4m for a 45x45m grid at 0.1m resolution - a cell gets the signal of its coarse cell distance, 
+// which differs from the per-cell signal (city-block distance to the next perimeter pixel) by at most 2*(2^n - 1)
+#define MAP_SIGNAL_CELLS_MAX 16384  // coarse cells (two cells per byte = 8 KB RAM)
+#define MAP_SIGNAL_DIST_MAX  15
+
+#define MAP_RESOLUTION     0.1      // default grid resolution (meter per cell)
+
+#define MAP_RAM_BUDGET     (58 * 1024) // max. size of MapClass (Arduino Due: 96 KB RAM, see also PLANNER_RAM_BUDGET)
+
+#define MAP_FILL_STACK_SIZE 256     // flood fill seeds (on overflow, seeds are recovered by grid rescan)
+
+// perimeter outline points
+#define OUTLINE_SIZE 150 
+
+#define MAP_CUTTING_WIDTH    0.3    // default cutter width (meter)
+#define MAP_COVERAGE_TARGET  95     // default coverage (percent of inside cells mowed) to stop mowing
+
+#define MAP_INDEX_CELL_SIZE  0.5    // cell size of point index benchmark (meter)
+#define MAP_START_POINTS     10     // outline points used for map closure (distanceToStart)
+#define MAP_CLOSURE_DIST_NOISE    0.01    // loop closure: odometry variance per step meter (m^2/m)
+#define MAP_CLOSURE_HEADING_NOISE 0.0005  // loop closure: heading variance per travelled meter (rad^2/m)
+
+
+// particle filter stages (processed time-sliced by runFilter, a bounded slice of particles per main loop iteration)
+#define FILTER_STAGE_IDLE     0
+#define FILTER_STAGE_MOTION   1
+#define FILTER_STAGE_SENSE    2
+#define FILTER_STAGE_RESAMPLE 3
+#define FILTER_STAGE_STATE    4
+#define FILTER_STAGES         5
+
+#define FILTER_BUDGET_US      1000  // particle filter CPU time per main loop iteration (microseconds)
+#define FILTER_SLICE          16    // particles processed between budget checks
+
+#define MAP_HEADING_BIAS_INIT  0.05   // initial heading offset sigma of particles (rad)
+#define MAP_SMALL_ANGLE        0.2    // particle motion: max. course difference of shared course sin/cos (rad)
+#define MAP_LOCALIZED_DISTANCE 1.0    // well localized: max. particles extent (meter)
+#define MAP_LOCALIZED_HEADING  0.035  // well localized: max. heading offset sigma (rad)
+#define MAP_LOCALIZED_TIMEOUT  5000   // well localized: max. time since last filter update (ms)
+
+#define MAP_PARTICLES          500    // particle pool size (active particles adapt by KLD-sampling)
+#define MAP_PARTICLES_MIN      50     // min. active particles
+
+#define MAP_STEERING_NOISE     0.005  // default robot steering noise sigma (rad units)
+#define MAP_DISTANCE_NOISE     0.01   // default distance sensor measurement noise sigma (m)
+// stochastic rounding of particle steps (toCoordDither) adds a random walk of at most 1/2 coord unit (3.9 mm) sigma
+// per update and axis, below the distance noise: e.g. 0.55 m sigma over 20 m at 2 mm steps (10000 updates, distance
+// noise 1 m)
+#define MAP_MEASUREMENT_NOISE  0.2    // default perimeter sensor measurement noise sigma (normalized magnitude)
+
+// likelihood field (measurement model): probability of a perimeter reading (quantized left/right magnitude) for 
+// each cell class (side and signal of map cell), built by buildLikelihoodField
+#define MAP_LIKELIHOOD_CLASSES    64    // cell classes: side (1 bit) and signal (5 bits)
+#define MAP_LIKELIHOOD_LEVELS     4     // magnitude levels per sign
+#define MAP_LIKELIHOOD_BINS       (2 * MAP_LIKELIHOOD_LEVELS) // quantized magnitude (sign and level) per coil
+#define MAP_LIKELIHOOD_MAG_MAX    3000  // magnitude at perimeter wire (normalized magnitude 1.0)
+#define MAP_LIKELIHOOD_FALLOFF    1.5   // distance to perimeter wire where magnitude drops to half (meter)
+#define MAP_LIKELIHOOD_SIGN_ERROR 0.05  // probability of wrong magnitude sign (in/out)
+#define MAP_LIKELIHOOD_OUTLIER    0.05  // probability of a random magnitude level
+
+// learned magnitude field (measurement model): running mean/variance of measured magnitudes per cell while
+// well localized, replaces the likelihood field for cells with enough samples where the learned magnitude differs
+// from the expected magnitude of the distance model
+#define MAP_LEARN_CELLS           256   // learned cells (14 bytes per cell)
+#define MAP_LEARN_CELL_SIZE       0.5   // learned cell size (meter)
+#define MAP_LEARN_MIN_COUNT       8     // min. samples of a learned cell used by measurement model
+#define MAP_LEARN_NOISE_MIN       0.1   // min. magnitude sigma of learned cell (normalized magnitude)
+
+// occupancy layer (obstacles): sonar rays and bumper contacts update log-odds of map cells while mowing well
+// localized (log-odds in 1/8 units, see occupancy.h) - cells reaching MAP_OCC_MARK are marked as obstacle
+// (MAP_DATA_STATE_OBSTACLE, excluded from inside cells), marked cells dropping to MAP_OCC_UNMARK are restored
+#define MAP_OCC_CELLS             256   // occupancy cells (6 bytes per cell)
+#define MAP_OCC_HIT               7     // sonar echo in cell (p=0.7)
+#define MAP_OCC_MISS              -3    // sonar ray passes cell (p=0.4)
+#define MAP_OCC_BUMPER            24    // bumper contact in cell (p=0.95)
+#define MAP_OCC_MARK              16    // mark cell as obstacle (p=0.88)
+#define MAP_OCC_UNMARK            4     // restore marked cell (p=0.62)
+#define MAP_OCC_MIN               -16
+#define MAP_OCC_MAX               48
+#define MAP_BUMPER_DISTANCE       0.25  // bumper contact point ahead of robot center (meter)
+#define MAP_BUMPER_ANGLE          0.5   // left/right bumper contact point angle (rad)
+#define MAP_OBSTACLE_LOOKAHEAD    0.5   // mowing: stop before marked obstacle (meter ahead of robot center)
+
+// map zones: named maps in flash, each zone has its own flash slot (scale, outline and grid layers including mowed state),
+// a zone index in flash holds grid size, scale and checksum of each zone - the active zone is loaded at startup, 
+// its coverage is saved when mowing stops (no flash writes while mowing)
+#define MAP_ZONES_MAX             6     // zone slots in flash (30 KB per zone, followed by mowed state snapshot)
+#define MAP_ZONE_NAME_SIZE        12    // zone name (including terminating zero)
 
 
 // map data
@@ -67,6 +180,30 @@ struct point_t {
 typedef struct point_t point_t;
 
 
+// zone index entry (empty zone: sizeX=0)
+struct map_zone_t {
+  char name[MAP_ZONE_NAME_SIZE];
+  float scaleX; // meter to pixel
+  float scaleY;
+  int16_t sizeX; // grid size (cells)
+  int16_t sizeY;
+  int16_t tilesUsed; // allocated tiles in tile pool
+  int16_t outlineSize; // perimeter outline points
+  uint32_t mowingTime; // time spent mowing since mowed cells reset (ms)
+  uint32_t checksum; // zone data (tile directories, outline, tile pool)
+};
+
+typedef struct map_zone_t map_zone_t;
+
+
+struct cell_t {
+  int16_t x;
+  int16_t y;
+};
+
+typedef struct cell_t cell_t;
+
+
 struct polar_t {
   float r;
   float phi;
@@ -92,53 +229,252 @@ class MapClass {
       robot_state_t robotState; // current robot position estimation (meter)
       float steeringNoise; // robot steering noise sigma (rad units)
       float distanceNoise;  // distance sensor measurement noise sigma (m)
-      float measurementNoise; // perimeter sensor measurement noise sigma (magnitude)
+      float measurementNoise; // perimeter sensor measurement noise sigma (normalized magnitude)
+      float headingNoise; // heading offset drift sigma per filter update (rad)
+      float headingBias; // estimated heading offset to IMU yaw (rad)
+      float headingBiasSpread; // heading offset sigma of particles (rad)
       float overallProb; // overall probability
       robot_state_t particlesState; // all particles center (meter)
+      int filterStage; // current particle filter stage
+      unsigned long filterBudget; // particle filter CPU time per main loop iteration (microseconds)
+      unsigned long filterUpdates; // completed particle filter updates
+      unsigned long filterStageTime[FILTER_STAGES]; // CPU time of each stage in last update (microseconds)
+      unsigned long filterUpdateTime; // CPU time of last update (microseconds)
+      unsigned long filterUpdateDuration; // time from start to end of last update (milliseconds)
+      unsigned long filterMaxSliceTime; // max. CPU time of runFilter call (microseconds)
+      unsigned long filterLastUpdateTime; // time of last completed update (milliseconds)
+      unsigned long replaySteps; // replayed control loop steps
       float particlesDistanceX; // all particles diameter (meter)
       float particlesDistanceY;
-      robot_state_t outlineParticles[OUTLINE_PARTICLES]; // outline OR particles data
+      point_t perimeterOutline[OUTLINE_SIZE]; // perimeter outline (meter)
+      ParticleFilter<coord_t, MAP_PARTICLES> filter; // particles (fixed-point meter, rad) - particle pool size is template parameter
       float mapScaleX; // meter to pixel
       float mapScaleY;
+      int32_t coordScaleX; // fixed-point coordinate to pixel (16 fractional bits, see setMapScale)
+      int32_t coordScaleY;
+      float mapResolution; // requested grid resolution (meter per cell), may get coarser for large maps
+      int mapSizeX; // grid size (cells)
+      int mapSizeY;
+      int mapTilesX; // grid size (tiles)
+      int mapTilesY;
+      int mapTilesUsed; // allocated tiles in tile pool (all layers)
+      int mapTileOverflow; // failed tile allocations (tile pool exhausted)
+      int mapTilesPromoted; // mowed tiles made completely mowed to free tile pool (see promoteMowedTile)
+      long mapCellsPromoted; // unmowed inside cells of promoted tiles (not counted by coverage)
+      int mapSignalShift; // coarse cell size of signal field (2^n cells)
+      int mapSignalSizeX; // signal field size (coarse cells)
+      int mapSignalSizeY;
+      float cuttingWidth; // cutter width (meter)
+      float coverageTarget; // stop mowing at this coverage (percent)
+      long mapCellsInside; // cells inside perimeter
+      long mapCellsMowed; // mowed cells inside perimeter (updated while mowing)
+      long mapCellsObstacle; // obstacle cells inside perimeter (not counted as inside cells)
+      unsigned long mowingTime; // time spent mowing since mowed cells reset (ms)
 	    int perimeterWireLengthMeter;
       float currMapX;
       float currMapY;
       int lastMotorLeftTicks;
       int lastMotorRightTicks;
   	  int perimeterOutlineSize;
-      map_data_t mapData[MAP_SIZE_Y][MAP_SIZE_X];
+      uint16_t mapLayers[MAP_LAYERS][MAP_TILES_MAX]; // tile directory of each layer: tile pool index or implicit tile (MAP_TILE_UNIFORM | bit)
+      uint16_t mapTilePool[MAP_TILE_POOL_SIZE][MAP_TILE_SIZE]; // one bit per cell, one word per tile row
+      uint8_t mapSignal[MAP_SIGNAL_CELLS_MAX / 2]; // signal field: distance of coarse cell to perimeter pixels (two per byte)
+      uint8_t mapSignalLevels[MAP_SIGNAL_DIST_MAX + 1]; // signal of coarse distance
+      uint8_t likelihoodField[MAP_LIKELIHOOD_BINS * MAP_LIKELIHOOD_BINS][MAP_LIKELIHOOD_CLASSES]; // mowing: reading, cell class
+      uint8_t likelihoodTrack[MAP_LIKELIHOOD_CLASSES]; // tracking perimeter: cell class
+      MagField<MAP_LEARN_CELLS> magField; // learned magnitudes
+      OccupancyGrid<MAP_OCC_CELLS> occupancy; // obstacle log-odds
+      int activeZone; // map is loaded from and saved to this zone
+      map_zone_t zones[MAP_ZONES_MAX]; // zone index
       void begin();
       void run();
+      void runFilter();
+      bool isWellLocalized();
+      bool isConverged();
+      unsigned long replayStep(float distance, float yaw, float leftMag, float rightMag, int state);
+      void replayMap(int cmd);
+      void replayOutlinePoint(float x, float y);
       void clearOutline();
       void exampleOutline();
       void correctOutline();
       void transferOutlineToMap();
       float distanceToStart(float x, float y);
-      float distanceToParticles(float x, float y);
       void robotMotion(float course, float distance);
+      void mowSegment(float x0, float y0, float x1, float y1);
+      void countMapCells();
+      void senseObstacles();
+      bool isObstacleAhead(float distance);
+      void resetMowed();
+      float coverage();
+      float mowedArea();
+      float mowingRate();
+      bool isCoverageReached();
       void particlesMotion(float course, float distance);
+      void particlesMotion(float course, float distance, int startIdx, int endIdx);
+      void setMapScale(float scaleX, float scaleY);
+      // map cell of fixed-point coordinate (multiply and shift, no float conversion)
+      int coordToCellX(coord_t x){
+        return (((int32_t)x) * coordScaleX) >> 16;
+      }
+      int coordToCellY(coord_t y){
+        return (((int32_t)y) * coordScaleY) >> 16;
+      }
       inline bool isXYOnMapMeter(float x, float y);
       bool isXYOnMap(int x, int y);
+      // grid cell access (x=column, y=row, row 0 is top of map) - coordinates must be on map
+      bool getMapBit(int layer, int x, int y){
+        uint16_t tile = mapLayers[layer][(y >> MAP_TILE_BITS) * mapTilesX + (x >> MAP_TILE_BITS)];
+        if (tile & MAP_TILE_UNIFORM) return (tile & 1);
+        return (mapTilePool[tile][y & MAP_TILE_MASK] >> (x & MAP_TILE_MASK)) & 1;
+      }
+      // bits of tile row (bit per cell)
+      uint16_t getMapRow(int layer, int tileIdx, int row){
+        uint16_t tile = mapLayers[layer][tileIdx];
+        if (tile & MAP_TILE_UNIFORM) return (tile & 1) ? 0xFFFF : 0;
+        return mapTilePool[tile][row];
+      }
+      int getMapSignal(int x, int y){
+        int idx = (y >> mapSignalShift) * mapSignalSizeX + (x >> mapSignalShift);
+        return mapSignalLevels[(mapSignal[idx >> 1] >> ((idx & 1) << 2)) & MAP_SIGNAL_DIST_MAX];
+      }
+      // cell class of measurement model (side and signal)
+      int getMapCellClass(int x, int y){
+        return (getMapBit(MAP_LAYER_SIDE, x, y) << 5) | getMapSignal(x, y);
+      }
+      map_data_t getMapCell(int x, int y){
+        map_data_t md;
+        md.v = 0;
+        md.s.signal = getMapSignal(x, y);
+        md.s.side = getMapBit(MAP_LAYER_SIDE, x, y);
+        if (getMapBit(MAP_LAYER_OBSTACLE, x, y)) md.s.state = MAP_DATA_STATE_OBSTACLE;
+          else if ((md.s.side == MAP_DATA_SIDE_IN) && (getMapBit(MAP_LAYER_MOWED, x, y))) md.s.state = MAP_DATA_STATE_MOWED;
+        return md;
+      }
+      bool setMapBit(int layer, int x, int y, bool value);
+      bool setMapCell(int x, int y, map_data_t value);
+      void clearMap(int sizeX, int sizeY, map_data_t value);
+      int compactMapTiles();
+      bool isInside(int x, int y, int radius);
       void setMapData(int xp, int yp, map_data_t value);
       void setMapDataMeter(float x, float y, map_data_t value, int thickness = 1);
       inline map_data_t getMapDataMeter(float x, float y);
+      map_data_t getMapDataCoord(coord_t x, coord_t y){
+        int xp = coordToCellX(x);
+        int yp = coordToCellY(y);
+        if ((xp >= mapSizeX) || (xp < 0) || (yp >= mapSizeY) || (yp < 0)) {
+          map_data_t md;
+          md.v = 0;
+          md.s.side = MAP_DATA_SIDE_OUT;
+          return md;
+        }
+        return getMapCell(xp, mapSizeY - 1 - yp);
+      }
       void distributeParticlesOutline();
       void computeParticlesState();
-      void setParticlesState(float x, float y, float orientation);
-      inline float measurementProb(int particleIdx, float leftMag, float rightMag);
+      void computeParticlesState(int startIdx, int endIdx);
+      void setParticlesState(float x, float y, float theta);
+      void setFilterSettings(float steering, float distance, float measurement, int particles);
+      void buildLikelihoodField();
+      void setMeasurement(float leftMag, float rightMag);
+      // probability of current measurement (set by setMeasurement) at position (meter)
+      float measurementProb(float x, float y){
+        int xp = ((int)(x * mapScaleX));
+        int yp = ((int)(y * mapScaleY));
+        if ((xp >= mapSizeX) || (xp < 0) || (yp >= mapSizeY) || (yp < 0)) return 0;
+        int c = getMapCellClass(xp, mapSizeY - 1 - yp);
+        if (learnedActive) return cellProb(c, x, y);
+        return measurementProbs[c];
+      }
+      // probability of current measurement at fixed-point position (particles)
+      float measurementProb(coord_t x, coord_t y){
+        int xp = coordToCellX(x);
+        int yp = coordToCellY(y);
+        if ((xp >= mapSizeX) || (xp < 0) || (yp >= mapSizeY) || (yp < 0)) return 0;
+        int c = getMapCellClass(xp, mapSizeY - 1 - yp);
+        if (learnedActive) return cellProb(c, fromCoord(x), fromCoord(y));
+        return measurementProbs[c];
+      }
+      float measurementProb(float x, float y, float leftMag, float rightMag);
       void sense(float leftMag, float rightMag);
+      void weightParticles(int startIdx, int endIdx);
       void resetMapDataOutside(int x, int y);
       void resetMapDataInside(int x, int y);
-      void resetMapDataSignal(int x, int y, int signalStrength);	  
+      void resetMapDataSignal();	  
+      void floodFill(int x, int y, int side);
   	  boolean loadMap();
 	    void saveMap();      
+      boolean selectZone(int zone);
+      boolean saveZone(int zone, const char *name);
+      boolean saveMowed();
+      boolean restoreMowed();
+      boolean deleteZone(int zone);
+      void speedTest();
     protected:
 	    float distAvgSum;  
-	    void loadSaveMap(boolean readflag);
-      unsigned long nextSampleTime;
+      unsigned long lastMowingTime;
+      float filterDistanceSum; // moved distance since last particle filter update (meter)
+      float filterDistance; // particle filter update input
+      float filterCourse;
+      int filterRobotState;
+      float filterLeftMag;
+      float filterRightMag;
+      float measurementProbs[MAP_LIKELIHOOD_CLASSES]; // probability of current measurement for each cell class
+      bool learnedActive; // use learned magnitude field for current measurement
+      float measLeftMag; // current measurement (normalized magnitude)
+      float measRightMag;
+      float likelihoodExpected[MAP_LIKELIHOOD_CLASSES]; // expected magnitude of cell class (normalized magnitude)
+      float learnedProb(int idx, float expected);
+      // probability of current measurement in cell of class c at position (meter): learned cell or likelihood field
+      float cellProb(int c, float x, float y){
+        int idx = magField.find(x, y);
+        if ((idx >= 0) && (magField.count(idx) >= MAP_LEARN_MIN_COUNT)) {
+          float p = learnedProb(idx, likelihoodExpected[c]);
+          if (p >= 0) return p;
+        }
+        return measurementProbs[c];
+      }
+      int filterIndex; // next particle to process in current stage
+      unsigned long filterStartTime;
+      uint32_t filterStageCycles[FILTER_STAGES];
+      float stateSumX; // particles state computation
+      float stateSumY;
+      float stateSumTheta;
+      float stateSqSumTheta;
+      coord_t stateMinX;
+      coord_t stateMaxX;
+      coord_t stateMinY;
+      coord_t stateMaxY;
+      unsigned long lastSonarMeasurements;
+      bool lastBumperPressed;
+      void senseRange(float course, float angle, unsigned int distance);
+      void senseContact(float angle);
+      void updateOccupancy(int xp, int yp, int delta, bool insert);
+      void loadZoneIndex();
+      void saveZoneIndex();
+      uint16_t mapTileOwner[MAP_TILE_POOL_SIZE]; // layer and tile directory index of each allocated tile
+      int mapTileWrites; // writes to allocated tiles since last compaction
+      bool allocMapTile(int layer, int tileIdx);
+      void releaseMapTile(int i, int value);
+      int uniformMapTile(int i);
+      bool promoteMowedTile();
+      void clearMapLayer(int layer);
+      void setSignalDist(int idx, int dist);
+      int getSignalDist(int idx){
+        return (mapSignal[idx >> 1] >> ((idx & 1) << 2)) & MAP_SIGNAL_DIST_MAX;
+      }
+      void rasterizeOutline(bool wire);
+      void setWireCell(int x, int y, bool wire);
+      cell_t fillStack[MAP_FILL_STACK_SIZE]; // flood fill seeds
+      int fillStackSize;
+      bool fillStackOverflow;
+      void pushFillSeed(int x, int y);
+      void pushFillSeeds(int x0, int y0, int x1, int y1, int side);
+      bool isFillable(int x, int y, int side);
+      bool isFilled(int x, int y, int side);
+      bool isUniformFillTile(int tileIdx);
 };
 
-extern MapClass Map;
+extern SUNRAY_INSTANCE MapClass Map;
 
 
 #endif
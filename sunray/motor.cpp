@@ -31,7 +31,7 @@ Private-use only! (you need to ask for a commercial-use)
 #include "pinman.h"
 #include "robot.h"
 
-MotorClass Motor;
+SUNRAY_INSTANCE MotorClass Motor;
 
 volatile uint16_t odoTicksLeft = 0;
 volatile uint16_t odoTicksRight = 0;
@@ -206,11 +206,10 @@ void MotorClass::speedPWM ( MotorSelect motor, int speedPWM )
 
 void MotorClass::speedControlLine() {
   // compute distance to line (https://en.wikipedia.org/wiki/Distance_from_a_point_to_a_line#Line_defined_by_two_points)
-  float x1 = angleRadSetStartX;
-  float y1 = angleRadSetStartY;
-  float x2 = angleRadSetStartX + cos(angleRadSet) * 10000.0;
-  float y2 = angleRadSetStartY + sin(angleRadSet) * 10000.0;  
-  distToLine = ((y2-y1)*motorPosX-(x2-x1)*motorPosY+(x2*y1-y2*x1)) / sqrt(sq(y2-y1)+sq(x2-x1));
+  // (line through start position in set direction, offset from start is exact in fixed-point)
+  float dx = fromLCoord(motorPosX - angleRadSetStartX) * 100.0;
+  float dy = fromLCoord(motorPosY - angleRadSetStartY) * 100.0;
+  distToLine = sin(angleRadSet) * dx - cos(angleRadSet) * dy;
   int correctLeft = 0;
   int correctRight = 0;
   float angleToTargetRad = distancePI(angleRadCurr, angleRadSet); // w-x
@@ -519,8 +518,8 @@ void MotorClass::run() {
   } else {
     angleRadCurr = scalePI(angleRadCurr + angleRadCurrDeltaOdometry);
   }
-  motorPosX += distanceCmAvg * cos(angleRadCurr);
-  motorPosY += distanceCmAvg * sin(angleRadCurr);  
+  motorPosX += toLCoord(distanceCmAvg / 100.0 * cos(angleRadCurr));
+  motorPosY += toLCoord(distanceCmAvg / 100.0 * sin(angleRadCurr));
 
   speedControl();
   if ((motorStopTime != 0) && (millis() >= motorStopTime)) stopImmediately();
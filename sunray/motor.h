@@ -18,6 +18,8 @@
 #define MOTOR_H
 
 #include "pid.h"
+#include "helper.h"
+#include "instance.h"
 
 
 // selected motor
@@ -68,8 +70,8 @@ class MotorClass {
     float wheelBaseCm;  // wheel-to-wheel diameter
 
     float distToLine;
-    float motorPosX;
-    float motorPosY;
+    lcoord_t motorPosX; // odometry position (fixed-point meter)
+    lcoord_t motorPosY;
     float speedDpsCurr;
     float distanceCmCurr;
 	  float distanceCmAvg;
@@ -78,8 +80,8 @@ class MotorClass {
 		float angleRadCurrDeltaIMU; // robot angle delta IMU
 		float angleRadCurrDeltaOdometry; // robot angle delta odometry		
     float angleRadSet;  // set (absolute) start line angle
-    float angleRadSetStartX;
-    float angleRadSetStartY;
+    lcoord_t angleRadSetStartX; // line start position (fixed-point meter)
+    lcoord_t angleRadSetStartY;
     float speedRpmSet;
     float mowerPWMSet;
     float mowerPWMCurr; // current mower motor pwm
@@ -155,7 +157,7 @@ class MotorClass {
 		void resetPID();
 };
 
-extern MotorClass Motor;
+extern SUNRAY_INSTANCE MotorClass Motor;
 
 #endif
 
@@ -0,0 +1,179 @@
+// occupancy layer: log-odds of obstacle per map cell, updated by range sensor rays (sonar) and contact (bumper)
+//
+// usage:
+//   OccupancyGrid<256> occ;
+//   int idx = occ.insert(xp, yp);                // hit: cell slot (added if not in table)
+//   if (idx >= 0) occ.add(idx, 7);               // add log-odds
+//   idx = occ.find(xp, yp);                      // miss: only cells in table (no cell: not an obstacle)
+//   if (occ.logOdds(idx) >= 16) ... occ.setMarked(idx, true, previousState)
+//   occ_ray_t ray;
+//   occ.beginRay(ray, x0, y0, cos(a), sin(a), length); // cells
+//   while (occ.nextRayCell(ray, cx, cy)) ...            // ray.steps < 0: end cell
+//
+// cells are stored in a hash table (open addressing, linear probing) - only cells that have been hit use memory,
+// unknown cells are free space (log-odds 0), cells that became free again (log-odds <= 0, not marked) are reused
+// when the table is full; log-odds are fixed-point (integer units, see MAP_OCC_HIT) and clamped to [min, max]
+//
+// ray casting (beginRay, nextRayCell) steps cell by cell along the major axis of the ray with 16 fractional bits (DDA)
+
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+
+#include <inttypes.h>
+
+#define OCC_SHIFT         16      // ray casting fixed-point fractional bits
+#define OCC_PROBES        16      // max. probed slots per lookup
+#define OCC_FLAG_USED     0x80    // slot holds a cell
+#define OCC_FLAG_MARKED   0x40    // cell is marked as obstacle in map
+#define OCC_STATE_MASK    0x03    // map cell state before marking
+
+
+// fixed-point ray (cells, OCC_SHIFT fractional bits)
+struct occ_ray_t {
+  int32_t px;
+  int32_t py;
+  int32_t stepX;
+  int32_t stepY;
+  int steps;           // remaining steps
+};
+
+
+template <int N> class OccupancyGrid {
+
+public:
+
+    int cells;           // cells in table
+    long rejected;       // hits not stored (table full)
+    int8_t minLogOdds;
+    int8_t maxLogOdds;
+
+    OccupancyGrid() {
+        begin(-16, 48);
+    };
+
+    void begin(int8_t minValue, int8_t maxValue) {
+        minLogOdds = minValue;
+        maxLogOdds = maxValue;
+        clear();
+    };
+
+    void clear() {
+        cells = 0;
+        rejected = 0;
+        for (int i = 0; i < N; i++) entries[i].flags = 0;
+    };
+
+    // slot of cell or -1
+    int find(int cx, int cy) {
+        return slot(cx, cy, false);
+    };
+
+    // slot of cell (added with log-odds 0 if not in table) or -1 (table full)
+    int insert(int cx, int cy) {
+        int idx = slot(cx, cy, true);
+        if (idx < 0) rejected++;
+        return idx;
+    };
+
+    // add log-odds (clamped)
+    void add(int idx, int delta) {
+        int v = entries[idx].logOdds + delta;
+        entries[idx].logOdds = (v < minLogOdds) ? minLogOdds : ((v > maxLogOdds) ? maxLogOdds : v);
+    };
+
+    int logOdds(int idx) {
+        return entries[idx].logOdds;
+    };
+
+    bool isMarked(int idx) {
+        return (entries[idx].flags & OCC_FLAG_MARKED) != 0;
+    };
+
+    // map cell state before marking
+    uint8_t markedState(int idx) {
+        return entries[idx].flags & OCC_STATE_MASK;
+    };
+
+    void setMarked(int idx, bool marked, uint8_t state) {
+        entries[idx].flags = OCC_FLAG_USED | (marked ? OCC_FLAG_MARKED : 0) | (state & OCC_STATE_MASK);
+    };
+
+    int cellX(int idx) {
+        return entries[idx].x;
+    };
+
+    int cellY(int idx) {
+        return entries[idx].y;
+    };
+
+    // start ray at (x0,y0) in direction (dx,dy) (cells, direction normalized to 1) with given length (cells)
+    static void beginRay(occ_ray_t &ray, float x0, float y0, float dx, float dy, float length) {
+        float ax = (dx < 0) ? -dx : dx;
+        float ay = (dy < 0) ? -dy : dy;
+        float major = (ax > ay) ? ax : ay;
+        if (major <= 0) major = 1;
+        // one step per cell along major axis
+        ray.stepX = (int32_t)(dx / major * (1L << OCC_SHIFT));
+        ray.stepY = (int32_t)(dy / major * (1L << OCC_SHIFT));
+        ray.px = (int32_t)(x0 * (1L << OCC_SHIFT));
+        ray.py = (int32_t)(y0 * (1L << OCC_SHIFT));
+        ray.steps = (int)(length * major);
+    };
+
+    // next cell of ray (false: ray ended), ray.steps is 0 for the end cell
+    static bool nextRayCell(occ_ray_t &ray, int &cx, int &cy) {
+        if (ray.steps < 0) return false;
+        cx = ray.px >> OCC_SHIFT;
+        cy = ray.py >> OCC_SHIFT;
+        ray.px += ray.stepX;
+        ray.py += ray.stepY;
+        ray.steps--;
+        return true;
+    };
+
+protected:
+
+    struct entry_t {
+        int16_t x;
+        int16_t y;
+        int8_t logOdds;
+        uint8_t flags;       // 0: empty slot
+    };
+
+    entry_t entries[N];
+
+    bool isReusable(entry_t &e) {
+        return (e.logOdds <= 0) && ((e.flags & OCC_FLAG_MARKED) == 0);
+    };
+
+    // slot of cell (insert: allocate empty or reusable slot) or -1
+    int slot(int cx, int cy, bool insert) {
+        uint32_t h = ((uint32_t)cx) * 73856093u ^ ((uint32_t)cy) * 19349663u;
+        int idx = (h ^ (h >> 16)) & (N - 1);
+        int reuse = -1;
+        for (int p = 0; p < OCC_PROBES; p++) {
+            entry_t &e = entries[idx];
+            if (e.flags == 0) {
+                if (!insert) return -1;
+                if (reuse < 0) {
+                    cells++;
+                    reuse = idx;
+                }
+                break;
+            }
+            if ((e.x == cx) && (e.y == cy)) return idx;
+            if ((reuse < 0) && (isReusable(e))) reuse = idx;
+            idx = (idx + 1) & (N - 1);
+        }
+        if ((!insert) || (reuse < 0)) return -1;
+        entry_t &e = entries[reuse];
+        e.x = cx;
+        e.y = cy;
+        e.logOdds = 0;
+        e.flags = OCC_FLAG_USED;
+        return reuse;
+    };
+};
+
+
+#endif
@@ -0,0 +1,185 @@
+// weighted particle set with low-variance (systematic) resampling
+//
+// usage:
+//   ParticleFilter<float,500> filter;
+//   for (int i=0; i < filter.size(); i++) filter.weights[i] *= measurementProb(filter.x[i], filter.y[i]);
+//   float likelihood = filter.normalize();
+//   filter.resample(random01);   // only resamples if effective sample size is too low (or particle count changes)
+//
+// particle state (x, y, theta) is stored as structure of arrays (T: coordinate type), so that particle updates
+// are simple loops over each array
+//
+// resampling is done in place (no second particle buffer): each particle is assigned its number of copies,
+// particles without copies are overwritten by the extra copies of other particles
+//
+// KLD-sampling: the active particle count (size) adapts between minSize and maxSize (up to pool size N) - the number of 
+// histogram bins (x, y, theta) occupied by the resampled particles estimates the complexity of the belief, the particle
+// count is chosen so that the Kullback-Leibler distance of sampled and true belief stays below kldError 
+// (probability 1-delta, kldQuantile is the upper 1-delta quantile of the standard normal distribution)
+// http://papers.nips.cc/paper/1998-kld-sampling-adaptive-particle-filters.pdf
+
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <inttypes.h>
+#include <math.h>
+
+#define PARTICLES_KLD_HASH_BITS 1024  // occupied bins (hashed, collisions only underestimate the bin count)
+
+
+template <typename T, int N> class ParticleFilter {
+
+public:
+
+    T x[N];
+    T y[N];
+    float theta[N];          // heading offset to IMU yaw (rad)
+    float weights[N];        // normalized weights (sum is 1)
+    float effectiveSize;     // effective sample size (1..N) of current weights
+    float resampleThreshold; // resample if effective sample size drops below this fraction of N
+    unsigned long resampleCount;
+    int minSize;             // min. active particles
+    int maxSize;             // max. active particles (pool size N or less)
+    float kldError;          // max. KL distance of sampled to true belief
+    float kldQuantile;       // upper 1-delta quantile of standard normal distribution
+    float binScale;          // bins per coordinate unit (x, y)
+    float binScaleTheta;     // bins per rad (theta)
+    int kldBins;             // occupied bins at last resampling
+
+    ParticleFilter() {
+        resampleThreshold = 0.5;
+        resampleCount = 0;
+        minSize = N / 10;
+        maxSize = N;
+        kldError = 0.05;
+        kldQuantile = 2.33; // delta = 0.01
+        binScale = 2.0;
+        binScaleTheta = 20.0;
+        kldBins = 0;
+        count = N;
+        resetWeights();
+    };
+
+    // active particles
+    int size() {
+        return count;
+    };
+
+    // particle pool size
+    int capacity() {
+        return N;
+    };
+
+    // set active particles (particle state of new particles must be set by caller)
+    void setSize(int n) {
+        count = (n < minSize) ? minSize : ((n > maxSize) ? maxSize : n);
+        resetWeights();
+    };
+
+    void resetWeights() {
+        for (int i = 0; i < count; i++) weights[i] = 1.0 / count;
+        effectiveSize = count;
+    };
+
+    // particles required for k occupied bins (Wilson-Hilferty approximation of chi-square quantile)
+    int kldSize(int k) {
+        if (k < 2) return minSize;
+        float a = 2.0 / (9.0 * (k - 1));
+        float b = 1.0 - a + sqrt(a) * kldQuantile;
+        float n = ((float)(k - 1)) / (2.0 * kldError) * b * b * b;
+        if (n >= maxSize) return maxSize;
+        return ((int)n < minSize) ? minSize : (int)n;
+    };
+
+    // normalize weights (after multiplying them with the measurement probabilities) and compute the effective
+    // sample size - returns weight sum before normalization (measurement likelihood), if all weights are zero
+    // (measurement not possible for any particle) all weights are reset
+    float normalize() {
+        float sum = 0;
+        for (int i = 0; i < count; i++) sum += weights[i];
+        if (sum <= 0) {
+            resetWeights();
+            return 0;
+        }
+        float scale = 1.0 / sum;
+        float sqSum = 0;
+        for (int i = 0; i < count; i++) {
+            weights[i] *= scale;
+            sqSum += weights[i] * weights[i];
+        }
+        effectiveSize = 1.0 / sqSum;
+        return sum;
+    };
+
+    // systematic resampling (O(N) passes) if effective sample size is below threshold or if the KLD particle count
+    // differs from active count, rnd: random number in [0,1) - returns true if resampled
+    bool resample(float rnd) {
+        assignCopies(count, rnd);
+        kldBins = countBins();
+        int target = kldSize(kldBins);
+        if ((effectiveSize >= resampleThreshold * count) && (target <= count) && (target > count - count / 4)) return false;
+        if (target != count) assignCopies(target, rnd);
+        // distribute extra copies to the slots of particles without copies (slots 0..target-1), particles 
+        // in slots behind target are moved completely
+        for (int j = count; j < target; j++) copies[j] = 0;
+        int slot = 0;
+        for (int i = 0; i < ((count > target) ? count : target); i++) {
+            int keep = (i < target) ? 1 : 0;
+            while (copies[i] > keep) {
+                while (copies[slot] != 0) slot++;
+                x[slot] = x[i];
+                y[slot] = y[i];
+                theta[slot] = theta[i];
+                copies[slot] = 1;
+                copies[i]--;
+            }
+        }
+        count = target;
+        resetWeights();
+        resampleCount++;
+        return true;
+    };
+
+protected:
+
+    int count;                   // active particles
+    uint16_t copies[N];
+    uint32_t bins[PARTICLES_KLD_HASH_BITS / 32];
+
+    // number of copies of each active particle for n samples (systematic)
+    void assignCopies(int n, float rnd) {
+        float step = 1.0 / n;
+        float u = rnd * step;
+        float cumSum = weights[0];
+        int i = 0;
+        for (int j = 0; j < count; j++) copies[j] = 0;
+        for (int j = 0; j < n; j++) {
+            while ((u > cumSum) && (i < count - 1)) {
+                i++;
+                cumSum += weights[i];
+            }
+            copies[i]++;
+            u += step;
+        }
+    };
+
+    // occupied bins of particles with copies
+    int countBins() {
+        for (int i = 0; i < PARTICLES_KLD_HASH_BITS / 32; i++) bins[i] = 0;
+        int k = 0;
+        for (int i = 0; i < count; i++) {
+            if (copies[i] == 0) continue;
+            uint32_t h = ((uint32_t)((int32_t)floor(x[i] * binScale))) * 73856093u
+                         ^ ((uint32_t)((int32_t)floor(y[i] * binScale))) * 19349663u
+                         ^ ((uint32_t)((int32_t)floor(theta[i] * binScaleTheta))) * 83492791u;
+            h = (h ^ (h >> 16)) & (PARTICLES_KLD_HASH_BITS - 1);
+            if (bins[h >> 5] & (1u << (h & 31))) continue;
+            bins[h >> 5] |= 1u << (h & 31);
+            k++;
+        }
+        return k;
+    };
+};
+
+
+#endif
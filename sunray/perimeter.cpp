@@ -29,7 +29,7 @@ Private-use only! (you need to ask for a commercial-use)
 
 //#define pinLED 13
 
-PerimeterClass Perimeter;
+SUNRAY_INSTANCE PerimeterClass Perimeter;
 
 
 // developer test to be activated in mower.cpp: 
@@ -50,36 +50,43 @@ PerimeterClass Perimeter;
 #endif
 
 
+static bool corrPrepare(corr_code_t &c, const int8_t *H, int16_t M);
+
+
 PerimeterClass::PerimeterClass(){    
   enabled = true;
 	useDifferentialPerimeterSignal = true;
   swapCoilPolarity = false;
+  useSwarCorrelation = true;
+  codeCount = 0;
+  mainCode = NULL;
   timedOutIfBelowSmag = 10;
   timeOutSecIfNotInside = 15;
   callCounter = 0;
-  mag[0] = mag[1] = 0;
-  smoothMag[0] = smoothMag[1] = 0;
-  filterQuality[0] = filterQuality[1] = 0;
-  signalCounter[0] = signalCounter[1] = 0;  
-  lastInsideTime[0] = lastInsideTime[1] = 0;    
+  nextCoil = 0;
+  for (int idx=0; idx < PERIMETER_COILS; idx++){
+    idxPin[idx] = 0;
+    mag[idx] = 0;
+    smoothMag[idx] = 0;
+    filterQuality[idx] = 0;
+    signalCounter[idx] = 0;  
+    lastInsideTime[idx] = 0;    
+    rawHead[idx] = 0;
+    rawCount[idx] = 0;
+    for (int i=0; i < RAW_SIGNAL_CAPTURES; i++) rawCaptures[idx][i].samples = NULL;
+  }
+  rawFrozen = false;
 }
 
 void PerimeterClass::begin(byte idx0Pin, byte idx1Pin){
-  idxPin[0] = idx0Pin;
-  idxPin[1] = idx1Pin;  
-
   switch (ADCMan.sampleRate){
     case SRATE_9615: subSample = 1; break;
     case SRATE_19231: subSample = 2; break;
     case SRATE_38462: subSample = 4; break;
   }
   
-  // use max. 255 samples and multiple of signalsize
-  int adcSampleCount = sizeof sigcode_norm * subSample;
-  pinMode(idx0Pin, INPUT);
-  pinMode(idx1Pin, INPUT);
-  ADCMan.setupChannel(idx0Pin, ((int)255 / adcSampleCount) * adcSampleCount, true); 
-  ADCMan.setupChannel(idx1Pin, ((int)255 / adcSampleCount) * adcSampleCount, true); 
+  setupCoil(IDX_LEFT, idx0Pin);
+  setupCoil(IDX_RIGHT, idx1Pin);
  // ADCMan.setCapture(idx0Pin, adcSampleCount*2, true); 
  // ADCMan.setCapture(idx1Pin, adcSampleCount*2, true); 
   
@@ -91,35 +98,177 @@ void PerimeterClass::begin(byte idx0Pin, byte idx1Pin){
   DEBUGLN(ADCMan.getSampleCount(idx0Pin));  
 }
 
+// all coils use the same capture size (max. 255 samples and multiple of signalsize), ADCMan captures the 
+// channels one after the other
+void PerimeterClass::setupCoil(byte idx, byte pin){
+  if (idx >= PERIMETER_COILS) return;
+  int adcSampleCount = sizeof sigcode_norm * subSample;
+  idxPin[idx] = pin;
+  pinMode(pin, INPUT);
+  ADCMan.setupChannel(pin, ((int)255 / adcSampleCount) * adcSampleCount, true); 
+  // raw capture buffers (swapped with ADCMan sample buffer)
+  for (int i=0; i < RAW_SIGNAL_CAPTURES; i++){
+    raw_capture_t &c = rawCaptures[idx][i];
+    c.samples = (int8_t *)realloc(c.samples, ADCMan.getSampleCount(pin));
+    c.time = 0;
+    c.magnitude = 0;
+    c.quality = 0;
+  }
+  rawHead[idx] = 0;
+  rawCount[idx] = 0;
+}
+
+// matched filter benchmark: matched filter calls per second, correlation time of reference filter vs. box sum
+// kernel (corrFilter, scalar and SWAR) for random captures and captures of the signal code, all must give same 
+// magnitude and quality - correlation time of three registered codes (shared pass vs. corrFilter per code)
 void PerimeterClass::speedTest(){
   int loops = 0;
+  bool frozen = rawFrozen;
+  rawFrozen = true; // same capture filtered repeatedly: do not record
   unsigned long endTime = millis() + 1000;
   while (millis() < endTime){
     matchedFilter(0);
     loops++;
   }
+  rawFrozen = frozen;
   DEBUG(F("speedTest="));
   DEBUGLN(loops);
+  int16_t sigcode_size = sizeof sigcode_norm;
+  int8_t *sigcode = sigcode_norm;  
+  if (useDifferentialPerimeterSignal) sigcode = sigcode_diff;
+  int16_t sampleCount = ADCMan.getSampleCount(idxPin[0]);
+  int16_t nPts = sampleCount - sigcode_size * subSample;
+  int8_t *samples = new int8_t[sampleCount];
+  if (samples == NULL) return;
+  const int captures = 20;
+  unsigned long refTime = 0;
+  unsigned long boxTime = 0;
+  unsigned long swarTime = 0;
+  int errors = 0;
+  unsigned long codesTime = 0;
+  unsigned long perCodeTime = 0;
+  bool swar = useSwarCorrelation;
+  // registered codes: perimeter wire, the other signal code and the time-reversed signal code
+  int count = codeCount;
+  int8_t reversed[sizeof sigcode_norm];
+  for (int i=0; i < sigcode_size; i++) reversed[i] = sigcode[sigcode_size - 1 - i];
+  addCode((sigcode == sigcode_diff) ? sigcode_norm : sigcode_diff, sigcode_size);
+  addCode(reversed, sigcode_size);
+  for (int k=0; k < captures; k++){
+    // even: random, odd: signal code (random offset) with noise
+    int offset = random(sigcode_size * subSample);
+    for (int i=0; i < sampleCount; i++){
+      int v = random(-128, 128);
+      if (k & 1) v = v / 4 + sigcode[((i + offset) / subSample) % sigcode_size] * 90;
+      samples[i] = constrain(v, -128, 127);
+    }
+    float refQuality;
+    float boxQuality;
+    float swarQuality;
+    unsigned long startTime = micros();
+    int16_t refMag = corrFilterReference(sigcode, subSample, sigcode_size, samples, nPts, refQuality);
+    refTime += micros() - startTime;
+    useSwarCorrelation = false;
+    startTime = micros();
+    int16_t boxMag = corrFilter(sigcode, subSample, sigcode_size, samples, nPts, boxQuality);
+    boxTime += micros() - startTime;
+    useSwarCorrelation = true;
+    startTime = micros();
+    int16_t swarMag = corrFilter(sigcode, subSample, sigcode_size, samples, nPts, swarQuality);
+    swarTime += micros() - startTime;
+    if ((refMag != boxMag) || (memcmp(&refQuality, &boxQuality, sizeof refQuality) != 0)) errors++;
+    if ((refMag != swarMag) || (memcmp(&refQuality, &swarQuality, sizeof refQuality) != 0)) errors++;
+    startTime = micros();
+    corrCodes(0, samples, sampleCount);
+    codesTime += micros() - startTime;
+    for (int i=0; i < codeCount; i++){
+      float quality;
+      startTime = micros();
+      int16_t codeMagnitude = corrFilter(codes[i].H, subSample, codes[i].M, samples, sampleCount - codes[i].M * subSample, quality);
+      perCodeTime += micros() - startTime;
+      if ((codeMagnitude != codeMag[0][i]) || (memcmp(&quality, &codeQuality[0][i], sizeof quality) != 0)) errors++;
+    }
+  }
+  int16_t timedCodes = codeCount;
+  codeCount = count;
+  useSwarCorrelation = swar;
+  delete[] samples;
+  DEBUG(F("corrFilter samples="));
+  DEBUG(sampleCount);
+  DEBUG(F(" subSample="));
+  DEBUG((int)subSample);
+  DEBUG(F(" reference(us)="));
+  DEBUG(((float)refTime) / captures);
+  DEBUG(F(" boxsum(us)="));
+  DEBUG(((float)boxTime) / captures);
+  DEBUG(F(" swar(us)="));
+  DEBUG(((float)swarTime) / captures);
+  DEBUG(F(" codes="));
+  DEBUG(timedCodes);
+  DEBUG(F(" codes shared(us)="));
+  DEBUG(((float)codesTime) / captures);
+  DEBUG(F(" per code(us)="));
+  DEBUG(((float)perCodeTime) / captures);
+  DEBUG(F(" errors="));
+  DEBUGLN(errors);
 }
 
 const int8_t* PerimeterClass::getRawSignalSample(byte idx) {
-  //return rawSignalSample[idx];
-  return NULL;
+  const raw_capture_t *c = getRawCapture(idx, 0);
+  if (c == NULL) return NULL;
+  return c->samples;
+}
+
+int PerimeterClass::getRawCaptureCount(byte idx){
+  return rawCount[idx];
+}
+
+const raw_capture_t* PerimeterClass::getRawCapture(byte idx, int age){
+  if ((idx >= PERIMETER_COILS) || (age < 0) || (age >= rawCount[idx])) return NULL;
+  return &rawCaptures[idx][(rawHead[idx] + RAW_SIGNAL_CAPTURES - 1 - age) % RAW_SIGNAL_CAPTURES];
+}
+
+int PerimeterClass::getRawCaptureSize(){
+  return ADCMan.getSampleCount(idxPin[0]);
+}
+
+void PerimeterClass::freezeRawCaptures(bool freeze){
+  rawFrozen = freeze;
 }
 
+// keep completed capture without copying: the ADCMan sample buffer becomes the newest ring slot, the buffer of
+// the oldest slot is given to ADCMan for the next capture (must be called before restartConv)
+void PerimeterClass::recordCapture(byte idx){
+  if (rawFrozen) return;
+  raw_capture_t &c = rawCaptures[idx][rawHead[idx]];
+  if (c.samples == NULL) return;
+  c.samples = ADCMan.swapSamples(idxPin[idx], c.samples);
+  c.time = millis();
+  c.magnitude = mag[idx];
+  c.quality = filterQuality[idx];
+  rawHead[idx] = (rawHead[idx] + 1) % RAW_SIGNAL_CAPTURES;
+  if (rawCount[idx] < RAW_SIGNAL_CAPTURES) rawCount[idx]++;
+}
+
+// one completed capture per call, coils are checked round-robin (starting after the last processed coil) so 
+// the loop time does not grow with the coil count and no coil is starved by the others
 void PerimeterClass::run(){
   if (!enabled) return;
-	for (int idx=0; idx < 2; idx++){
+	for (int i=0; i < PERIMETER_COILS; i++){
+    byte idx = nextCoil;
+    nextCoil++;
+    if (nextCoil == PERIMETER_COILS) nextCoil = 0;
     if (ADCMan.isConvComplete(idxPin[idx])) {
-     // Keep a sample of the raw signal
-      //memset(rawSignalSample[0], 0, RAW_SIGNAL_SAMPLE_SIZE);
-      //memcpy(rawSignalSample[0], ADCMan.getCapture(idxPin[0]), min(ADCMan.getCaptureSize(idxPin[0]), RAW_SIGNAL_SAMPLE_SIZE));
-      // Process signal
+      // Process signal (raw capture is kept by matchedFilter)
       matchedFilter(idx);
+      break;
     }
   }
 	if (!isInside(IDX_LEFT)) Robot.sensorTriggered(SEN_PERIMETER_LEFT);
   if (!isInside(IDX_RIGHT)) Robot.sensorTriggered(SEN_PERIMETER_RIGHT);
+#if PERIMETER_COILS > 2
+  if (!isInside(IDX_CENTER)) Robot.sensorTriggered(SEN_PERIMETER_CENTER);
+#endif
 }
 
 int PerimeterClass::getMagnitude(byte idx){  
@@ -165,7 +314,15 @@ void PerimeterClass::matchedFilter(byte idx){
   int16_t sigcode_size = sizeof sigcode_norm;
   int8_t *sigcode = sigcode_norm;  
   if (useDifferentialPerimeterSignal) sigcode = sigcode_diff;
-  mag[idx] = corrFilter(sigcode, subSample, sigcode_size, samples, sampleCount-sigcode_size*subSample, filterQuality[idx]);
+  if (mainCode != sigcode) {
+    // code 0: perimeter wire
+    mainCode = sigcode;
+    corrPrepare(codes[0], sigcode, sigcode_size);
+    codeCount = max(codeCount, 1);
+  }
+  corrCodes(idx, samples, sampleCount);
+  mag[idx] = codeMag[idx][0];
+  filterQuality[idx] = codeQuality[idx][0];
   if (swapCoilPolarity) mag[idx] *= -1;        
   // smoothed magnitude used for signal-off detection
   smoothMag[idx] = 0.99 * smoothMag[idx] + 0.01 * ((float)abs(mag[idx]));
@@ -180,13 +337,13 @@ void PerimeterClass::matchedFilter(byte idx){
     lastInsideTime[idx] = millis();
   } 
     
+  recordCapture(idx);
   ADCMan.restartConv(idxPin[idx]);    
   if (idx == 0) callCounter++;
 }
 
 void PerimeterClass::resetTimedOut(){
-  lastInsideTime[0] = millis();
-  lastInsideTime[1] = millis();
+  for (int idx=0; idx < PERIMETER_COILS; idx++) lastInsideTime[idx] = millis();
 }
 
 int16_t PerimeterClass::getSignalMin(byte idx){
@@ -206,8 +363,12 @@ float PerimeterClass::getFilterQuality(byte idx){
   return filterQuality[idx];
 }
 
+// all coils inside
 boolean PerimeterClass::isInside(){
-  return (isInside(IDX_LEFT) && isInside(IDX_RIGHT));  
+  for (int i=0; i < PERIMETER_COILS; i++){
+    if (!isInside(i)) return false;
+  }
+  return true;
 }
 
 boolean PerimeterClass::isInside(byte idx){
@@ -221,26 +382,274 @@ boolean PerimeterClass::isInside(byte idx){
   }
 }
 
+// all coils timed out
 bool PerimeterClass::signalTimedOut(){
-  return (signalTimedOut(IDX_LEFT) && signalTimedOut(IDX_RIGHT));  
+  for (int i=0; i < PERIMETER_COILS; i++){
+    if (!signalTimedOut(i)) return false;
+  }
+  return true;
 }
 
 
 boolean PerimeterClass::signalTimedOut(byte idx){
   if (getSmoothMagnitude(idx) < timedOutIfBelowSmag) return true;
-  if (millis() - lastInsideTime[idx] > timeOutSecIfNotInside * 1000) return true;
+  if (millis() - lastInsideTime[idx] > (unsigned long)timeOutSecIfNotInside * 1000) return true;
   return false;
 }
 
 
+// correlation result: normalize min/max correlation sum to 4095, magnitude is the larger one, quality the ratio 
+// of larger to smaller
+static int16_t corrResult(int16_t sumMin, int16_t sumMax, int16_t Hsum, float &quality){
+  // normalize to 4095
+  sumMin = ((float)sumMin) / ((float)(Hsum*127)) * 4095.0;
+  sumMax = ((float)sumMax) / ((float)(Hsum*127)) * 4095.0;
+  
+  // compute ratio min/max 
+  if (sumMax > -sumMin) {
+    quality = ((float)sumMax) / ((float)-sumMin);
+    return sumMax;
+  } else {
+    quality = ((float)-sumMin) / ((float)sumMax);
+    return sumMin;
+  }  
+}
+
 // digital matched filter (cross correlation)
 // http://en.wikipedia.org/wiki/Cross-correlation
 // H[] holds the double sided filter coeffs, M = H.length (number of points in FIR)
 // subsample is the number of times for each filter coeff to repeat 
 // ip[] holds input data (length > nPts + M )
 // nPts is the length of the required output data 
+//
+// each filter coeff is repeated subsample times, so the correlation is computed from sliding box sums of subsample
+// inputs (one add and subtract per input) and only the non-zero coeffs: O(nPts * M) instead of 
+// O(nPts * M * subsample) multiply-adds - same result as corrFilterReference (integer sums, no rounding)
+//
+// SWAR kernel (filter coeffs -1/0/1, useSwarCorrelation): two neighbouring box sums are packed into one 32 bit 
+// word (16 bit lanes, offset by 128*subsample so lanes are never negative), so each add computes two correlation
+// sums - tap sets are summed separately (no borrow between lanes), the lane sums must fit 16 bits (otherwise 
+// the scalar kernel is used)
+//
+// window sums: W = sum of all M box sums of a correlation (sliding, two word operations per output), then 
+// P - N = 2P + Z - W = W - Z - 2N (P, N, Z: sums of box sums at positive, negative and zero coeffs), so only taps
+// of one sign and the zero taps are summed - used if that is cheaper (e.g. codes without zero coeffs), the window
+// sums are shared by all codes of same length
+
+static SUNRAY_INSTANCE uint32_t corrPacked[CORR_BOX_SUMS_MAX];   // box sums t, t+1 (lanes)
+static SUNRAY_INSTANCE uint32_t corrWindows[CORR_BOX_SUMS_MAX];  // window sums j, j+1 (lanes)
+
+// prepare signal code for correlation kernels - returns false if code is too long
+static bool corrPrepare(corr_code_t &c, const int8_t *H, int16_t M){
+  if ((M <= 0) || (M > CORR_TAPS_MAX)) return false;
+  int16_t pos = 0;
+  int16_t neg = 0;
+  c.M = M;
+  c.Hsum = 0;
+  c.unitCoeffs = true;
+  c.nonZero = 0;
+  for (int16_t i=0; i<M; i++) {
+    c.H[i] = H[i];
+    c.Hsum += abs(H[i]);
+    if (H[i] == 0) continue;
+    if ((H[i] != 1) && (H[i] != -1)) c.unitCoeffs = false;
+    if (H[i] > 0) pos++;
+      else neg++;
+    c.nonZeroTaps[c.nonZero++] = i;
+  }
+  // SWAR tap sets: positive and negative taps, or (window sums) taps of the less frequent sign and zero taps 
+  int16_t zero = M - pos - neg;
+  c.window = (min(pos, neg) + zero < pos + neg);
+  c.sign = ((!c.window) || (pos <= neg)) ? 1 : -1;
+  c.countA = 0;
+  c.countB = 0;
+  int8_t setB[CORR_TAPS_MAX];
+  for (int16_t i=0; i<M; i++) {
+    if (H[i] == c.sign) c.taps[c.countA++] = i;
+      else if ( ((!c.window) && (H[i] != 0)) || ((c.window) && (H[i] == 0)) ) setB[c.countB++] = i;
+  }
+  for (int16_t k=0; k<c.countB; k++) c.taps[c.countA + k] = setB[k];
+  return true;
+}
+
+// packed box sums of input: corrPacked[t] = box sum t (low lane), box sum t+1 (high lane), box sum t is 
+// ip[t] + ... + ip[t+subsample-1] + 128*subsample
+static void corrPack(int8_t *ip, int8_t subsample, int16_t boxCount){
+  if (boxCount <= 0) return;
+  int16_t bias = 128 * subsample;
+  int16_t box = 0;
+  for (int16_t i=0; i<subsample; i++) box += ip[i];
+  corrPacked[0] = box + bias;
+  for (int16_t t=1; t<boxCount; t++) {
+    box += ip[t + subsample - 1] - ip[t - 1];
+    uint32_t lane = box + bias;
+    corrPacked[t - 1] |= lane << 16;
+    corrPacked[t] = lane;
+  }
+}
+
+// packed window sums for codes of length M: corrWindows[j] = sum of packed box sums j + k*subsample (k < M)
+static void corrWindow(int16_t M, int8_t subsample, int16_t nPts){
+  for (int16_t j=0; (j<subsample) && (j<nPts); j++) {
+    uint32_t w = 0;
+    for (int16_t k=0; k<M; k++) w += corrPacked[j + k * subsample];
+    corrWindows[j] = w;
+  }
+  int16_t Ms = M * subsample;
+  for (int16_t j=subsample; j<nPts; j++) corrWindows[j] = corrWindows[j - subsample] - corrPacked[j - subsample] + corrPacked[j - subsample + Ms];
+}
+
+// SWAR kernel usable for code (lane sums fit 16 bits)
+static bool corrSwarUsable(const corr_code_t &c, int8_t subsample){
+  return (c.unitCoeffs) && (((int32_t)c.M) * 256 * subsample < 65536);
+}
+
+// min/max of correlation sum (16 bit, wraps like the sum of corrFilterReference)
+static inline void corrMinMax(int32_t sum, int16_t &sumMin, int16_t &sumMax){
+  int16_t sum16 = (int16_t)sum;
+  if (sum16 > sumMax) sumMax = sum16;
+  if (sum16 < sumMin) sumMin = sum16;
+}
+
+// min/max correlation sum of code on packed box sums (and window sums)
+static void corrSums(const corr_code_t &c, int8_t subsample, int16_t nPts, bool swar, int16_t &sumMin, int16_t &sumMax){
+  int32_t bias = 128 * subsample;
+  int16_t off[CORR_TAPS_MAX];
+  sumMin = 0;
+  sumMax = 0;
+  if (!swar) {
+    // scalar: non-zero coeffs on low lanes
+    int8_t coeff[CORR_TAPS_MAX];
+    int32_t coeffSum = 0;
+    for (int16_t k=0; k<c.nonZero; k++) {
+      off[k] = c.nonZeroTaps[k] * subsample;
+      coeff[k] = c.H[c.nonZeroTaps[k]];
+      coeffSum += coeff[k];
+    }
+    for (int16_t j=0; j<nPts; j++) {
+      uint32_t *w = corrPacked + j;
+      int32_t sum = -bias * coeffSum;
+      for (int16_t k=0; k<c.nonZero; k++) sum += ((int32_t)coeff[k]) * ((int32_t)(w[off[k]] & 0xFFFF));
+      corrMinMax(sum, sumMin, sumMax);
+    }
+    return;
+  }
+  int16_t taps = c.countA + c.countB;
+  for (int16_t k=0; k<taps; k++) off[k] = c.taps[k] * subsample;
+  // two correlation sums (j, j+1) per iteration
+  if (!c.window) {
+    // P - N (tap set A: positive, B: negative)
+    int32_t offset = -bias * (c.countA - c.countB);
+    for (int16_t j=0; j<nPts; j+=2) {
+      uint32_t *w = corrPacked + j;
+      uint32_t a = 0;
+      uint32_t b = 0;
+      for (int16_t k=0; k<c.countA; k++) a += w[off[k]];
+      for (int16_t k=c.countA; k<taps; k++) b += w[off[k]];
+      corrMinMax(((int32_t)(a & 0xFFFF)) - ((int32_t)(b & 0xFFFF)) + offset, sumMin, sumMax);
+      if (j + 1 == nPts) break;
+      corrMinMax(((int32_t)(a >> 16)) - ((int32_t)(b >> 16)) + offset, sumMin, sumMax);
+    }
+    return;
+  }
+  // sign * (2A + Z - W) (tap set A: coeffs of sign, B: zero coeffs)
+  int32_t offset = bias * (c.M - 2 * c.countA - c.countB);
+  for (int16_t j=0; j<nPts; j+=2) {
+    uint32_t *w = corrPacked + j;
+    uint32_t a = 0;
+    uint32_t b = 0;
+    for (int16_t k=0; k<c.countA; k++) a += w[off[k]];
+    for (int16_t k=c.countA; k<taps; k++) b += w[off[k]];
+    uint32_t win = corrWindows[j];
+    int32_t sum = 2 * ((int32_t)(a & 0xFFFF)) + ((int32_t)(b & 0xFFFF)) - ((int32_t)(win & 0xFFFF)) + offset;
+    corrMinMax(c.sign * sum, sumMin, sumMax);
+    if (j + 1 == nPts) break;
+    sum = 2 * ((int32_t)(a >> 16)) + ((int32_t)(b >> 16)) - ((int32_t)(win >> 16)) + offset;
+    corrMinMax(c.sign * sum, sumMin, sumMax);
+  }
+}
 
 int16_t PerimeterClass::corrFilter(int8_t *H, int8_t subsample, int16_t M, int8_t *ip, int16_t nPts, float &quality){  
+  int16_t boxCount = nPts + (M - 1) * subsample; // box sums used by correlation
+  corr_code_t c;
+  if ((boxCount > CORR_BOX_SUMS_MAX) || (!corrPrepare(c, H, M))) return corrFilterReference(H, subsample, M, ip, nPts, quality);
+  int16_t sumMax; // max correlation sum
+  int16_t sumMin; // min correlation sum
+  bool swar = (useSwarCorrelation) && (corrSwarUsable(c, subsample));
+  if (nPts > 0) {
+    corrPack(ip, subsample, boxCount);
+    if ((swar) && (c.window)) corrWindow(M, subsample, nPts);
+  }
+  corrSums(c, subsample, nPts, swar, sumMin, sumMax);
+  return corrResult(sumMin, sumMax, c.Hsum * subsample, quality);
+}
+
+// correlation of capture with all registered codes (one pass for box sums, window sums shared by codes of same 
+// length) - magnitude and quality per code
+void PerimeterClass::corrCodes(byte idx, int8_t *ip, int16_t sampleCount){
+  int16_t boxCount = sampleCount - subSample; // box sums used by correlation (same for all codes)
+  bool packed = false;
+  int16_t windowM = 0; // code length of current window sums
+  for (int i=0; i < codeCount; i++){
+    corr_code_t &c = codes[i];
+    int16_t nPts = sampleCount - c.M * subSample;
+    if (boxCount > CORR_BOX_SUMS_MAX) {
+      codeMag[idx][i] = corrFilterReference(c.H, subSample, c.M, ip, nPts, codeQuality[idx][i]);
+      continue;
+    }
+    int16_t sumMin;
+    int16_t sumMax;
+    bool swar = (useSwarCorrelation) && (corrSwarUsable(c, subSample));
+    if (nPts > 0) {
+      if (!packed) corrPack(ip, subSample, boxCount);
+      packed = true;
+      if ((swar) && (c.window) && (windowM != c.M)) {
+        corrWindow(c.M, subSample, nPts);
+        windowM = c.M;
+      }
+    }
+    corrSums(c, subSample, nPts, swar, sumMin, sumMax);
+    codeMag[idx][i] = corrResult(sumMin, sumMax, c.Hsum * subSample, codeQuality[idx][i]);
+  }
+}
+
+// register signal code (e.g. exclusion island or docking guide wire), code 0 is the perimeter wire code - returns 
+// code index or -1 (no free code or code too long)
+int PerimeterClass::addCode(const int8_t *code, int16_t size){
+  if (codeCount >= PERIMETER_CODES_MAX) return -1;
+  if (!corrPrepare(codes[codeCount], code, size)) return -1;
+  for (int i=0; i < PERIMETER_COILS; i++){
+    codeMag[i][codeCount] = 0;
+    codeQuality[i][codeCount] = 0;
+  }
+  codeCount++;
+  return codeCount - 1;
+}
+
+// remove registered codes (except perimeter wire code)
+void PerimeterClass::clearCodes(){
+  codeCount = min(codeCount, 1);
+}
+
+int PerimeterClass::getCodeCount(){
+  return codeCount;
+}
+
+int16_t PerimeterClass::getCodeSize(int code){
+  return codes[code].M;
+}
+
+int16_t PerimeterClass::getCodeMagnitude(byte idx, int code){
+  return codeMag[idx][code];
+}
+
+float PerimeterClass::getCodeFilterQuality(byte idx, int code){
+  return codeQuality[idx][code];
+}
+
+// digital matched filter (cross correlation): multiply-add per filter coeff and subsample (used for large 
+// captures and to verify corrFilter)
+int16_t PerimeterClass::corrFilterReference(int8_t *H, int8_t subsample, int16_t M, int8_t *ip, int16_t nPts, float &quality){  
   int16_t sumMax = 0; // max correlation sum
   int16_t sumMin = 0; // min correlation sum
   int16_t Ms = M * subsample; // number of filter coeffs including subsampling
@@ -273,18 +682,7 @@ int16_t PerimeterClass::corrFilter(int8_t *H, int8_t subsample, int16_t M, int8_
       if (sum < sumMin) sumMin = sum;
       ip++;
   }      
-  // normalize to 4095
-  sumMin = ((float)sumMin) / ((float)(Hsum*127)) * 4095.0;
-  sumMax = ((float)sumMax) / ((float)(Hsum*127)) * 4095.0;
-  
-  // compute ratio min/max 
-  if (sumMax > -sumMin) {
-    quality = ((float)sumMax) / ((float)-sumMin);
-    return sumMax;
-  } else {
-    quality = ((float)-sumMin) / ((float)sumMax);
-    return sumMin;
-  }  
+  return corrResult(sumMin, sumMax, Hsum, quality);
 }
 
 
@@ -1,25 +1,73 @@
 // Ardumower perimeter receiver (in/out detection and magnitude)
-// for 2 coils, using PRN signal code correlation
+// for PERIMETER_COILS coils (left, right, optional center), using PRN signal code correlation
 
 #ifndef PERIMETER_H
 #define PERIMETER_H
 
 #include <Arduino.h>
+#include "instance.h"
 
-//#define RAW_SIGNAL_SAMPLE_SIZE 32
+#define RAW_SIGNAL_CAPTURES 4   // raw captures kept per coil (ring buffer)
+
+#define PERIMETER_COILS 2   // receiver coils (2: left, right - 3: additional center coil)
 
 #define IDX_LEFT   0
-#define IDX_CENTER 0
 #define IDX_RIGHT  1
+#if PERIMETER_COILS > 2
+  #define IDX_CENTER 2
+#else
+  #define IDX_CENTER 0
+#endif
+
+#define CORR_BOX_SUMS_MAX  256   // correlation kernel: max. box sums (input samples)
+#define CORR_TAPS_MAX      32    // correlation kernel: max. filter coeffs
+#define PERIMETER_CODES_MAX 4     // registered signal codes (code 0: perimeter wire)
+
+
+// raw capture of a coil (ADC sample buffer taken over from ADCMan, see recordCapture)
+struct raw_capture_t {
+  int8_t *samples;             // NULL: no buffer
+  unsigned long time;          // capture time (ms)
+  int16_t magnitude;           // matched filter magnitude of capture
+  float quality;               // matched filter quality of capture
+};
+
+typedef struct raw_capture_t raw_capture_t;
+
+
+// signal code prepared for the correlation kernels (see corrFilter)
+struct corr_code_t {
+  int8_t H[CORR_TAPS_MAX];     // filter coeffs
+  int16_t M;                   // number of filter coeffs
+  int16_t Hsum;                // sum of absolute filter coeffs
+  bool unitCoeffs;             // all coeffs -1/0/1 (SWAR kernel)
+  bool window;                 // SWAR: taps of one sign and zero taps with window sums (otherwise positive and negative taps)
+  int8_t sign;                 // SWAR: sign of first tap set
+  int16_t countA;              // SWAR: taps of first set
+  int16_t countB;              // SWAR: taps of second set
+  int8_t taps[CORR_TAPS_MAX];  // SWAR: coeff index of first set, then second set
+  int16_t nonZero;             // scalar: non-zero coeffs
+  int8_t nonZeroTaps[CORR_TAPS_MAX]; // scalar: coeff index
+};
+
+typedef struct corr_code_t corr_code_t;
 
 
 class PerimeterClass
 {
   public:
     PerimeterClass();
-    // set ADC pins
+    // set ADC pins (left and right coil)
 	  void begin(byte idx0Pin, byte idx1Pin);
+    // set ADC pin of coil (e.g. IDX_CENTER)
+    void setupCoil(byte idx, byte pin);
+    // newest raw capture of coil or NULL
     const int8_t* getRawSignalSample(byte idx);
+    // raw captures (age 0: newest), frozen captures are not overwritten (e.g. while streaming)
+    int getRawCaptureCount(byte idx);
+    const raw_capture_t* getRawCapture(byte idx, int age);
+    int getRawCaptureSize();
+    void freezeRawCaptures(bool freeze);
     // get perimeter magnitude
     int getMagnitude(byte idx);    
     int getSmoothMagnitude(byte idx);
@@ -35,6 +83,13 @@ class PerimeterClass
     int16_t getSignalMax(byte idx);    
     int16_t getSignalAvg(byte idx);
     float getFilterQuality(byte idx); 
+    // additional signal codes (e.g. exclusion island, docking guide wire): magnitude and quality per code
+    int addCode(const int8_t *code, int16_t size);
+    void clearCodes();
+    int getCodeCount();
+    int16_t getCodeSize(int code);
+    int16_t getCodeMagnitude(byte idx, int code);
+    float getCodeFilterQuality(byte idx, int code);
     void speedTest();
     void run();
     int16_t timedOutIfBelowSmag;
@@ -43,25 +98,39 @@ class PerimeterClass
     bool useDifferentialPerimeterSignal;
     // swap coil polarity?
     bool swapCoilPolarity;  
+    // use SWAR correlation kernel (packed box sums) for -1/0/1 signal codes?
+    bool useSwarCorrelation;
     char subSample;  	
   private:
-    unsigned long lastInsideTime[2];
-    byte idxPin[2]; // channel for idx
+    unsigned long lastInsideTime[PERIMETER_COILS];
+    byte idxPin[PERIMETER_COILS]; // channel for idx
+    byte nextCoil; // coil checked first in run (round-robin)
     int callCounter;
-    int16_t mag [2]; // perimeter magnitude per channel
-    float smoothMag[2];
-    float filterQuality[2];
-    int16_t signalMin[2];
-    int16_t signalMax[2];
-    int16_t signalAvg[2];    
-    int signalCounter[2];    
-    //int8_t rawSignalSample[2][RAW_SIGNAL_SAMPLE_SIZE];
+    int16_t mag [PERIMETER_COILS]; // perimeter magnitude per channel
+    float smoothMag[PERIMETER_COILS];
+    float filterQuality[PERIMETER_COILS];
+    int16_t signalMin[PERIMETER_COILS];
+    int16_t signalMax[PERIMETER_COILS];
+    int16_t signalAvg[PERIMETER_COILS];    
+    int signalCounter[PERIMETER_COILS];    
+    corr_code_t codes[PERIMETER_CODES_MAX]; // registered signal codes
+    int codeCount;
+    const int8_t *mainCode; // signal code of code 0
+    int16_t codeMag[PERIMETER_COILS][PERIMETER_CODES_MAX];
+    float codeQuality[PERIMETER_COILS][PERIMETER_CODES_MAX];
+    raw_capture_t rawCaptures[PERIMETER_COILS][RAW_SIGNAL_CAPTURES];
+    byte rawHead[PERIMETER_COILS];  // next slot
+    byte rawCount[PERIMETER_COILS];
+    bool rawFrozen;
+    void recordCapture(byte idx);
     void matchedFilter(byte idx);
     int16_t corrFilter(int8_t *H, int8_t subsample, int16_t M, int8_t *ip, int16_t nPts, float &quality);
+    void corrCodes(byte idx, int8_t *ip, int16_t sampleCount);
+    int16_t corrFilterReference(int8_t *H, int8_t subsample, int16_t M, int8_t *ip, int16_t nPts, float &quality);
     void printADCMinMax(int8_t *samples);
 };
 
-extern PerimeterClass Perimeter;
+extern SUNRAY_INSTANCE PerimeterClass Perimeter;
 
 #endif
 
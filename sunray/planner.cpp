@@ -0,0 +1,956 @@
+/*
+License
+Copyright (c) 2013-2017 by Alexander Grau
+
+Private-use only! (you need to ask for a commercial-use)
+
+The code is open: you can modify it under the terms of the
+GNU General Public License as published by the Free Software Foundation,
+either version 3 of the License, or (at your option) any later version.
+
+The code is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Private-use only! (you need to ask for a commercial-use)
+
+ */
+
+#include "planner.h"
+#include "robot.h"
+#include "motor.h"
+#include "config.h"
+#include "helper.h"
+
+SUNRAY_INSTANCE PlannerClass Planner;
+
+static_assert(sizeof(PlannerClass) <= PLANNER_RAM_BUDGET, "PlannerClass exceeds RAM budget");
+
+static SUNRAY_INSTANCE int pathCells = 1; // map cells per planning cell
+static SUNRAY_INSTANCE int pathClearance = 1;
+
+// planning grid for current map resolution (cell size doubled per level, halved per negative level down to map cells)
+static void setPathGrid(int level) {
+  int cells = max(1, (int)(PLANNER_PATH_CELL_SIZE * Map.mapScaleX + 0.5));
+  pathCells = (level < 0) ? max(1, cells >> -level) : cells << level;
+  pathClearance = max(1, (int)ceil(PLANNER_PATH_CLEARANCE * Map.mapScaleX));
+}
+
+// cost factor of planning cell (0: blocked)
+static uint8_t pathCellCost(int px, int py) {
+  MapClass &map = Map;
+  uint8_t cost = PLANNER_COST_MOWED;
+  int x0 = px * pathCells;
+  int y0 = py * pathCells;
+  if ((pathClearance == 1) && ((MAP_TILE_SIZE % pathCells) == 0) && (x0 >= 0) && (y0 >= 0)
+      && (x0 + pathCells <= map.mapSizeX) && (y0 + pathCells <= map.mapSizeY)) {
+    // planning cell within tile columns: compare map rows of all layers (no clearance around cells)
+    uint16_t mask = ((1UL << pathCells) - 1) << (x0 & MAP_TILE_MASK);
+    for (int yp = y0; yp < y0 + pathCells; yp++) {
+      int row = map.mapSizeY - 1 - yp;
+      int tileIdx = (row >> MAP_TILE_BITS) * map.mapTilesX + (x0 >> MAP_TILE_BITS);
+      int r = row & MAP_TILE_MASK;
+      if ((map.getMapRow(MAP_LAYER_SIDE, tileIdx, r) | map.getMapRow(MAP_LAYER_OBSTACLE, tileIdx, r)) & mask) return 0;
+      if ((map.getMapRow(MAP_LAYER_MOWED, tileIdx, r) & mask) != mask) cost = PLANNER_COST_UNMOWED;
+    }
+    return cost;
+  }
+  for (int j = 0; j < pathCells; j++) {
+    for (int i = 0; i < pathCells; i++) {
+      int xp = px * pathCells + i;
+      int yp = py * pathCells + j;
+      if (!PlannerClass::isMowableCell(xp, yp, pathClearance)) return 0;
+      if (Map.getMapCell(xp, Map.mapSizeY - 1 - yp).s.state == MAP_DATA_STATE_UNMOWED) cost = PLANNER_COST_UNMOWED;
+    }
+  }
+  return cost;
+}
+
+
+void PlannerClass::begin() {
+  laneAngle = 0;
+  laneDistance = MAP_CUTTING_WIDTH - PLANNER_LANE_OVERLAP;
+  laneOffsetMin = 0;
+  search.begin(pathCellCost, PLANNER_COST_MOWED, PLANNER_PATH_EXPANSIONS);
+  clear();
+}
+
+void PlannerClass::clear() {
+  segmentCount = 0;
+  cellCount = 0;
+  routeIndex = 0;
+  routeLength = 0;
+  transitLength = 0;
+  skippedCount = 0;
+  trailCount = 0;
+  pathCount = 0;
+  pathIndex = 0;
+  pathLevel = 0;
+  pathReplan = false;
+}
+
+// cell can be mowed: inside perimeter, no obstacle, at least clearance cells away from perimeter wire
+bool PlannerClass::isMowable(float x, float y, int clearance) {
+  if ((x < 0) || (y < 0)) return false;
+  return isMowableCell((int)(x * Map.mapScaleX), (int)(y * Map.mapScaleY), clearance);
+}
+
+bool PlannerClass::isMowableCell(int xp, int yp, int clearance) {
+  if ((xp < 0) || (yp < 0) || (xp >= Map.mapSizeX) || (yp >= Map.mapSizeY)) return false;
+  int row = Map.mapSizeY - 1 - yp;
+  if (Map.getMapBit(MAP_LAYER_OBSTACLE, xp, row)) return false;
+  return Map.isInside(xp, row, max(0, clearance - 1));
+}
+
+// position t (meter along lane direction) on lane
+void PlannerClass::lanePoint(int lane, float t, point_t &pt) {
+  float s = laneOffsetMin + ((float)lane) * laneDistance;
+  float dx = cos(laneAngle);
+  float dy = sin(laneAngle);
+  pt.x = -s * dy + t * dx;
+  pt.y = s * dx + t * dy;
+}
+
+// plan boustrophedon lanes (lane direction in map frame) - returns number of lane segments
+int PlannerClass::planLanes(float angle) {
+  clear();
+  if ((!Map.mapValid) || (Map.mapScaleX <= 0)) return 0;
+  laneAngle = angle;
+  laneDistance = max(0.05, Map.cuttingWidth - PLANNER_LANE_OVERLAP);
+  float cellSize = 1.0 / Map.mapScaleX;
+  int clearance = (int)ceil(PLANNER_WIRE_CLEARANCE / cellSize);
+  float dx = cos(laneAngle);
+  float dy = sin(laneAngle);
+  // map extent along lane normal (s) and lane direction (t)
+  float w = ((float)Map.mapSizeX) * cellSize;
+  float h = ((float)Map.mapSizeY) * cellSize;
+  float cornersX[] = { 0, w, 0, w };
+  float cornersY[] = { 0, 0, h, h };
+  float smin = 9999;
+  float smax = -9999;
+  float tmin = 9999;
+  float tmax = -9999;
+  for (int i = 0; i < 4; i++) {
+    float s = -cornersX[i] * dy + cornersY[i] * dx;
+    float t = cornersX[i] * dx + cornersY[i] * dy;
+    smin = min(smin, s);
+    smax = max(smax, s);
+    tmin = min(tmin, t);
+    tmax = max(tmax, t);
+  }
+  laneOffsetMin = smin + laneDistance / 2;
+  int lanes = (int)((smax - smin) / laneDistance);
+  float step = cellSize / 2;
+  point_t pt;
+  for (int lane = 0; (lane < lanes) && (segmentCount < PLANNER_SEGMENTS_MAX); lane++) {
+    // split lane into segments of mowable cells
+    bool inSegment = false;
+    float start = 0;
+    for (float t = tmin; t <= tmax + step; t += step) {
+      lanePoint(lane, t, pt);
+      bool mowable = (t <= tmax) && (isMowable(pt.x, pt.y, clearance));
+      if ((mowable) && (!inSegment)) {
+        start = t;
+        inSegment = true;
+      } else if ((!mowable) && (inSegment)) {
+        inSegment = false;
+        if (t - step - start < PLANNER_MIN_SEGMENT) continue;
+        if (segmentCount == PLANNER_SEGMENTS_MAX) {
+          DEBUGLN(F("planLanes: too many segments"));
+          break;
+        }
+        lane_segment_t &seg = segments[segmentCount];
+        seg.lane = lane;
+        seg.start = start;
+        seg.end = t - step;
+        seg.next = seg.prev = -1;
+        segmentCount++;
+      }
+    }
+  }
+  buildCells();
+  orderCells(Map.robotState.x, Map.robotState.y);
+  DEBUG(F("planLanes lanes="));
+  DEBUG(lanes);
+  DEBUG(F(" segments="));
+  DEBUG(segmentCount);
+  DEBUG(F(" cells="));
+  DEBUG(cellCount);
+  DEBUG(F(" length="));
+  DEBUG(routeLength);
+  DEBUG(F(" transit="));
+  DEBUGLN(transitLength);
+  return segmentCount;
+}
+
+static bool segmentsOverlap(lane_segment_t &a, lane_segment_t &b) {
+  return ((a.start < b.end) && (b.start < a.end));
+}
+
+// boustrophedon decomposition: chain segments of neighbouring lanes that overlap one-to-one (segments are sorted by
+// lane and position)
+void PlannerClass::buildCells() {
+  for (int i = 0; i < segmentCount; i++) {
+    int lane = segments[i].lane;
+    int count = 0;
+    int other = -1;
+    for (int j = i + 1; (j < segmentCount) && (segments[j].lane <= lane + 1); j++) {
+      if ((segments[j].lane == lane + 1) && (segmentsOverlap(segments[i], segments[j]))) {
+        count++;
+        other = j;
+      }
+    }
+    if (count != 1) continue;
+    count = 0;
+    for (int j = other - 1; (j >= 0) && (segments[j].lane >= lane); j--) {
+      if ((segments[j].lane == lane) && (segmentsOverlap(segments[other], segments[j]))) count++;
+    }
+    if (count != 1) continue;
+    segments[i].next = other;
+    segments[other].prev = i;
+  }
+  cellCount = 0;
+  for (int i = 0; i < segmentCount; i++) {
+    if (segments[i].prev == -1) cellCount++;
+  }
+}
+
+// mowing order: next cell is the cell with nearest end (first or last segment), segments of a cell are mowed
+// in zig-zag order
+void PlannerClass::orderCells(float x, float y) {
+  bool done[PLANNER_SEGMENTS_MAX];
+  for (int i = 0; i < segmentCount; i++) done[i] = false;
+  int count = 0;
+  point_t pos;
+  pos.x = x;
+  pos.y = y;
+  while (count < segmentCount) {
+    // find nearest cell end
+    float bestDist = 1e9;
+    int bestSeg = -1;
+    bool bestForward = true;
+    bool bestReverse = false;
+    for (int i = 0; i < segmentCount; i++) {
+      if ((done[i]) || (segments[i].prev != -1)) continue;
+      int last = i;
+      while (segments[last].next != -1) last = segments[last].next;
+      int ends[] = { i, last };
+      for (int e = 0; e < 2; e++) {
+        point_t pt;
+        for (int r = 0; r < 2; r++) {
+          lanePoint(segments[ends[e]].lane, (r == 0) ? segments[ends[e]].start : segments[ends[e]].end, pt);
+          float dist = sq(pt.x - pos.x) + sq(pt.y - pos.y);
+          if (dist < bestDist) {
+            bestDist = dist;
+            bestSeg = ends[e];
+            bestForward = (e == 0);
+            bestReverse = (r == 1);
+          }
+        }
+      }
+    }
+    // add cell segments to route
+    bool reverse = bestReverse;
+    for (int i = bestSeg; i != -1; i = (bestForward) ? segments[i].next : segments[i].prev) {
+      done[i] = true;
+      route[count] = i | ((reverse) ? 0x8000 : 0);
+      point_t start;
+      point_t end;
+      waypoint(count * 2, start);
+      waypoint(count * 2 + 1, end);
+      transitLength += sqrt(sq(start.x - pos.x) + sq(start.y - pos.y));
+      routeLength += segments[i].end - segments[i].start;
+      pos = end;
+      reverse = !reverse;
+      count++;
+    }
+  }
+}
+
+// waypoint of route (two waypoints per segment: start and end in mowing direction)
+void PlannerClass::waypoint(int idx, point_t &pt) {
+  uint16_t entry = route[idx / 2];
+  lane_segment_t &seg = segments[entry & 0x7FFF];
+  bool atEnd = ((idx & 1) == 1) != ((entry & 0x8000) != 0);
+  lanePoint(seg.lane, (atEnd) ? seg.end : seg.start, pt);
+}
+
+// next waypoint of route (map coordinates) from current position (x,y) - returns false if route is completed (a
+// segment whose start cannot be reached without crossing blocked cells is skipped)
+bool PlannerClass::nextWaypoint(float x, float y, point_t &pt) {
+  if (!nextRouteWaypoint(x, y, pt)) return false;
+  // trail: corners of driven route (a corner is dropped if the line from the corner before is clear)
+  while ((trailCount >= 2) && (isMapLineClear(trail[trailCount - 2].x, trail[trailCount - 2].y, pt.x, pt.y))) trailCount--;
+  if (trailCount == PLANNER_TRAIL) {
+    for (int i = 1; i < PLANNER_TRAIL; i++) trail[i - 1] = trail[i];
+    trailCount--;
+  }
+  trail[trailCount++] = pt;
+  return true;
+}
+
+bool PlannerClass::nextRouteWaypoint(float x, float y, point_t &pt) {
+  if (pathReplan) {
+    pathReplan = false;
+    if (!replanPath(x, y)) {
+      pathCount = pathIndex = 0;
+      if (isMapLineClear(x, y, pathTarget.x, pathTarget.y)) {
+        pt = pathTarget;
+        return true;
+      }
+      // path to segment start is blocked: skip segment (next waypoint is its end)
+      skipSegment();
+      routeIndex++;
+    }
+  }
+  if (pathIndex < pathCount) {
+    pt = path[pathIndex++];
+    return true;
+  }
+  while (routeIndex < segmentCount * 2) {
+    waypoint(routeIndex, pt);
+    bool transit = ((routeIndex & 1) == 0);
+    routeIndex++;
+    if ((!transit) || (isLineClear(x, y, pt.x, pt.y))) return true;
+    // transit to segment start: path around blocked cells
+    if (planPath(x, y, pt.x, pt.y)) {
+      pt = path[pathIndex++];
+      return true;
+    }
+    // no path on planning grid (e.g. narrow passage, small lawn): straight line if clear on map cells
+    if (isMapLineClear(x, y, pt.x, pt.y)) return true;
+    if (planPathBack(pt)) {
+      pt = path[pathIndex++];
+      return true;
+    }
+    skipSegment();
+    routeIndex++;
+  }
+  if (skippedCount > 0) {
+    DEBUG(F("planner: route stopped, segments not reached="));
+    DEBUGLN(skippedCount);
+  }
+  return false;
+}
+
+// no path from robot position (e.g. lanes mowed into a lawn part connected by a passage narrower than the planning
+// cells): back along the driven waypoints to the last one with a path to target - returns false if there is none
+bool PlannerClass::planPathBack(const point_t &target) {
+  for (int i = trailCount - 2; i >= 0; i--) {
+    if (!planPath(trail[i].x, trail[i].y, target.x, target.y)) continue;
+    int count = trailCount - 1 - i;
+    if (pathCount + count > PLANNER_PATH_MAX) break;
+    for (int k = pathCount - 1; k >= 0; k--) path[k + count] = path[k];
+    for (int k = 0; k < count; k++) path[k] = trail[trailCount - 2 - k];
+    pathCount += count;
+    return true;
+  }
+  pathCount = 0;
+  return false;
+}
+
+// no path to segment start: segment is skipped
+void PlannerClass::skipSegment() {
+  skippedCount++;
+  DEBUG(F("planner: no path to segment, skipped="));
+  DEBUGLN(skippedCount);
+}
+
+// line between centers of planning cells is not blocked: all cells touched by the line (a line through a cell corner
+// touches both cells beside the corner, as diagonal moves of the search)
+bool PlannerClass::isCellLineClear(int x0, int y0, int x1, int y1) {
+  int nx = abs(x1 - x0);
+  int ny = abs(y1 - y0);
+  int sx = (x1 > x0) ? 1 : -1;
+  int sy = (y1 > y0) ? 1 : -1;
+  int x = x0;
+  int y = y0;
+  if (pathCellCost(x, y) == 0) return false;
+  for (int ix = 0, iy = 0; (ix < nx) || (iy < ny); ) {
+    long decision = ((long)(1 + 2 * ix)) * ny - ((long)(1 + 2 * iy)) * nx;
+    if (decision == 0) {
+      if ((pathCellCost(x + sx, y) == 0) || (pathCellCost(x, y + sy) == 0)) return false;
+      x += sx;
+      y += sy;
+      ix++;
+      iy++;
+    } else if (decision < 0) {
+      x += sx;
+      ix++;
+    } else {
+      y += sy;
+      iy++;
+    }
+    if (pathCellCost(x, y) == 0) return false;
+  }
+  return true;
+}
+
+// straight line between points (meter) over map cells inside perimeter without obstacle
+bool PlannerClass::isMapLineClear(float x0, float y0, float x1, float y1) {
+  int n = 2 * max(1, (int)(max(fabs(x1 - x0), fabs(y1 - y0)) * Map.mapScaleX));
+  for (int i = 0; i <= n; i++) {
+    float t = ((float)i) / ((float)n);
+    if (!isMowable(x0 + (x1 - x0) * t, y0 + (y1 - y0) * t, 0)) return false;
+  }
+  return true;
+}
+
+// planning cell of point (meter) on grid of level - a blocked cell is replaced by the nearest free cell (up to
+// PLANNER_FREE_CELLS cells away) whose center is reachable from the point on a straight line, e.g. robot position
+// next to the perimeter wire - returns false if there is none
+bool PlannerClass::levelCell(int level, float x, float y, int &px, int &py) {
+  setPathGrid(level);
+  float cellSize = pathCells / Map.mapScaleX;
+  int cx = (int)floor(x / cellSize);
+  int cy = (int)floor(y / cellSize);
+  px = cx;
+  py = cy;
+  if (pathCellCost(px, py) != 0) return true;
+  for (int r = 1; r <= PLANNER_FREE_CELLS; r++) {
+    for (int dy = -r; dy <= r; dy++) {
+      for (int dx = -r; dx <= r; dx++) {
+        if (max(abs(dx), abs(dy)) != r) continue; // ring of distance r
+        if (pathCellCost(cx + dx, cy + dy) == 0) continue;
+        if (!isMapLineClear(x, y, (cx + dx + 0.5) * cellSize, (cy + dy + 0.5) * cellSize)) continue;
+        px = cx + dx;
+        py = cy + dy;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool PlannerClass::isLineClear(float x0, float y0, float x1, float y1) {
+  int px0, py0, px1, py1;
+  bool clear = (levelCell(0, x0, y0, px0, py0)) && (levelCell(0, x1, y1, px1, py1))
+    && (isCellLineClear(px0, py0, px1, py1));
+  setPathGrid(pathLevel);
+  return clear;
+}
+
+// follow search path from planning cell (x,y) to target (meter): waypoints at corners of line-of-sight segments
+// are appended to path - returns false if target is not reached
+bool PlannerClass::extractPath(int x, int y, const point_t &target) {
+  float cellSize = pathCells / Map.mapScaleX;
+  int maxCells = (int)(PLANNER_PATH_SEGMENT / cellSize);
+  int anchorX = x;
+  int anchorY = y;
+  int lastX = x;
+  int lastY = y;
+  int steps = 0;
+  while (search.nextCell(x, y)) {
+    if (++steps > PLANNER_PATH_NODES) break;
+    if ((max(abs(x - anchorX), abs(y - anchorY)) > maxCells) || (!isCellLineClear(anchorX, anchorY, x, y))) {
+      if (pathCount >= PLANNER_PATH_MAX - 1) break;
+      path[pathCount].x = (lastX + 0.5) * cellSize;
+      path[pathCount].y = (lastY + 0.5) * cellSize;
+      pathCount++;
+      anchorX = lastX;
+      anchorY = lastY;
+    }
+    lastX = x;
+    lastY = y;
+  }
+  if ((search.cost(x, y) != 0) || (pathCount >= PLANNER_PATH_MAX)) return false; // goal not reached
+  path[pathCount] = target;
+  pathCount++;
+  return true;
+}
+
+// follow search path from start cell to target cell of pathLevel (cells of points (x,y) and pathTarget, see
+// levelCell): a replaced start or target cell is passed through its center
+bool PlannerClass::extractPointPath(float x, float y, int sx, int sy, int gx, int gy) {
+  float cellSize = pathCells / Map.mapScaleX;
+  pathCount = 0;
+  pathIndex = 0;
+  if ((sx != (int)floor(x / cellSize)) || (sy != (int)floor(y / cellSize))) {
+    path[0].x = (sx + 0.5) * cellSize;
+    path[0].y = (sy + 0.5) * cellSize;
+    pathCount = 1;
+  }
+  if ((gx == (int)floor(pathTarget.x / cellSize)) && (gy == (int)floor(pathTarget.y / cellSize))) {
+    return extractPath(sx, sy, pathTarget);
+  }
+  point_t center = { (float)((gx + 0.5) * cellSize), (float)((gy + 0.5) * cellSize) };
+  if ((!extractPath(sx, sy, center)) || (pathCount >= PLANNER_PATH_MAX)) return false;
+  path[pathCount++] = pathTarget;
+  return true;
+}
+
+// path of a coarser planning grid from (x,y): legs that are not clear on the finest grid (e.g. start or end in a
+// blocked coarse cell) are searched again on the finest grid - returns false if a leg has no path
+bool PlannerClass::refinePath(float x, float y) {
+  point_t coarse[PLANNER_PATH_MAX];
+  int count = pathCount;
+  for (int i = 0; i < count; i++) coarse[i] = path[i];
+  bool refined = false;
+  pathCount = 0;
+  for (int i = 0; i < count; i++) {
+    if (isLineClear(x, y, coarse[i].x, coarse[i].y)) {
+      if (pathCount >= PLANNER_PATH_MAX) return false;
+      path[pathCount++] = coarse[i];
+    } else {
+      int sx, sy, gx, gy;
+      if ((!levelCell(0, x, y, sx, sy)) || (!levelCell(0, coarse[i].x, coarse[i].y, gx, gy))) return false;
+      refined = true;
+      if ((!search.plan(sx, sy, gx, gy)) || (!extractPath(sx, sy, coarse[i]))) return false;
+    }
+    x = coarse[i].x;
+    y = coarse[i].y;
+  }
+  if (refined) search.clear(); // search holds last leg only: repair by new search
+  setPathGrid(pathLevel);
+  return true;
+}
+
+// plan path from (x,y) to target (map coordinates) - returns false if there is no path
+// (search arena full on large maps: search again on a coarser planning grid, see refinePath - no path found:
+// weighted search on finer grids)
+bool PlannerClass::planPath(float x, float y, float targetX, float targetY) {
+  pathCount = 0;
+  pathIndex = 0;
+  pathReplan = false;
+  if (!Map.mapValid) return false;
+  pathTarget.x = targetX;
+  pathTarget.y = targetY;
+  bool noPath = false; // no path on finest grid (not arena full)
+  for (pathLevel = 0; pathLevel < PLANNER_PATH_LEVELS; pathLevel++) {
+    int sx, sy, gx, gy;
+    if ((!levelCell(pathLevel, x, y, sx, sy)) || (!levelCell(pathLevel, targetX, targetY, gx, gy))) {
+      noPath = (pathLevel == 0);
+      if (noPath) break; // start or target blocked
+      continue;
+    }
+    if (search.plan(sx, sy, gx, gy)) {
+      if ((extractPointPath(x, y, sx, sy, gx, gy)) && ((pathLevel == 0) || (refinePath(x, y)))) return true;
+      pathCount = 0;
+    } else if (!search.overflow) {
+      noPath = (pathLevel == 0);
+      break; // no path on coarser grids either
+    }
+  }
+  pathCount = 0;
+  // arena full: weighted search on finest planning grid, then on finer grids down to map cells - no path on finest
+  // planning grid (passage narrower than planning cells, e.g. small lawn): finer grids only
+  for (pathLevel = (noPath) ? -1 : 0; ; pathLevel--) {
+    int sx, sy, gx, gy;
+    if ((levelCell(pathLevel, x, y, sx, sy)) && (levelCell(pathLevel, targetX, targetY, gx, gy))) {
+      search.weight = PLANNER_PATH_WEIGHT;
+      bool found = (search.plan(sx, sy, gx, gy)) && (extractPointPath(x, y, sx, sy, gx, gy));
+      search.weight = 1;
+      search.clear(); // no incremental repair of weighted search: repair by new search
+      if (found) return true;
+      pathCount = 0;
+    }
+    if (pathCells == 1) break; // map cells reached
+  }
+  pathLevel = 0;
+  return false;
+}
+
+// repair path from (x,y) after map cells changed - returns false if there is no path
+bool PlannerClass::replanPath(float x, float y) {
+  pathCount = 0;
+  pathIndex = 0;
+  int sx, sy, gx, gy;
+  if ((!levelCell(pathLevel, x, y, sx, sy)) || (!levelCell(pathLevel, pathTarget.x, pathTarget.y, gx, gy))) return false;
+  if ((search.replan(sx, sy)) && (extractPointPath(x, y, sx, sy, gx, gy)) && ((pathLevel <= 0) || (refinePath(x, y)))) {
+    return true;
+  }
+  pathCount = 0;
+  return planPath(x, y, pathTarget.x, pathTarget.y); // arena full or target blocked: new search
+}
+
+// map cell changed (e.g. obstacle marked): current path is repaired at next waypoint
+void PlannerClass::cellChanged(float x, float y) {
+  if (pathIndex >= pathCount) return;
+  setPathGrid(pathLevel);
+  float scale = Map.mapScaleX / pathCells;
+  search.cellChanged((int)floor(x * scale), (int)floor(y * scale));
+  pathReplan = true;
+}
+
+// simulated mowing of planned route on current map (robot must be idle): mowing time (travel and rotation) and
+// coverage - mowed cells of the map are restored afterwards
+void PlannerClass::simulate() {
+  if ((Robot.state != STAT_IDLE) || (segmentCount == 0)) return;
+  bool saved = Map.saveMowed();
+  Map.resetMowed();
+  point_t pos;
+  pos.x = Map.robotState.x;
+  pos.y = Map.robotState.y;
+  float heading = laneAngle;
+  float time = 0;
+  unsigned long startTime = millis();
+  point_t pt;
+  routeIndex = 0;
+  skippedCount = 0;
+  trailCount = 0;
+  while (nextWaypoint(pos.x, pos.y, pt)) {
+    float dist = sqrt(sq(pt.x - pos.x) + sq(pt.y - pos.y));
+    if (dist < 0.01) continue;
+    float course = atan2(pt.y - pos.y, pt.x - pos.x);
+    time += fabs(distancePI(heading, course)) / PLANNER_SIM_ROTATION + dist / PLANNER_SIM_SPEED;
+    Map.mowSegment(pos.x, pos.y, pt.x, pt.y);
+    heading = course;
+    pos = pt;
+  }
+  routeIndex = 0;
+  pathCount = pathIndex = 0;
+  DEBUG(F("planner simulate segments="));
+  DEBUG(segmentCount);
+  DEBUG(F(" cells="));
+  DEBUG(cellCount);
+  DEBUG(F(" length="));
+  DEBUG(routeLength);
+  DEBUG(F(" transit="));
+  DEBUG(transitLength);
+  DEBUG(F(" time(min)="));
+  DEBUG(time / 60.0);
+  DEBUG(F(" coverage="));
+  DEBUG(Map.coverage());
+  DEBUG(F(" area="));
+  DEBUG(Map.mowedArea());
+  DEBUG(F(" cpu(ms)="));
+  DEBUGLN(millis() - startTime);
+  if (saved) Map.restoreMowed();
+    else Map.resetMowed();
+}
+
+// pattern simulation: random start (mowable cell away from perimeter wire, random direction), mowed cells reset
+bool PlannerClass::simStart() {
+  Map.resetMowed();
+  simTime = simDistance = 0;
+  simTime90 = simTime99 = -1;
+  int clearance = (int)ceil(PLANNER_WIRE_CLEARANCE * Map.mapScaleX);
+  for (int trial = 0; trial < 1000; trial++) {
+    int xp = random(Map.mapSizeX);
+    int yp = random(Map.mapSizeY);
+    if (!isMowableCell(xp, yp, clearance)) continue;
+    simPos.x = (xp + 0.5) / Map.mapScaleX;
+    simPos.y = (yp + 0.5) / Map.mapScaleY;
+    simHeading = ((float)random(-180, 180)) / 180.0 * PI;
+    return true;
+  }
+  return false;
+}
+
+// pattern simulation: travel to point (mows cells in PLANNER_SIM_STEP pieces so coverage milestones are resolved)
+void PlannerClass::simMove(point_t pt, float speed) {
+  float dist = sqrt(sq(pt.x - simPos.x) + sq(pt.y - simPos.y));
+  int steps = max(1, (int)ceil(dist / PLANNER_SIM_STEP));
+  point_t from = simPos;
+  for (int i = 1; i <= steps; i++) {
+    float t = ((float)i) / ((float)steps);
+    float x = from.x + t * (pt.x - from.x);
+    float y = from.y + t * (pt.y - from.y);
+    Map.mowSegment(simPos.x, simPos.y, x, y);
+    simPos.x = x;
+    simPos.y = y;
+    simTime += dist / steps / speed;
+    float cov = Map.coverage();
+    if ((simTime90 < 0) && (cov >= 90)) simTime90 = simTime;
+    if ((simTime99 < 0) && (cov >= 99)) simTime99 = simTime;
+  }
+  simDistance += dist;
+}
+
+// pattern simulation: rotate on the spot
+void PlannerClass::simRotate(float course) {
+  simTime += fabs(distancePI(simHeading, course)) / simRotation;
+  simHeading = course;
+}
+
+// pattern simulation: free distance along course until a cell is outside or an obstacle (meter)
+float PlannerClass::simFreeDistance(float course, float maxDist, bool &obstacle) {
+  float step = 0.5 / Map.mapScaleX;
+  float dx = cos(course) * step;
+  float dy = sin(course) * step;
+  float x = simPos.x;
+  float y = simPos.y;
+  float dist = 0;
+  obstacle = false;
+  while (dist < maxDist) {
+    x += dx;
+    y += dy;
+    if (!isMowable(x, y, 0)) {
+      int xp = (int)(x * Map.mapScaleX);
+      int yp = (int)(y * Map.mapScaleY);
+      if ((x >= 0) && (y >= 0) && (xp < Map.mapSizeX) && (yp < Map.mapSizeY)) {
+        obstacle = (Map.getMapCell(xp, Map.mapSizeY - 1 - yp).s.state == MAP_DATA_STATE_OBSTACLE);
+      }
+      break;
+    }
+    dist += step;
+  }
+  return dist;
+}
+
+// pattern simulation: random mowing with the moves of RobotClass::mowRandom (see MOW_REVERSE_CM, MOW_AVOID_TIME,
+// randomMowingAngle) - line until perimeter wire (robot overshoots by detection latency, then reverses) or known
+// obstacle ahead (robot turns without reversing), still outside: avoid steps back until inside, rotate by random angle
+void PlannerClass::simulateRandom(float maxTime) {
+  float maxDist = ((float)Map.mapSizeX) / Map.mapScaleX + ((float)Map.mapSizeY) / Map.mapScaleY;
+  float mowingAngle = simHeading;
+  float avoidSpeed = simSpeed * MOW_AVOID_SPEED;
+  float avoidStep = avoidSpeed * MOW_AVOID_TIME / 1000.0;
+  bool obstacle;
+  point_t pt;
+  while ((simTime < maxTime) && (simTime99 < 0)) {
+    // MOW_LINE
+    float dist = simFreeDistance(mowingAngle, maxDist, obstacle);
+    if (obstacle) dist = max(0.0, dist - MAP_OBSTACLE_LOOKAHEAD);
+      else dist += simSpeed * PLANNER_SIM_LATENCY;
+    pt.x = simPos.x + dist * cos(mowingAngle);
+    pt.y = simPos.y + dist * sin(mowingAngle);
+    simMove(pt, simSpeed);
+    if (!obstacle) {
+      // MOW_REV
+      pt.x = simPos.x - MOW_REVERSE_CM / 100.0 * cos(mowingAngle);
+      pt.y = simPos.y - MOW_REVERSE_CM / 100.0 * sin(mowingAngle);
+      simMove(pt, simReverseSpeed);
+      // MOW_AVOID_ESCAPE: still outside (e.g. in a corner), avoid steps back (at most the line) until inside
+      for (float back = 0; (back < dist) && (!isMowable(simPos.x, simPos.y, 0)); back += avoidStep) {
+        pt.x = simPos.x - avoidStep * cos(mowingAngle);
+        pt.y = simPos.y - avoidStep * sin(mowingAngle);
+        simMove(pt, avoidSpeed);
+      }
+    }
+    // MOW_ROTATE
+    mowingAngle = randomMowingAngle(mowingAngle);
+    simRotate(mowingAngle);
+  }
+}
+
+// pattern simulation: lanes in simulated robot direction, ordered from simulated robot position
+void PlannerClass::simulateLanes(float maxTime) {
+  Map.robotState.x = simPos.x;
+  Map.robotState.y = simPos.y;
+  planLanes(simHeading);
+  routeIndex = 0;
+  point_t pt;
+  while ((simTime < maxTime) && (nextWaypoint(simPos.x, simPos.y, pt))) {
+    float dist = sqrt(sq(pt.x - simPos.x) + sq(pt.y - simPos.y));
+    if (dist < 0.01) continue;
+    simRotate(atan2(pt.y - simPos.y, pt.x - simPos.x));
+    simMove(pt, simSpeed);
+  }
+  clear();
+}
+
+// pattern simulation: differential drive at motor rpm (0: current setting) - travel speed at rpm, rotation on the
+// spot (both wheels at rotation speed in opposite direction)
+void PlannerClass::setSimSpeed(float rpm) {
+  if (rpm <= 0) rpm = Motor.rpmMax;
+  float wheelSpeed = rpm * PI * ((float)Motor.wheelDiameter) / 1000.0 / 60.0;
+  simSpeed = wheelSpeed;
+  simReverseSpeed = wheelSpeed * Robot.reverseSpeedPerc;
+  simRotation = 2.0 * wheelSpeed * Robot.rotationSpeedPerc / (Motor.wheelBaseCm / 100.0);
+}
+
+// pattern simulation: one run of pattern from random start on current map (mowed cells are reset, robot state
+// is changed) - returns false if there is no start position
+bool PlannerClass::simulateRun(int pattern, sim_result_t &result) {
+  if (!simStart()) return false;
+  float maxTime = PLANNER_SIM_HOURS * 3600.0;
+  if (pattern == PATTERN_RANDOM) simulateRandom(maxTime);
+    else simulateLanes(maxTime);
+  result.time90 = simTime90;
+  result.time99 = simTime99;
+  result.time = simTime;
+  result.distance = simDistance;
+  result.coverage = Map.coverage();
+  result.area = Map.mowedArea();
+  return true;
+}
+
+// mowing pattern simulation on current map (robot must be idle): random mowing vs. lanes (pattern 0: both) with a
+// differential drive at motor rpm (0: current setting) - time to 90% and 99% coverage, travel distance, final
+// coverage and mowing rate averaged over runs (random start), mowed cells of the map are restored afterwards
+// (batches of runs on several maps and speeds: host/tools/patternsim)
+void PlannerClass::simulatePatterns(int pattern, int runs, float rpm) {
+  if ((Robot.state != STAT_IDLE) || (!Map.mapValid)) return;
+  if (rpm <= 0) rpm = Motor.rpmMax;
+  runs = max(1, runs);
+  setSimSpeed(rpm);
+  robot_state_t state = Map.robotState;
+  bool saved = Map.saveMowed();
+  for (int p = PATTERN_RANDOM; p <= PATTERN_LANES; p++) {
+    if ((pattern != 0) && (pattern != p)) continue;
+    unsigned long startTime = millis();
+    int reached90 = 0;
+    int reached99 = 0;
+    float time90 = 0;
+    float time99 = 0;
+    float timeSum = 0;
+    float distSum = 0;
+    float covSum = 0;
+    float areaSum = 0;
+    sim_result_t r;
+    for (int run = 0; run < runs; run++) {
+      if (!simulateRun(p, r)) break;
+      if (r.time90 >= 0) {
+        reached90++;
+        time90 += r.time90;
+      }
+      if (r.time99 >= 0) {
+        reached99++;
+        time99 += r.time99;
+      }
+      timeSum += r.time;
+      distSum += r.distance;
+      covSum += r.coverage;
+      areaSum += r.area;
+    }
+    if (p == PATTERN_RANDOM) DEBUG(F("pattern random"));
+      else DEBUG(F("pattern lanes"));
+    DEBUG(F(" runs="));
+    DEBUG(runs);
+    DEBUG(F(" rpm="));
+    DEBUG(rpm);
+    DEBUG(F(" speed="));
+    DEBUG(simSpeed);
+    DEBUG(F(" time90(min)="));
+    DEBUG((reached90 > 0) ? time90 / reached90 / 60.0 : -1);
+    DEBUG(F(" ("));
+    DEBUG(reached90);
+    DEBUG(F(") time99(min)="));
+    DEBUG((reached99 > 0) ? time99 / reached99 / 60.0 : -1);
+    DEBUG(F(" ("));
+    DEBUG(reached99);
+    DEBUG(F(") time(min)="));
+    DEBUG(timeSum / runs / 60.0);
+    DEBUG(F(" distance="));
+    DEBUG(distSum / runs);
+    DEBUG(F(" coverage="));
+    DEBUG(covSum / runs);
+    DEBUG(F(" rate(m2/h)="));
+    DEBUG((timeSum > 0) ? areaSum / timeSum * 3600.0 : 0);
+    DEBUG(F(" cpu(ms)="));
+    DEBUGLN(millis() - startTime);
+  }
+  Map.robotState = state;
+  if (saved) Map.restoreMowed();
+    else Map.resetMowed();
+}
+
+// path planner benchmark on current map (robot must be idle): planning time of paths between random mowable 
+// points, then an obstacle is marked on a path and the path is repaired (incremental) or planned again (full search) 
+void PlannerClass::pathSpeedTest() {
+  if ((Robot.state != STAT_IDLE) || (!Map.mapValid)) return;
+  DEBUGLN(F("path planner speed test..."));
+  clear();
+  int clearance = (int)ceil(PLANNER_WIRE_CLEARANCE * Map.mapScaleX);
+  point_t from[PLANNER_BENCH_PATHS];
+  point_t to[PLANNER_BENCH_PATHS];
+  for (int i = 0; i < PLANNER_BENCH_PATHS; i++) {
+    for (int k = 0; k < 2; k++) {
+      point_t &pt = (k == 0) ? from[i] : to[i];
+      pt.x = pt.y = 0;
+      for (int trial = 0; trial < 1000; trial++) {
+        int xp = random(Map.mapSizeX);
+        int yp = random(Map.mapSizeY);
+        if (!isMowableCell(xp, yp, clearance)) continue;
+        pt.x = (xp + 0.5) / Map.mapScaleX;
+        pt.y = (yp + 0.5) / Map.mapScaleY;
+        break;
+      }
+    }
+  }
+  int found = 0;
+  int overflows = 0;
+  unsigned long timeSum = 0;
+  unsigned long timeMax = 0;
+  long expSum = 0;
+  int nodesMax = 0;
+  int longest = -1;
+  float longestDist = 0;
+  for (int i = 0; i < PLANNER_BENCH_PATHS; i++) {
+    unsigned long startTime = micros();
+    bool ok = planPath(from[i].x, from[i].y, to[i].x, to[i].y);
+    unsigned long duration = micros() - startTime;
+    timeSum += duration;
+    timeMax = max(timeMax, duration);
+    expSum += search.expansions;
+    nodesMax = max(nodesMax, search.nodeCount);
+    if (search.overflow) overflows++;
+    if (!ok) continue;
+    found++;
+    float dist = sqrt(sq(to[i].x - from[i].x) + sq(to[i].y - from[i].y));
+    if ((pathCount > 1) && (dist > longestDist)) {
+      longestDist = dist;
+      longest = i;
+    }
+  }
+  DEBUG(F("paths="));
+  DEBUG(PLANNER_BENCH_PATHS);
+  DEBUG(F(" found="));
+  DEBUG(found);
+  DEBUG(F(" overflow="));
+  DEBUG(overflows);
+  DEBUG(F(" avg(us)="));
+  DEBUG(timeSum / PLANNER_BENCH_PATHS);
+  DEBUG(F(" max(us)="));
+  DEBUG(timeMax);
+  DEBUG(F(" expansions="));
+  DEBUG(expSum / PLANNER_BENCH_PATHS);
+  DEBUG(F(" nodes(max)="));
+  DEBUG(nodesMax);
+  DEBUG(F("/"));
+  DEBUGLN(PLANNER_PATH_NODES);
+  if (longest < 0) {
+    clear();
+    return;
+  }
+  // mark obstacle (PLANNER_BENCH_OBSTACLE map cells) at first waypoint of longest path
+  planPath(from[longest].x, from[longest].y, to[longest].x, to[longest].y);
+  point_t obstacle = path[0];
+  const int size = PLANNER_BENCH_OBSTACLE;
+  map_data_t saved[size * size];
+  int x0 = (int)(obstacle.x * Map.mapScaleX) - size / 2;
+  int y0 = (int)(obstacle.y * Map.mapScaleY) - size / 2;
+  for (int pass = 0; pass < 2; pass++) {
+    for (int j = 0; j < size; j++) {
+      for (int i = 0; i < size; i++) {
+        int xp = x0 + i;
+        int yp = y0 + j;
+        if ((xp < 0) || (yp < 0) || (xp >= Map.mapSizeX) || (yp >= Map.mapSizeY)) continue;
+        int row = Map.mapSizeY - 1 - yp;
+        map_data_t md;
+        if (pass == 0) {
+          saved[j * size + i] = md = Map.getMapCell(xp, row);
+          if (md.s.side == MAP_DATA_SIDE_IN) md.s.state = MAP_DATA_STATE_OBSTACLE;
+        } else md = saved[j * size + i];
+        Map.setMapCell(xp, row, md);
+        search.cellChanged(xp / pathCells, yp / pathCells);
+      }
+    }
+    if (pass == 1) break;
+    unsigned long startTime = micros();
+    bool ok = replanPath(from[longest].x, from[longest].y);
+    unsigned long incremental = micros() - startTime;
+    long incrementalExp = search.expansions;
+    startTime = micros();
+    planPath(from[longest].x, from[longest].y, to[longest].x, to[longest].y);
+    unsigned long full = micros() - startTime;
+    DEBUG(F("obstacle replan ok="));
+    DEBUG(ok);
+    DEBUG(F(" waypoints="));
+    DEBUG(pathCount);
+    DEBUG(F(" incremental(us)="));
+    DEBUG(incremental);
+    DEBUG(F(" expansions="));
+    DEBUG(incrementalExp);
+    DEBUG(F(" full(us)="));
+    DEBUG(full);
+    DEBUG(F(" expansions="));
+    DEBUGLN(search.expansions);
+  }
+  clear();
+}
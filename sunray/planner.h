@@ -0,0 +1,156 @@
+/*
+  mowing path planner: plans the mowing route on the map (map coordinates in meter)
+
+  boustrophedon lanes (PATTERN_LANES): the inside region of the map is swept by parallel lanes (lane distance is
+  cutting width minus overlap), each lane is split into segments at the perimeter wire (segments end before the wire),
+  segments of neighbouring lanes that overlap one-to-one are chained into cells (boustrophedon decomposition),
+  the cells are mowed in zig-zag order (next cell: nearest cell end)
+
+  paths: transit to the next cell uses a grid path (D* Lite, see gridsearch.h) if the direct line is blocked - 
+  planning cells (PLANNER_PATH_CELL_SIZE) outside, at the perimeter wire or with obstacles are blocked, mowed 
+  cells are preferred, the path is simplified into line segments (waypoints), if an obstacle is marked the path is 
+  repaired from the current robot position - long paths on large maps that do not fit into the search arena are
+  planned on a coarser grid (PLANNER_PATH_LEVELS)
+
+  example usage:
+    Planner.planLanes(angle);                // lane direction (map frame)
+    while (Planner.nextWaypoint(x, y, pt)) ... // drive to waypoint (Motor.rotateAngle, Motor.travelLineDistance)
+    Planner.cellChanged(x, y);               // map cell changed (obstacle marked)
+    Planner.simulatePatterns(0, 10, 0);      // random mowing vs. lanes (pattern, runs, motor rpm)
+*/
+
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <Arduino.h>
+#include "map.h"
+#include "gridsearch.h"
+#include "instance.h"
+
+#define PLANNER_RAM_BUDGET      (16 * 1024) // max. size of PlannerClass (see MAP_RAM_BUDGET)
+
+#define PLANNER_SEGMENTS_MAX    256    // lane segments
+#define PLANNER_LANE_OVERLAP    0.05   // lane overlap (meter)
+#define PLANNER_WIRE_CLEARANCE  0.2    // min. distance of lanes to perimeter wire (meter)
+#define PLANNER_MIN_SEGMENT     0.1    // min. segment length (meter)
+
+#define PLANNER_PATH_CELL_SIZE  0.4    // planning cell size (meter, rounded to map cells)
+#define PLANNER_PATH_CLEARANCE  0.1    // min. distance of paths to perimeter wire (meter)
+#define PLANNER_FREE_CELLS      2      // blocked start or target cell: max. distance of free cell (planning cells)
+#define PLANNER_PATH_LEVELS     4      // planning grids (cell size doubled per level, used if search arena is full)
+#define PLANNER_PATH_NODES      512    // search node arena (20 bytes per node)
+#define PLANNER_PATH_BUCKETS    256
+#define PLANNER_PATH_EXPANSIONS 3000   // max. expanded nodes per search
+#define PLANNER_PATH_WEIGHT     3      // heuristic factor of weighted search (no path found on planning grids)
+#define PLANNER_PATH_MAX        32     // path waypoints
+#define PLANNER_TRAIL           16     // driven route corners (no path from robot position: path back, see planPathBack)
+#define PLANNER_PATH_SEGMENT    5.0    // max. path segment length (meter)
+#define PLANNER_COST_MOWED      3      // cell cost factor: mowed cell
+#define PLANNER_COST_UNMOWED    4      // cell cost factor: unmowed cell
+
+#define PLANNER_BENCH_PATHS     20     // path planner benchmark: random paths
+#define PLANNER_BENCH_OBSTACLE  8      // path planner benchmark: obstacle size (map cells)
+
+#define PLANNER_SIM_SPEED       0.3    // simulated travel speed (m/s)
+#define PLANNER_SIM_ROTATION    0.5    // simulated rotation speed (rad/s)
+#define PLANNER_SIM_LATENCY     0.2    // pattern simulation: perimeter detection latency (s, robot overshoots wire)
+#define PLANNER_SIM_STEP        1.0    // pattern simulation: max. mowed segment length (meter, coverage resolution)
+#define PLANNER_SIM_HOURS       24     // pattern simulation: max. simulated mowing time per run (hours)
+
+
+// lane segment: from start to end (meter along lane direction)
+struct lane_segment_t {
+  int16_t lane;
+  int16_t next; // next segment in same cell (following lane) or -1
+  int16_t prev;
+  float start;
+  float end;
+};
+
+typedef struct lane_segment_t lane_segment_t;
+
+
+// pattern simulation: result of one run
+struct sim_result_t {
+  float time90; // time to 90% / 99% coverage (s, -1: not reached)
+  float time99;
+  float time; // mowing time (s)
+  float distance; // travel distance (meter)
+  float coverage; // final coverage (percent)
+  float area; // mowed area (square meter)
+};
+
+typedef struct sim_result_t sim_result_t;
+
+
+class PlannerClass {
+    public:
+      float laneAngle; // lane direction (map frame, rad)
+      float laneDistance; // distance between lanes (meter)
+      int segmentCount; // planned segments
+      int cellCount; // boustrophedon cells
+      int routeIndex; // next waypoint (two waypoints per segment)
+      int skippedCount; // segments skipped (no path to segment start)
+      int trailCount; // driven route corners
+      float routeLength; // lane length (meter)
+      float transitLength; // travel distance between lanes (meter)
+      lane_segment_t segments[PLANNER_SEGMENTS_MAX];
+      uint16_t route[PLANNER_SEGMENTS_MAX]; // mowing order: segment index (bit 15: reverse direction)
+      int pathCount; // path waypoints
+      int pathIndex; // next path waypoint
+      int pathLevel; // planning grid of path (cell size PLANNER_PATH_CELL_SIZE doubled per level, halved per negative level)
+      point_t path[PLANNER_PATH_MAX];
+      point_t trail[PLANNER_TRAIL]; // driven route shortened by straight lines clear on map cells (oldest first)
+      GridSearch<PLANNER_PATH_NODES, PLANNER_PATH_BUCKETS> search;
+      void begin();
+      int planLanes(float angle);
+      bool nextWaypoint(float x, float y, point_t &pt);
+      bool planPath(float x, float y, float targetX, float targetY);
+      bool replanPath(float x, float y);
+      bool isLineClear(float x0, float y0, float x1, float y1);
+      void cellChanged(float x, float y);
+      void clear();
+      void simulate();
+      void simulatePatterns(int pattern, int runs, float rpm);
+      void setSimSpeed(float rpm);
+      bool simulateRun(int pattern, sim_result_t &result);
+      void pathSpeedTest();
+      static bool isMowableCell(int xp, int yp, int clearance);
+    protected:
+      float laneOffsetMin;
+      bool pathReplan; // obstacle marked: repair path
+      point_t pathTarget;
+      point_t simPos; // pattern simulation: robot state
+      float simHeading;
+      float simTime; // mowing time (s)
+      float simDistance; // travel distance (meter)
+      float simTime90; // time to 90% / 99% coverage (s, -1: not reached)
+      float simTime99;
+      float simSpeed; // travel speed (m/s)
+      float simReverseSpeed;
+      float simRotation; // rotation speed (rad/s)
+      bool isMowable(float x, float y, int clearance);
+      bool isCellLineClear(int x0, int y0, int x1, int y1);
+      bool nextRouteWaypoint(float x, float y, point_t &pt);
+      bool planPathBack(const point_t &target);
+      void skipSegment();
+      bool isMapLineClear(float x0, float y0, float x1, float y1);
+      bool levelCell(int level, float x, float y, int &px, int &py);
+      bool extractPath(int x, int y, const point_t &target);
+      bool extractPointPath(float x, float y, int sx, int sy, int gx, int gy);
+      bool refinePath(float x, float y);
+      void lanePoint(int lane, float t, point_t &pt);
+      void waypoint(int idx, point_t &pt);
+      void buildCells();
+      void orderCells(float x, float y);
+      bool simStart();
+      void simMove(point_t pt, float speed);
+      void simRotate(float course);
+      float simFreeDistance(float course, float maxDist, bool &obstacle);
+      void simulateRandom(float maxTime);
+      void simulateLanes(float maxTime);
+};
+
+extern SUNRAY_INSTANCE PlannerClass Planner;
+
+#endif
@@ -0,0 +1,128 @@
+// uniform grid bucket index for nearest point queries (e.g. particles, perimeter outline points)
+//
+// usage:
+//   PointIndex<float,150,64> index;
+//   index.begin(&outline[0].x, &outline[0].y, 2, 0.5);  // external coordinate arrays (stride), cell size
+//   index.add(i);                                       // after point i was appended
+//   float distSq = index.nearestSq(x, y);               // squared distance to nearest point
+//
+// the plane is divided into square cells which are hashed to BUCKETS buckets (so the extent of the points
+// does not need to be known in advance), each bucket holds a linked list of its points - a query visits the
+// cells in rings around the query position until no closer point is possible (squared distances only), if no
+// point is found within POINT_INDEX_RINGS rings (or there are only a few points) all points are scanned
+
+#ifndef POINTINDEX_H
+#define POINTINDEX_H
+
+#include <inttypes.h>
+#include <math.h>
+
+#define POINT_INDEX_RINGS 4    // max. cell rings visited per query
+#define POINT_INDEX_SCAN  16   // scan all points if there are not more than this
+
+
+template <typename T, int N, int BUCKETS> class PointIndex {
+
+public:
+
+    int count;               // indexed points (0..count-1)
+    float cellSize;
+
+    PointIndex() {
+        xs = ys = 0;
+        stride = 1;
+        cellSize = scale = 1;
+        clear();
+    };
+
+    // index points (x[i*stride], y[i*stride]) with given cell size
+    void begin(const T *x, const T *y, int s, float size) {
+        xs = x;
+        ys = y;
+        stride = s;
+        cellSize = size;
+        scale = 1.0 / size;
+        clear();
+    };
+
+    void clear() {
+        count = 0;
+        for (int b = 0; b < BUCKETS; b++) head[b] = -1;
+    };
+
+    // add point i (points are added in order: i == count)
+    void add(int i) {
+        if ((i != count) || (i >= N)) return;
+        int b = bucket(cell(xs[i * stride]), cell(ys[i * stride]));
+        next[i] = head[b];
+        head[b] = i;
+        count++;
+    };
+
+    // index points 0..n-1 again (after points were moved)
+    void rebuild(int n) {
+        clear();
+        for (int i = 0; i < n; i++) add(i);
+    };
+
+    // squared distance to nearest point with index below maxId (or 1e9 if there is no point)
+    float nearestSq(float x, float y, int maxId = N) {
+        int n = (maxId < count) ? maxId : count;
+        float best = 1e9;
+        if (n <= POINT_INDEX_SCAN) return scanSq(x, y, n);
+        int cx = cell(x);
+        int cy = cell(y);
+        for (int r = 0; r <= POINT_INDEX_RINGS; r++) {
+            for (int dy = -r; dy <= r; dy++) {
+                int step = ((dy == -r) || (dy == r)) ? 1 : 2 * r;
+                for (int dx = -r; dx <= r; dx += step) {
+                    for (int i = head[bucket(cx + dx, cy + dy)]; i >= 0; i = next[i]) {
+                        if (i >= n) continue;
+                        float d = distSq(x, y, i);
+                        if (d < best) best = d;
+                    }
+                }
+            }
+            // points in unvisited cells are at least r cells away
+            float ringDist = ((float)r) * cellSize;
+            if (best <= ringDist * ringDist) return best;
+        }
+        return scanSq(x, y, n);
+    };
+
+protected:
+
+    const T *xs;
+    const T *ys;
+    int stride;
+    float scale;
+    int16_t head[BUCKETS];   // first point of each bucket
+    int16_t next[N];         // next point in same bucket
+
+    float distSq(float x, float y, int i) {
+        float dx = x - xs[i * stride];
+        float dy = y - ys[i * stride];
+        return dx * dx + dy * dy;
+    };
+
+    int cell(float v) {
+        return (int)floor(v * scale);
+    };
+
+    int bucket(int cx, int cy) {
+        uint32_t h = ((uint32_t)cx) * 73856093u ^ ((uint32_t)cy) * 19349663u;
+        return (h ^ (h >> 16)) & (BUCKETS - 1);
+    };
+
+    float scanSq(float x, float y, int n) {
+        float best = 1e9;
+        for (int i = 0; i < n; i++) {
+            float d = distSq(x, y, i);
+            if (d < best) best = d;
+        }
+        return best;
+    };
+};
+
+
+#endif
@@ -13,6 +13,7 @@
 #include "helper.h"
 #include "motor.h"
 #include "map.h"
+#include "planner.h"
 #include "battery.h"
 #include "pinman.h"
 #include "settings.h"
@@ -23,7 +24,7 @@
 
 #define MAGIC 52
 
-RobotClass Robot;
+SUNRAY_INSTANCE RobotClass Robot;
 
 
 
@@ -61,11 +62,25 @@ void RobotClass::begin(){
   IMU.begin();    
   Motor.begin();      
   Perimeter.begin(pinPerimeterLeft, pinPerimeterRight);          
+#if PERIMETER_COILS > 2
+  Perimeter.setupCoil(IDX_CENTER, pinPerimeterCenter);
+#endif
 	Sonar.begin();
     
   Map.begin();
+  Planner.begin();
+  int staticRam, heap;
+  ramUsage(staticRam, heap);
   DEBUG(F("freeRam="));
-  DEBUGLN(freeRam());
+  DEBUG(freeRam());
+  DEBUG(F(" static="));
+  DEBUG(staticRam);
+  DEBUG(F(" heap="));
+  DEBUG(heap);
+  DEBUG(F(" map="));
+  DEBUG(sizeof(MapClass));
+  DEBUG(F(" planner="));
+  DEBUGLN(sizeof(PlannerClass));
   RC.begin();
   
   state = STAT_IDLE;
@@ -73,6 +88,7 @@ void RobotClass::begin(){
   mowState = MOW_LINE;
 	lastMowState = mowState;
   mowPattern = PATTERN_NONE;
+  lanesPlanned = false;
   trackState = TRK_RUN;  
 	trackClockwise = true;
 
@@ -89,6 +105,7 @@ void RobotClass::begin(){
   lastStartLineTime; 
 	trackSpeedPerc = 0.5;
 	trackRotationSpeedPerc = 0.3;
+	trackCenterAngle = PI/180.0*3;
 	rotationSpeedPerc = 0.3;
 	reverseSpeedPerc = 0.3;
   
@@ -130,10 +147,13 @@ void RobotClass::run(){
 		resetSensorTriggers();		
     
 	  if ( (!RC.enable) && (IMU.needGyroCal()) ) {     
-	    Motor.setPaused(true);
-      lastState = state;
-	    IMU.startGyroCalibration();
-      state = STAT_CAL_GYRO;
+      // well localized robot corrects heading by particle filter => skip calibration stop
+      if ( (!Map.isWellLocalized()) || (!IMU.postponeGyroCal()) ) {
+	      Motor.setPaused(true);
+        lastState = state;
+	      IMU.startGyroCalibration();
+        state = STAT_CAL_GYRO;
+      }
     }		
 		if (Motor.paused){
 			if (IMU.state != IMU_CAL_GYRO){
@@ -152,6 +172,7 @@ void RobotClass::run(){
   Buzzer.run();
 	ADCMan.run();
 	Sonar.run();
+  Map.runFilter();
 
   if (millis() >= nextControlTime){    
     nextControlTime = millis() + 200; // 5 Hz
@@ -219,15 +240,24 @@ void RobotClass::startMapping(){
 }
 
 void RobotClass::startLaneMowing(){
+  if (Map.isCoverageReached()) Map.resetMowed(); // new mowing session
   mowPattern = PATTERN_LANES;
   state = STAT_MOW;
   mowState = MOW_LINE;
   mowingAngle = IMU.getYaw();
   mowingDirection = mowingAngle-PI/2;
+  // lanes along current heading (map frame: IMU yaw + heading offset), only if robot position is known
+  lanesPlanned = (Map.isWellLocalized()) && (Planner.planLanes(mowingAngle + Map.headingBias) > 0);
+  if (lanesPlanned){
+    Motor.stopImmediately();
+    mowState = MOW_REV;  // continue with first waypoint
+    return;
+  }
   Motor.travelLineDistance(3000, mowingAngle, 1.0);
 }
 
 void RobotClass::startRandomMowing(){
+  if (Map.isCoverageReached()) Map.resetMowed(); // new mowing session
   mowPattern = PATTERN_RANDOM;
   state = STAT_MOW;
   mowState = MOW_LINE;
@@ -281,7 +311,13 @@ void RobotClass::track(){
       break;
     case TRK_RUN:	    
 	    if ((leftIn) && (!rightIn)){        
+#if PERIMETER_COILS > 2
+        // center coil: steer back to the wire before the outer coils cross it (less rotations in place)
+        if (Perimeter.getMagnitude(IDX_CENTER) < 0) Motor.travelLineTime(300, trackAngle - rotationSign * trackCenterAngle, trackSpeedPerc);
+          else Motor.travelLineTime(300, trackAngle + rotationSign * trackCenterAngle, trackSpeedPerc);
+#else
         Motor.travelLineTime(300, trackAngle, trackSpeedPerc);
+#endif
         //Motor.travelLineDistance(5, IMU.getYaw(), speed);
         //Motor.setSpeedPWM(speed, speed);
       }
@@ -363,9 +399,9 @@ void RobotClass::mowRandom(){
     case MOW_AVOID_OBSTACLE:
 		  if (Bumper.pressed()){ 
 				if (obstacleSide == FRONT){
-					Motor.travelLineTime(300, IMU.getYaw(), -0.5);
+					Motor.travelLineTime(MOW_AVOID_TIME, IMU.getYaw(), -MOW_AVOID_SPEED);
 				}	else {
-					Motor.travelLineTime(300, IMU.getYaw(), 0.5);
+					Motor.travelLineTime(MOW_AVOID_TIME, IMU.getYaw(), MOW_AVOID_SPEED);
 				}
 			} else {				
 				mowState = MOW_REV;			
@@ -375,7 +411,7 @@ void RobotClass::mowRandom(){
 			if (!Perimeter.isInside()){
 				//Motor.rotateTime(300, rotationSpeedPerc);								
 				//Motor.rotateAngle(IMU.getYaw()+PI/180.0*45, rotationSpeedPerc);
-				Motor.travelLineTime(300, IMU.getYaw(), -0.5);	
+				Motor.travelLineTime(MOW_AVOID_TIME, IMU.getYaw(), -MOW_AVOID_SPEED);	
 			}	else {
 				mowState = MOW_REV;
 			}	
@@ -389,7 +425,7 @@ void RobotClass::mowRandom(){
       break;
     case MOW_REV:
       if (Motor.motion == MOT_STOP){
-        mowingAngle = scalePI( mowingAngle + PI + ((float)random(-90, 90)/180.0*PI ));
+        mowingAngle = randomMowingAngle(mowingAngle);
         rotateAngle = mowingAngle;        
         Motor.rotateAngle(rotateAngle, rotationSpeedPerc);
         mowState = MOW_ROTATE;
@@ -400,17 +436,88 @@ void RobotClass::mowRandom(){
       //if (!Perimeter.isInside()) Motor.stopSlowly();
       if ( (!Perimeter.isInside()) || (Motor.motion == MOT_STOP)  ){              
 				Motor.stopImmediately();
-        Motor.travelLineDistance(50, mowingAngle, -reverseSpeedPerc);
+        Motor.travelLineDistance(MOW_REVERSE_CM, mowingAngle, -reverseSpeedPerc);
         mowState = MOW_REV;
         //DEBUGLN(F("MOW_REV"));
+      } else if (Map.isObstacleAhead(MAP_OBSTACLE_LOOKAHEAD)){
+        // known obstacle ahead: turn without reversing
+        Motor.stopImmediately();
+        mowState = MOW_REV;
       }
       break;
   }
 }
 
 
+// lane-by-lane mowing along planned route: rotate towards next waypoint, travel to waypoint (lanes end before 
+// perimeter wire), on bumper or perimeter reverse and continue with next waypoint - localization lost: continue
+// with unplanned lanes along current heading
+void RobotClass::mowPlannedLanes(){
+  if (!Map.isWellLocalized()){
+    DEBUGLN(F("localization lost: unplanned lanes"));
+    lanesPlanned = false;
+    Motor.stopImmediately();
+    mowingAngle = IMU.getYaw();
+    mowingDirection = mowingAngle-PI/2;
+    Motor.travelLineDistance(100000, mowingAngle, 1.0);
+    mowState = MOW_LINE;
+    lastStartLineTime = millis();
+    return;
+  }
+  switch (mowState){
+    case MOW_ROTATE:
+      if (Motor.motion == MOT_STOP){
+        float dist = sqrt( sq(laneTargetX - Map.robotState.x) + sq(laneTargetY - Map.robotState.y) );
+        Motor.travelLineDistance(dist * 100.0, rotateAngle, 1.0);
+        mowState = MOW_LINE;
+      }
+      break;
+    case MOW_LINE:
+      if ( (Bumper.pressed()) || (!Perimeter.isInside()) ){
+        Motor.stopImmediately();
+        Motor.travelLineDistance(MOW_REVERSE_CM, rotateAngle, -reverseSpeedPerc);
+        mowState = MOW_REV;
+        break;
+      }
+      if (Map.isObstacleAhead(MAP_OBSTACLE_LOOKAHEAD)){
+        // known obstacle ahead: continue with next waypoint
+        Motor.stopImmediately();
+        mowState = MOW_REV;
+        break;
+      }
+      // fall through
+    case MOW_REV:
+      if (Motor.motion == MOT_STOP){
+        point_t pt;
+        if (!Planner.nextWaypoint(Map.robotState.x, Map.robotState.y, pt)){
+          // route completed
+          DEBUGLN(F("lanes completed"));
+          Buzzer.sound(SND_READY, true);
+          lanesPlanned = false;
+          setIdle();
+          break;
+        }
+        laneTargetX = pt.x;
+        laneTargetY = pt.y;
+        rotateAngle = scalePI( atan2(pt.y - Map.robotState.y, pt.x - Map.robotState.x) - Map.headingBias );
+        Motor.rotateAngle(rotateAngle, rotationSpeedPerc);
+        mowState = MOW_ROTATE;
+      }
+      break;
+    default:
+      // state of unplanned mowing (e.g. planned route started while entering a line): stop and continue with next waypoint
+      Motor.stopImmediately();
+      mowState = MOW_REV;
+      break;
+  }
+}
+
 // lane-by-lane mowing
 void RobotClass::mowLanes(){  	  		
+  if (lanesPlanned){
+    mowPlannedLanes();
+    return;
+  }
 	switch (mowState){
 		case MOW_ROTATE:
       if (Motor.motion == MOT_STOP){        
@@ -454,9 +561,13 @@ void RobotClass::mowLanes(){
       //if (!Perimeter.isInside()) Motor.stopSlowly();
       if ( (!Perimeter.isInside()) || (Motor.motion == MOT_STOP)  ){              
 				Motor.stopImmediately();
-        Motor.travelLineDistance(50, mowingAngle, -reverseSpeedPerc);
+        Motor.travelLineDistance(MOW_REVERSE_CM, mowingAngle, -reverseSpeedPerc);
         mowState = MOW_REV;
         //DEBUGLN(F("MOW_REV"));
+      } else if (Map.isObstacleAhead(MAP_OBSTACLE_LOOKAHEAD)){
+        // known obstacle ahead: turn without reversing
+        Motor.stopImmediately();
+        mowState = MOW_REV;
       }
       break;
   }
@@ -481,6 +592,12 @@ void RobotClass::stateMachine(){
 		case STAT_IDLE:
 			break;
 		case STAT_MOW:						
+      if (Map.isCoverageReached()){
+        // target coverage reached
+        Buzzer.sound(SND_READY, true);
+        setIdle();
+        break;
+      }
 			switch (mowPattern){
 				case PATTERN_RANDOM: 
 					mowRandom();
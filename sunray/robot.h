@@ -23,6 +23,8 @@ all motors are turned off and the gyro is corrected by the compass.
 #include "adcman.h"
 #include "perimeter.h"
 #include "remotectl.h"
+#include "instance.h"
+#include "helper.h"
  
 
 // finate state machine states
@@ -60,6 +62,17 @@ typedef enum Side Side;
 #define SEN_MOTOR_ERROR_LEFT     (1L<<11)
 #define SEN_MOTOR_ERROR_RIGHT    (1L<<12)
 #define SEN_MOTOR_ERROR_MOW      (1L<<13)
+#define SEN_PERIMETER_CENTER     (1L<<14)
+
+// mowing moves, shared by the mowing state machine and the pattern simulation (PlannerClass::simulateRandom)
+#define MOW_REVERSE_CM    50    // reverse distance at perimeter wire or bumper (cm)
+#define MOW_AVOID_TIME    300   // avoid step (bumper, escape back inside perimeter): travel time (ms)
+#define MOW_AVOID_SPEED   0.5   // avoid step: speed (fraction of max. speed)
+
+// random mowing: new mowing angle after reversing (opposite direction +-90 degree)
+inline float randomMowingAngle(float mowingAngle){
+  return scalePI( mowingAngle + PI + ((float)random(-90, 90))/180.0*PI );
+}
 
 
 
@@ -72,6 +85,7 @@ class RobotClass
 		float reverseSpeedPerc;
 		float trackSpeedPerc;
 		float trackRotationSpeedPerc;
+		float trackCenterAngle; // heading correction (rad) by center coil while tracking (PERIMETER_COILS 3)
 		float rotationSpeedPerc;
     float mowingDirection;      
 		uint16_t sensorTriggerStatus; // bitmap of triggered sensors
@@ -85,6 +99,9 @@ class RobotClass
 		MowState lastMowState;
 	  MowPattern mowPattern;
 		Side obstacleSide;
+    bool lanesPlanned; // lane mowing with planned route (map available)
+    float laneTargetX; // current waypoint of planned route (map coordinates)
+    float laneTargetY;
 	  int loopsPerSec;
 		float loopsPerSecSmooth;
     RobotClass();
@@ -111,12 +128,13 @@ class RobotClass
 	  void stateMachine();
 	  void track();
 	  void mowLanes();	    
+	  void mowPlannedLanes();
 		void mowRandom();	    
     void printSensorData();
     void readRobotMessages();    		
 };    
 
-extern RobotClass Robot;
+extern SUNRAY_INSTANCE RobotClass Robot;
 
 #endif
 
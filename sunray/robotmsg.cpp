@@ -11,15 +11,43 @@
  *  15 : particles data
  *  16 : distribute particles on perimeter
  *  17 : robot motion data (distance, orientation) 
+ *  18 : particle filter timing (updates, update time, update duration, stage times motion/sense/resample/state, max. slice time, budget,
+ *       active particles, particle pool size, occupied KLD bins, learned magnitude cells)
+ *  19 : replay step (distance, yaw, left magnitude, right magnitude, robot state) => pose (step, x, y, heading offset, 
+ *       particles extent x, y, overall probability, CPU time, active particles) - used for log playback, robot must be idle
+ *  20 : replay outline point (x, y)
+ *  21 : replay map (0=clear outline, 1=transfer outline to map, 2=end replay, 3=loop closure of outline)
+ *  22 : coverage (inside cells, mowed cells, coverage percent, mowed area m2, mowing time s, mowing rate m2/h, target percent,
+ *       obstacle cells, occupancy layer cells, unmowed cells counted as mowed on tile pool overflow) - sent each second while mowing
+ *  23 : mowing settings (cutting width, target coverage percent)
+ *  24 : lane planner benchmark (lane direction) - plans lanes on current map and simulates mowing (time, coverage), 
+ *       robot must be idle
+ *  25 : path planner benchmark - plans paths between random points on current map (time, expansions, arena usage), 
+ *       marks an obstacle on a path and repairs the path (incremental vs full search), robot must be idle
+ *  26 : map zones (0=list, 1=select zone (zone), 2=save map to zone (zone, name), 3=delete zone (zone), 1-3 only if idle) => zone list 
+ *       (active zone, then name, grid size x, y, mowing time s for each zone) - select requires idle robot
+ *  27 : particle filter settings (steering noise, distance noise, measurement noise, max. particles - value <= 0: default)
+ *       => applied settings - robot must be idle
+ *  28 : mowing pattern simulation (pattern 0=both 1=random 2=lanes, runs, motor rpm - 0: current) - simulates mowing
+ *       on current map from random starts (time to 90/99% coverage, distance, mowing rate), robot must be idle
+ *       (quick check on the robot, batches over maps and speeds: host/tools/patternsim)
  *  70 : configure bluetooth  
  *  75 : erase microcontroller flash memory
  *  76 : eeprom data
+ *  90 : map benchmark (memory usage, lookup/fill time, particle filter update time - float vs. fixed-point coordinates)
  
  * battery messages
  *  88 : battery data
  
  * perimeter messages
  *  84 : perimeter settings
+ *  91 : perimeter benchmark (matched filter calls per second, correlation time reference vs. box sum kernel, scalar
+ *       and SWAR)
+ *  92 : perimeter codes (0=list, 1=add code (chips as string of +,-,0 e.g. +0-0+-), 2=remove added codes) => codes 
+ *       (coil count, code count, then size and magnitude, quality of each coil for each code)
+ *  93 : raw perimeter captures (streamed in the background) => frames (coil, age, time ms, magnitude, quality,
+ *       offset, capture size, length, then length int8 samples as hex digits, two per sample) for all kept captures 
+ *       of all coils, stream ends with !93,-1 - captures are not overwritten while streaming
  
  * sonar messages
  *  87 : sonar data (verbose)
@@ -85,6 +113,7 @@ Private-use only! (you need to ask for a commercial-use)
 #include "motor.h"
 #include "imu.h"
 #include "map.h"
+#include "planner.h"
 #include "bt.h"
 #include "battery.h"
 #include "sonar.h"
@@ -95,11 +124,16 @@ Private-use only! (you need to ask for a commercial-use)
 #endif
 
 
+#define MAP_SEND_SIZE_MAX 64
+#define RAW_STREAM_CHUNK 24       // raw samples per frame (hex encoded)
+#define RAW_STREAM_FRAME_MAX 96   // max. frame size (header and samples) - frame is sent if it fits the send buffer
+
 RobotMsgClass RobotMsg;
 
 
 void RobotMsgClass::begin(){
 	nextInfoTime = 0;	
+  rawStreaming = false;
 }
 
 void RobotMsgClass::receiveEEPROM_or_ERASE(){
@@ -154,7 +188,7 @@ void RobotMsgClass::receiveEEPROM_or_ERASE(){
 void RobotMsgClass::sendPerimeterOutline(){
   ROBOTMSG.print(F("!05"));        
   for (int i=0; i < Map.perimeterOutlineSize; i++){
-    robot_state_t pt = Map.outlineParticles[i];
+    point_t pt = Map.perimeterOutline[i];
     ROBOTMSG.print(F(","));  
     ROBOTMSG.print(pt.x);
     ROBOTMSG.print(F(","));  
@@ -165,31 +199,264 @@ void RobotMsgClass::sendPerimeterOutline(){
 
 void RobotMsgClass::sendParticles(){
   ROBOTMSG.print(F("!15,"));  
-  for (int i=0; i < OUTLINE_PARTICLES; i++){    
-    ROBOTMSG.print(Map.outlineParticles[i].x);      
+  for (int i=0; i < Map.filter.size(); i++){    
+    ROBOTMSG.print(fromCoord(Map.filter.x[i]));      
     ROBOTMSG.print(F(","));                     
-    ROBOTMSG.print(Map.outlineParticles[i].y);      
-    if (i < OUTLINE_PARTICLES-1) ROBOTMSG.print(",");                     
+    ROBOTMSG.print(fromCoord(Map.filter.y[i]));      
+    if (i < Map.filter.size()-1) ROBOTMSG.print(",");                     
   }  
   ROBOTMSG.println();  
 }
 
 
+void RobotMsgClass::sendFilterTiming(){
+  ROBOTMSG.print(F("!18,"));
+  ROBOTMSG.print(Map.filterUpdates);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.filterUpdateTime);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.filterUpdateDuration);
+  for (int i=FILTER_STAGE_MOTION; i < FILTER_STAGES; i++){
+    ROBOTMSG.print(F(","));
+    ROBOTMSG.print(Map.filterStageTime[i]);
+  }
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.filterMaxSliceTime);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.filterBudget);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.filter.size());
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.filter.capacity());
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.filter.kldBins);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.println(Map.magField.cells);
+}
+
+void RobotMsgClass::sendCoverage(){
+  ROBOTMSG.print(F("!22,"));
+  ROBOTMSG.print(Map.mapCellsInside);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.mapCellsMowed);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.coverage());
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.mowedArea());
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.mowingTime / 1000);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.mowingRate());
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.coverageTarget);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.mapCellsObstacle);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.occupancy.cells);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.println(Map.mapCellsPromoted);
+}
+
+void RobotMsgClass::sendZones(){
+  ROBOTMSG.print(F("!26,"));
+  ROBOTMSG.print(Map.activeZone);
+  for (int i=0; i < MAP_ZONES_MAX; i++){
+    ROBOTMSG.print(F(","));
+    ROBOTMSG.print(Map.zones[i].name);
+    ROBOTMSG.print(F(","));
+    ROBOTMSG.print(Map.zones[i].sizeX);
+    ROBOTMSG.print(F(","));
+    ROBOTMSG.print(Map.zones[i].sizeY);
+    ROBOTMSG.print(F(","));
+    ROBOTMSG.print(Map.zones[i].mowingTime / 1000);
+  }
+  ROBOTMSG.println();
+}
+
+void RobotMsgClass::filterSettings(){
+  float steering = ROBOTMSG.parseFloat();
+  float distance = ROBOTMSG.parseFloat();
+  float measurement = ROBOTMSG.parseFloat();
+  int particles = ROBOTMSG.parseInt();
+  Map.setFilterSettings(steering, distance, measurement, particles);
+  ROBOTMSG.print(F("!27,"));
+  ROBOTMSG.print(Map.steeringNoise, 4);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.distanceNoise, 4);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.measurementNoise, 4);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.println(Map.filter.maxSize);
+}
+
+void RobotMsgClass::patternSimulation(){
+  int pattern = ROBOTMSG.parseInt();
+  int runs = ROBOTMSG.parseInt();
+  float rpm = ROBOTMSG.parseFloat();
+  Planner.simulatePatterns(pattern, runs, rpm);
+}
+
+void RobotMsgClass::sendPerimeterCodes(){
+  ROBOTMSG.print(F("!92,"));
+  ROBOTMSG.print(PERIMETER_COILS);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Perimeter.getCodeCount());
+  for (int i=0; i < Perimeter.getCodeCount(); i++){
+    ROBOTMSG.print(F(","));
+    ROBOTMSG.print(Perimeter.getCodeSize(i));
+    for (int j=0; j < PERIMETER_COILS; j++){
+      ROBOTMSG.print(F(","));
+      ROBOTMSG.print(Perimeter.getCodeMagnitude(j, i));
+      ROBOTMSG.print(F(","));
+      ROBOTMSG.print(Perimeter.getCodeFilterQuality(j, i));
+    }
+  }
+  ROBOTMSG.println();
+}
+
+void RobotMsgClass::perimeterCodes(){
+  int cmd = ROBOTMSG.parseInt();
+  String chips;
+  int8_t code[CORR_TAPS_MAX];
+  int size = 0;
+  switch (cmd){
+    case 1: chips = ROBOTMSG.readStringUntil('\n');
+            for (unsigned int i=0; i < chips.length(); i++){
+              char ch = chips.charAt(i);
+              if ((ch != '+') && (ch != '-') && (ch != '0')) continue;
+              if (size == CORR_TAPS_MAX) break;
+              code[size++] = (ch == '+') ? 1 : ((ch == '-') ? -1 : 0);
+            }
+            if (Perimeter.addCode(code, size) < 0) DEBUGLN(F("perimeter code error"));
+            break;
+    case 2: Perimeter.clearCodes(); break;
+  }
+  sendPerimeterCodes();
+}
+
+void RobotMsgClass::startRawStream(){
+  Perimeter.freezeRawCaptures(true);
+  rawStreaming = true;
+  rawStreamCoil = 0;
+  rawStreamAge = 0;
+  rawStreamOffset = 0;
+}
+
+static const char hexDigits[] = "0123456789ABCDEF";
+
+// send raw capture frames as long as they fit the send buffer (does not wait for the serial port)
+void RobotMsgClass::streamRawCaptures(){
+  int size = Perimeter.getRawCaptureSize();
+  while (ROBOTMSG.availableForWrite() >= RAW_STREAM_FRAME_MAX){
+    while ((rawStreamCoil < PERIMETER_COILS) && (rawStreamAge >= Perimeter.getRawCaptureCount(rawStreamCoil))){
+      rawStreamCoil++;
+      rawStreamAge = 0;
+      rawStreamOffset = 0;
+    }
+    if (rawStreamCoil >= PERIMETER_COILS){
+      ROBOTMSG.println(F("!93,-1"));
+      rawStreaming = false;
+      Perimeter.freezeRawCaptures(false);
+      return;
+    }
+    const raw_capture_t *c = Perimeter.getRawCapture(rawStreamCoil, rawStreamAge);
+    int len = min(RAW_STREAM_CHUNK, size - rawStreamOffset);
+    ROBOTMSG.print(F("!93,"));
+    ROBOTMSG.print(rawStreamCoil);
+    ROBOTMSG.print(F(","));
+    ROBOTMSG.print(rawStreamAge);
+    ROBOTMSG.print(F(","));
+    ROBOTMSG.print(c->time);
+    ROBOTMSG.print(F(","));
+    ROBOTMSG.print(c->magnitude);
+    ROBOTMSG.print(F(","));
+    ROBOTMSG.print(c->quality);
+    ROBOTMSG.print(F(","));
+    ROBOTMSG.print(rawStreamOffset);
+    ROBOTMSG.print(F(","));
+    ROBOTMSG.print(size);
+    ROBOTMSG.print(F(","));
+    ROBOTMSG.print(len);
+    ROBOTMSG.print(F(","));
+    // hex digits (raw bytes would break the line protocol, e.g. newline)
+    for (int i=0; i < len; i++){
+      uint8_t v = c->samples[rawStreamOffset + i];
+      ROBOTMSG.write(hexDigits[v >> 4]);
+      ROBOTMSG.write(hexDigits[v & 15]);
+    }
+    ROBOTMSG.println();
+    rawStreamOffset += len;
+    if (rawStreamOffset >= size){
+      rawStreamAge++;
+      rawStreamOffset = 0;
+    }
+  }
+}
+
+void RobotMsgClass::zoneCommand(){
+  int cmd = ROBOTMSG.parseInt();
+  int zone = Map.activeZone;
+  String name;
+  if (cmd != 0) zone = ROBOTMSG.parseInt();
+  switch (cmd){
+    case 1: Map.selectZone(zone); break;
+    case 2: name = ROBOTMSG.readStringUntil('\n');
+            name.replace(",", "");
+            name.trim();
+            if ((Map.mapValid) && (Robot.state == STAT_IDLE)) Map.saveZone(zone, name.c_str());
+            break;
+    case 3: if (Robot.state == STAT_IDLE) Map.deleteZone(zone);
+            break;
+  }
+  sendZones();
+}
+
+void RobotMsgClass::replayStep(){
+  float distance = ROBOTMSG.parseFloat();
+  float yaw = ROBOTMSG.parseFloat();
+  float leftMag = ROBOTMSG.parseFloat();
+  float rightMag = ROBOTMSG.parseFloat();
+  int state = ROBOTMSG.parseInt();
+  unsigned long cpuTime = Map.replayStep(distance, yaw, leftMag, rightMag, state);
+  ROBOTMSG.print(F("!19,"));
+  ROBOTMSG.print(Map.replaySteps);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.robotState.x, 3);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.robotState.y, 3);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.headingBias, 4);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.particlesDistanceX, 3);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.particlesDistanceY, 3);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(Map.overallProb, 4);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.print(cpuTime);
+  ROBOTMSG.print(F(","));
+  ROBOTMSG.println(Map.filter.size());
+}
+
 void RobotMsgClass::sendMap(){
+  // large maps are sent downsampled (max. MAP_SEND_SIZE_MAX cells per row/column)
+  int step = (max(Map.mapSizeX, Map.mapSizeY) + MAP_SEND_SIZE_MAX - 1) / MAP_SEND_SIZE_MAX;
+  int sizeX = (Map.mapSizeX + step - 1) / step;
+  int sizeY = (Map.mapSizeY + step - 1) / step;
   ROBOTMSG.print(F("!03,"));    
-  ROBOTMSG.print(Map.mapScaleX);  
+  ROBOTMSG.print(Map.mapScaleX / step);  
   ROBOTMSG.print(F(","));  
-  ROBOTMSG.print(Map.mapScaleY);  
+  ROBOTMSG.print(Map.mapScaleY / step);  
   ROBOTMSG.print(F(","));  
-  ROBOTMSG.print(MAP_SIZE_X);
+  ROBOTMSG.print(sizeX);
   ROBOTMSG.print(F(","));
-  ROBOTMSG.print(MAP_SIZE_Y);  
+  ROBOTMSG.print(sizeY);  
   ROBOTMSG.print(F(","));
   map_data_t d;
   byte r,g,b,col;
-  for (int y=0; y < MAP_SIZE_Y; y++){    
-    for (int x=0; x < MAP_SIZE_X; x++){        
-	    d = Map.mapData[y][x];		
+  for (int y=0; y < sizeY; y++){    
+    for (int x=0; x < sizeX; x++){        
+	    d = Map.getMapCell(x * step, y * step);		
 		  if (d.s.state == MAP_DATA_STATE_MOWED){
           r=0; g=255; b=0;		  
       } else {
@@ -202,7 +469,7 @@ void RobotMsgClass::sendMap(){
 			      //r=0; g=0; b=255;
 		      }
       }
-		  //ROBOTMSG.write(Map.mapData[y][x].v);      
+		  //ROBOTMSG.write(d.v);      
 		  ROBOTMSG.print(r);      
 		  ROBOTMSG.print(F(","));      		
 		  ROBOTMSG.print(g);      
@@ -312,6 +579,8 @@ void RobotMsgClass::readRobotMessages(){
   float angle;
   float speed;  
   float duration;
+  float x;
+  float y;
   
     char ch = ROBOTMSG.read();    
     switch (ch){     
@@ -364,6 +633,31 @@ void RobotMsgClass::readRobotMessages(){
           case 3: sendMap(); break;         
           case 15: sendParticles(); break;
           case 16: Map.distributeParticlesOutline(); break;
+          case 18: sendFilterTiming(); break;
+          case 19: replayStep(); break;
+          case 20: x = ROBOTMSG.parseFloat();
+                   y = ROBOTMSG.parseFloat();
+                   Map.replayOutlinePoint(x, y);
+                   break;
+          case 21: Map.replayMap(ROBOTMSG.parseInt()); break;
+          case 22: sendCoverage(); break;
+          case 24: if (Robot.state != STAT_IDLE) break;
+                   Planner.planLanes(ROBOTMSG.parseFloat());
+                   Planner.simulate();
+                   Planner.clear();
+                   break;
+          case 25: Planner.pathSpeedTest(); break;
+          case 26: zoneCommand(); break;
+          case 27: filterSettings(); break;
+          case 28: patternSimulation(); break;
+          case 23: Map.cuttingWidth = ROBOTMSG.parseFloat();
+                   Map.coverageTarget = ROBOTMSG.parseFloat();
+                   DEBUGLN(F("received mowing settings"));
+                   break;
+          case 90: Map.speedTest(); break;
+          case 91: Perimeter.speedTest(); break;
+          case 92: perimeterCodes(); break;
+          case 93: startRawStream(); break;
           case 5: sendPerimeterOutline(); break;       
           case 78: /*IMU.comCentre.x = ROBOTMSG.parseFloat();
                   IMU.comCentre.y = ROBOTMSG.parseFloat();
@@ -446,11 +740,14 @@ void RobotMsgClass::run(){
   if (millis() >= nextInfoTime){
     nextInfoTime = millis() + 1000;        
     printSensorData();    
+    if (Robot.state == STAT_MOW) sendCoverage();
 	}
 	
 	if ( ROBOTMSG.available()  ){        	     
     readRobotMessages();    
   }
+
+  if (rawStreaming) streamRawCaptures();
 	
 	if ( (RANGING.available())  ){               
     char ch = RANGING.read();    
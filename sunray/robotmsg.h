@@ -9,14 +9,29 @@
 class RobotMsgClass {
     public:      
 			unsigned long nextInfoTime;
+			bool rawStreaming; // raw perimeter captures streaming in progress
 			void begin();
 			void run();			
     protected:   
+			int rawStreamCoil;
+			int rawStreamAge;
+			int rawStreamOffset;
 			void readRobotMessages();
 			void printSensorData();
 			void sendMap();
 			void sendParticles();
 			void sendPerimeterOutline();
+			void sendFilterTiming();
+			void sendCoverage();
+			void sendZones();
+			void zoneCommand();
+			void filterSettings();
+			void patternSimulation();
+			void sendPerimeterCodes();
+			void perimeterCodes();
+			void startRawStream();
+			void streamRawCaptures();
+			void replayStep();
 			void receiveEEPROM_or_ERASE();
 };
 
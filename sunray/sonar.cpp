@@ -30,7 +30,7 @@ Private-use only! (you need to ask for a commercial-use)
 #include "RunningMedian.h"
 #include <Arduino.h>
 
-SonarClass Sonar;
+SUNRAY_INSTANCE SonarClass Sonar;
 
 #define MAX_DURATION 4000
 #define OBSTACLE_CM 40
@@ -146,6 +146,7 @@ void SonarClass::run(){
 		sonarCenterMeasurements.getLowest(distanceCenter);   				
 		distanceCenter = convertCm(distanceCenter);
 		
+		measurements++;
 		if (distanceLeft < OBSTACLE_CM) Robot.sensorTriggered(SEN_SONAR_LEFT);
 		if (distanceRight < OBSTACLE_CM) Robot.sensorTriggered(SEN_SONAR_RIGHT);
 		if (distanceCenter < OBSTACLE_CM) Robot.sensorTriggered(SEN_SONAR_CENTER);		
@@ -156,6 +157,7 @@ void SonarClass::begin()
 {	
 	enabled = true;
 	triggerBelow = OBSTACLE_CM;
+	measurements = 0;
 	pinMode(pinSonarLeftTrigger , OUTPUT);
   pinMode(pinSonarCenterTrigger , OUTPUT);  
   pinMode(pinSonarRightTrigger , OUTPUT);
@@ -4,7 +4,12 @@
 
 #ifndef SONAR_H
 #define SONAR_H
+#include "instance.h"
 
+#define SONAR_RANGE_MAX   70     // max. range (cm), longer or no echo is reported as max. range
+#define SONAR_OFFSET      0.2    // sonar position ahead of robot center (meter)
+#define SONAR_ANGLE_LEFT  45     // sonar mounting angle (degree, counter-clockwise from robot heading)
+#define SONAR_ANGLE_RIGHT -45
 
 
 class SonarClass {
@@ -17,12 +22,13 @@ class SonarClass {
 			unsigned int distanceLeft; // cm
 			unsigned int distanceRight;
 			unsigned int distanceCenter;  		
+			unsigned long measurements; // distance evaluations
 			bool verboseOutput; 
     protected:                 
 			unsigned int convertCm(unsigned int echoTime);
 };
 
-extern SonarClass Sonar;
+extern SUNRAY_INSTANCE SonarClass Sonar;
 
 #endif
 